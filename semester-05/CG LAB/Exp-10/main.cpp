@@ -1,9 +1,12 @@
 #include <GL/glut.h>
 #include <iostream>
 #include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "../common/BatchIO.h"
 using namespace std;
 
-const int MAXV = 50;
 const int screenW = 600, screenH = 600;
 
 class Point {
@@ -18,8 +21,8 @@ struct Edge {
     double invSlope; // dx/dy
 };
 
-Point poly[MAXV];
-Edge edges[MAXV];
+vector<Point> poly;
+vector<Edge> edges;
 int nVertices = 0, nEdges = 0;
 
 // ---------------- Input ----------------
@@ -27,6 +30,7 @@ void readVertices() {
     cout << "Enter number of vertices: ";
     cin >> nVertices;
     if (nVertices < 3) { cout << "Polygon must have >=3 vertices\n"; exit(0); }
+    poly.resize(nVertices);
 
     cout << "Enter coordinates (x y):\n";
     for (int i = 0; i < nVertices; i++) {
@@ -47,7 +51,7 @@ void printVertexTable() {
 
 // ---------------- Edge Table (GET) ----------------
 void buildGET() {
-    nEdges = 0;
+    edges.clear();
     for (int i = 0; i < nVertices; i++) {
         Point p1 = poly[i];
         Point p2 = poly[(i + 1) % nVertices];
@@ -58,12 +62,18 @@ void buildGET() {
         if (p1.y < p2.y) { yMin = p1.y; yMax = p2.y; xMin = p1.x; }
         else            { yMin = p2.y; yMax = p1.y; xMin = p2.x; }
 
-        edges[nEdges].yMin = yMin;
-        edges[nEdges].yMax = yMax;
-        edges[nEdges].xAtYMin = xMin;
-        edges[nEdges].invSlope = (double)(p2.x - p1.x) / (p2.y - p1.y);
-        nEdges++;
+        Edge e;
+        e.yMin = yMin;
+        e.yMax = yMax;
+        e.xAtYMin = xMin;
+        e.invSlope = (double)(p2.x - p1.x) / (p2.y - p1.y);
+        edges.push_back(e);
     }
+
+    // Bucket order: edges enter the AET in order of yMin
+    stable_sort(edges.begin(), edges.end(),
+                [](const Edge& a, const Edge& b) { return a.yMin < b.yMin; });
+    nEdges = (int)edges.size();
 }
 
 void printGET() {
@@ -85,66 +95,64 @@ void printGET() {
     }
 }
 
-// ---------------- Bubble sort helper ----------------
-void bubbleSortIndices(int idx[], double xvals[], int count) {
-    for (int i = 0; i < count - 1; i++)
-        for (int j = 0; j < count - 1 - i; j++)
-            if (xvals[idx[j]] > xvals[idx[j + 1]])
-                swap(idx[j], idx[j + 1]);
-}
-
-// ---------------- Scanline Fill ----------------
-void scanlineFill() {
+// ---------------- Scanline Spans ----------------
+// Walks the scanlines with an incremental AET: edges are added when the
+// scanline reaches their yMin and dropped at yMax, so each scanline only
+// touches the edges crossing it. emit(y, x1, x2) is called per fill span.
+template <typename SpanFn>
+void forEachSpan(bool printAET, SpanFn emit) {
+    if (nVertices == 0) return;
     int minY = poly[0].y, maxY = poly[0].y;
     for (int i = 1; i < nVertices; i++) {
         if (poly[i].y < minY) minY = poly[i].y;
         if (poly[i].y > maxY) maxY = poly[i].y;
     }
 
-    int activeIdx[MAXV];
-    double xCurr[MAXV];
-    int activeCount;
-
-    glColor3f(0.7, 0.5, 0.3);
-    glBegin(GL_LINES);
+    vector<int> active;
+    vector<double> xCurr(nEdges);
+    int next = 0;
 
     for (int y = minY; y < maxY; y++) {
-        activeCount = 0;
-
-        // collect AET
-        for (int e = 0; e < nEdges; e++) {
-            if (y >= edges[e].yMin && y < edges[e].yMax) {
-                activeIdx[activeCount] = e;
-                xCurr[e] = edges[e].xAtYMin + (y - edges[e].yMin) * edges[e].invSlope;
-                activeCount++;
-            }
-        }
+        // skip empty scanlines up to the next edge bucket
+        if (active.empty() && next < nEdges && edges[next].yMin > y) y = edges[next].yMin;
+
+        // add edges starting here, drop edges that have ended
+        while (next < nEdges && edges[next].yMin <= y) active.push_back(next++);
+        active.erase(remove_if(active.begin(), active.end(),
+                               [&](int e) { return y >= edges[e].yMax; }),
+                     active.end());
+
+        for (int e : active)
+            xCurr[e] = edges[e].xAtYMin + (y - edges[e].yMin) * edges[e].invSlope;
 
         // print AET for this scanline
-        if (activeCount > 0) {
+        if (printAET && !active.empty()) {
             cout << "\nActive Edge Table (AET) at y = " << y << "\n";
             cout << setw(8) << "Edge#" << setw(12) << "xCurr" << "\n";
             cout << string(20, '-') << "\n";
-            for (int i = 0; i < activeCount; i++) {
-                int e = activeIdx[i];
+            for (int e : active) {
                 cout << setw(8) << (e + 1)
                      << setw(12) << fixed << setprecision(2) << xCurr[e] << "\n";
             }
         }
 
-        if (activeCount < 2) continue;
+        if (active.size() < 2) continue;
 
-        int idxList[MAXV];
-        for (int i = 0; i < activeCount; i++) idxList[i] = activeIdx[i];
-        bubbleSortIndices(idxList, xCurr, activeCount);
+        sort(active.begin(), active.end(), [&](int a, int b) { return xCurr[a] < xCurr[b]; });
 
-        for (int i = 0; i + 1 < activeCount; i += 2) {
-            double x1 = xCurr[idxList[i]], x2 = xCurr[idxList[i + 1]];
-            glVertex2i((int)x1, y);
-            glVertex2i((int)x2, y);
-        }
+        for (size_t i = 0; i + 1 < active.size(); i += 2)
+            emit(y, xCurr[active[i]], xCurr[active[i + 1]]);
     }
+}
 
+// ---------------- Scanline Fill ----------------
+void scanlineFill() {
+    glColor3f(0.7, 0.5, 0.3);
+    glBegin(GL_LINES);
+    forEachSpan(true, [](int y, double x1, double x2) {
+        glVertex2i((int)x1, y);
+        glVertex2i((int)x2, y);
+    });
     glEnd();
 
     // outline
@@ -154,6 +162,44 @@ void scanlineFill() {
     glEnd();
 }
 
+// ---------------- Batch mode ----------------
+// Fills every polygon of a point file (see ../common/BatchIO.h) and writes
+// one output polygon per input holding the span endpoints (x1,y),(x2,y).
+int runBatch(const char* inPath, const char* outPath) {
+    batchio::PolygonSet in, out;
+    string err;
+    if (!batchio::readPolygons(inPath, in, err)) {
+        cerr << "Error reading " << inPath << ": " << err << endl;
+        return 1;
+    }
+
+    vector<float> spans;
+    size_t totalSpans = 0;
+    const float* v = in.xy.data();
+    for (uint64_t n : in.counts) {
+        nVertices = (int)n;
+        poly.resize(n);
+        for (uint64_t i = 0; i < n; i++, v += 2) poly[i] = Point((int)v[0], (int)v[1]);
+
+        buildGET();
+        spans.clear();
+        forEachSpan(false, [&](int y, double x1, double x2) {
+            spans.push_back((float)(int)x1); spans.push_back((float)y);
+            spans.push_back((float)(int)x2); spans.push_back((float)y);
+        });
+        out.addPolygon(spans.data(), spans.size() / 2);
+        totalSpans += spans.size() / 4;
+    }
+
+    if (!batchio::writePolygons(outPath, out, err)) {
+        cerr << "Error writing " << outPath << ": " << err << endl;
+        return 1;
+    }
+    cout << "Filled " << in.polygonCount() << " polygon(s), "
+         << totalSpans << " spans" << endl;
+    return 0;
+}
+
 // ---------------- GLUT display ----------------
 void display() {
     glClear(GL_COLOR_BUFFER_BIT);
@@ -162,6 +208,14 @@ void display() {
 }
 
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        if (argc != 4) {
+            cerr << "Usage: " << argv[0] << " --batch <in> <out>" << endl;
+            return 1;
+        }
+        return runBatch(argv[2], argv[3]);
+    }
+
     readVertices();
     printVertexTable();
 
@@ -1,4 +1,8 @@
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../common/BatchIO.h"
 using namespace std;
 
 // Class to represent a point
@@ -22,19 +26,61 @@ public:
         y *= sy;
     }
     
+    int getX() const { return x; }
+    int getY() const { return y; }
+
     // Display coordinates
     void display(int index) {
         cout << "P" << index+1 << " (" << x << ", " << y << ")" << endl;
     }
 };
 
-int main() {
+// Batch mode: scale every vertex of a point file (see ../common/BatchIO.h)
+int runBatch(const char* inPath, const char* outPath, int sx, int sy) {
+    batchio::PolygonSet set;
+    string err;
+    if (!batchio::readPolygons(inPath, set, err)) {
+        cerr << "Error reading " << inPath << ": " << err << endl;
+        return 1;
+    }
+
+    vector<Point> shape(set.vertexCount());
+    for (size_t i = 0; i < shape.size(); i++)
+        shape[i] = Point((int)set.xy[2*i], (int)set.xy[2*i + 1]);
+
+    for (size_t i = 0; i < shape.size(); i++)
+        shape[i].scale(sx, sy);
+
+    for (size_t i = 0; i < shape.size(); i++) {
+        set.xy[2*i] = (float)shape[i].getX();
+        set.xy[2*i + 1] = (float)shape[i].getY();
+    }
+
+    if (!batchio::writePolygons(outPath, set, err)) {
+        cerr << "Error writing " << outPath << ": " << err << endl;
+        return 1;
+    }
+    cout << "Scaling applied to " << shape.size() << " vertices in "
+         << set.polygonCount() << " polygon(s)" << endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        int sx, sy;
+        if (argc != 6 || !batchio::parseArgument(argv[4], sx) || !batchio::parseArgument(argv[5], sy)) {
+            cerr << "Usage: " << argv[0] << " --batch <in> <out> <sx> <sy>  (whole numbers)" << endl;
+            return 1;
+        }
+        return runBatch(argv[2], argv[3], sx, sy);
+    }
+
     int n, sx, sy;
 
     cout << "Enter number of vertices of the shape: ";
     cin >> n;
 
-    Point shape[50];   // Array for storing points
+    vector<Point> shape(n);   // Storage for the points
 
     // Input vertices
     for(int i=0; i<n; i++) {
@@ -1,5 +1,9 @@
 #include <GL/glut.h>
 #include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "../common/BatchIO.h"
 using namespace std;
 
 const int MAX_POINTS = 50;
@@ -18,7 +22,7 @@ public:
 // --------------------- Polygon Class ---------------------
 class Polygon {
 public:
-    Point points[MAX_POINTS];
+    vector<Point> points;
     int n;
 
     Polygon() {
@@ -26,8 +30,8 @@ public:
     }
 
     void addPoint(float x, float y) {
-        if (n < MAX_POINTS)
-            points[n++] = Point(x, y);
+        points.push_back(Point(x, y));
+        n++;
     }
 
     void drawOutline(float r, float g, float b) {
@@ -91,12 +95,13 @@ public:
         return Point(x, y);
     }
 
-    Polygon clipPolygon(Polygon input) {
+    Polygon clipPolygon(const Polygon& input) {
         Polygon output = input;
         char edges[4] = { 'L', 'R', 'B', 'T' };
 
         for (int e = 0; e < 4; e++) {
             Polygon temp;
+            temp.points.reserve(output.n + 4);
             for (int i = 0; i < output.n; i++) {
                 Point curr = output.points[i];
                 Point next = output.points[(i + 1) % output.n];
@@ -117,7 +122,7 @@ public:
                     temp.addPoint(next.x, next.y);
                 }
             }
-            output = temp;
+            output = std::move(temp);
         }
         return output;
     }
@@ -173,9 +178,61 @@ void init() {
     gluOrtho2D(0, 500, 0, 500);
 }
 
+// --------------------- Batch Mode ---------------------
+// Clips every polygon of a point file (see ../common/BatchIO.h) against the
+// window and writes the clipped polygons in the same order.
+int runBatch(const char* inPath, const char* outPath) {
+    batchio::PolygonSet in, out;
+    string err;
+    if (!batchio::readPolygons(inPath, in, err)) {
+        cerr << "Error reading " << inPath << ": " << err << endl;
+        return 1;
+    }
+
+    vector<float> xy;
+    const float* v = in.xy.data();
+    for (uint64_t n : in.counts) {
+        Polygon subject;
+        subject.points.reserve(n);
+        for (uint64_t i = 0; i < n; i++, v += 2) subject.addPoint(v[0], v[1]);
+
+        Polygon clipped = clipper->clipPolygon(subject);
+        xy.clear();
+        for (int i = 0; i < clipped.n; i++) {
+            xy.push_back(clipped.points[i].x);
+            xy.push_back(clipped.points[i].y);
+        }
+        out.addPolygon(xy.data(), clipped.n);
+    }
+
+    if (!batchio::writePolygons(outPath, out, err)) {
+        cerr << "Error writing " << outPath << ": " << err << endl;
+        return 1;
+    }
+    cout << "Clipped " << in.polygonCount() << " polygon(s), "
+         << out.vertexCount() << " output vertices" << endl;
+    return 0;
+}
+
 // --------------------- Main ---------------------
 int main(int argc, char** argv) {
     float xmin = 150, ymin = 150, xmax = 350, ymax = 350;
+
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        bool ok = argc == 4 || argc == 8;
+        if (argc == 8) {
+            ok = batchio::parseArgument(argv[4], xmin) && batchio::parseArgument(argv[5], ymin) &&
+                 batchio::parseArgument(argv[6], xmax) && batchio::parseArgument(argv[7], ymax) &&
+                 xmin < xmax && ymin < ymax;
+        }
+        if (!ok) {
+            cerr << "Usage: " << argv[0] << " --batch <in> <out> [xmin ymin xmax ymax]" << endl;
+            return 1;
+        }
+        clipper = new Clipper(xmin, ymin, xmax, ymax);
+        return runBatch(argv[2], argv[3]);
+    }
+
     clipper = new Clipper(xmin, ymin, xmax, ymax);
 
     int n;
@@ -1,6 +1,10 @@
 #include <GL/glut.h>
 #include <iostream>
 #include <cmath>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "../common/BatchIO.h"
 using namespace std;
 
 struct Point {
@@ -10,10 +14,10 @@ struct Point {
     Point(float a=0, float b=0) : x(a), y(b), isIntersection(false), isEntry(false), id(-1) {}
 };
 
-Point subjectPoly[20], clipPoly[20], subjectList[50], clipList[50], resultPoly[50];
+vector<Point> subjectPoly, clipPoly, subjectList, clipList, resultPoly;
 int subjectSize=0, clipSize=0, subListSize=0, clipListSize=0, resultSize=0, intersectionCount=0;
 
-bool isInside(Point p, Point poly[], int n) {
+bool isInside(Point p, const vector<Point>& poly, int n) {
     bool inside = false;
     for (int i=0, j=n-1; i<n; j=i++)
         if (((poly[i].y>p.y) != (poly[j].y>p.y)) && 
@@ -35,38 +39,59 @@ bool getIntersection(Point p1, Point p2, Point p3, Point p4, Point& inter) {
     return false;
 }
 
+// Sort the intersections found on the edge starting at `from` by their
+// distance along it, so the lists visit them in order
+void sortAlongEdge(vector<Point>& found, Point from) {
+    sort(found.begin(), found.end(), [from](const Point& a, const Point& b) {
+        return (a.x-from.x)*(a.x-from.x) + (a.y-from.y)*(a.y-from.y) <
+               (b.x-from.x)*(b.x-from.x) + (b.y-from.y)*(b.y-from.y);
+    });
+}
+
 void buildLists() {
     subListSize = clipListSize = intersectionCount = 0;
+    subjectList.clear(); clipList.clear();
+    vector<Point> found;
     for (int i=0; i<subjectSize; i++) {
-        subjectList[subListSize++] = subjectPoly[i];
+        subjectList.push_back(subjectPoly[i]); subListSize++;
+        found.clear();
         for (int j=0; j<clipSize; j++) {
             Point inter;
             if (getIntersection(subjectPoly[i], subjectPoly[(i+1)%subjectSize], 
-                               clipPoly[j], clipPoly[(j+1)%clipSize], inter)) {
-                inter.isIntersection = true;
-                inter.id = intersectionCount++;
-                Point mid((subjectPoly[i].x+inter.x)/2, (subjectPoly[i].y+inter.y)/2);
-                inter.isEntry = !isInside(mid, clipPoly, clipSize);
-                subjectList[subListSize++] = inter;
-            }
+                               clipPoly[j], clipPoly[(j+1)%clipSize], inter))
+                found.push_back(inter);
+        }
+        sortAlongEdge(found, subjectPoly[i]);
+        for (Point inter : found) {
+            inter.isIntersection = true;
+            inter.id = intersectionCount++;
+            // the stretch just before the crossing decides entry or exit
+            Point prev = subjectList[subListSize-1];
+            Point mid((prev.x+inter.x)/2, (prev.y+inter.y)/2);
+            inter.isEntry = !isInside(mid, clipPoly, clipSize);
+            subjectList.push_back(inter); subListSize++;
         }
     }
     for (int j=0; j<clipSize; j++) {
-        clipList[clipListSize++] = clipPoly[j];
+        clipList.push_back(clipPoly[j]); clipListSize++;
+        found.clear();
         for (int i=0; i<subjectSize; i++) {
             Point inter;
             if (getIntersection(clipPoly[j], clipPoly[(j+1)%clipSize], 
-                               subjectPoly[i], subjectPoly[(i+1)%subjectSize], inter)) {
-                inter.isIntersection = true;
-                for (int k=0; k<subListSize; k++)
-                    if (subjectList[k].isIntersection && 
-                        abs(subjectList[k].x-inter.x)<0.001 && abs(subjectList[k].y-inter.y)<0.001) {
-                        inter.id = subjectList[k].id;
-                        inter.isEntry = subjectList[k].isEntry;
-                        break;
-                    }
-                clipList[clipListSize++] = inter;
-            }
+                               subjectPoly[i], subjectPoly[(i+1)%subjectSize], inter))
+                found.push_back(inter);
+        }
+        sortAlongEdge(found, clipPoly[j]);
+        for (Point inter : found) {
+            inter.isIntersection = true;
+            for (int k=0; k<subListSize; k++)
+                if (subjectList[k].isIntersection && 
+                    abs(subjectList[k].x-inter.x)<0.001 && abs(subjectList[k].y-inter.y)<0.001) {
+                    inter.id = subjectList[k].id;
+                    inter.isEntry = subjectList[k].isEntry;
+                    break;
+                }
+            clipList.push_back(inter); clipListSize++;
         }
     }
 }
@@ -91,40 +116,49 @@ void printTable() {
     cout << string(90,'=') << "\n";
 }
 
+// Index of intersection `id` in a vertex list, or -1
+int findIntersection(const vector<Point>& list, int size, int id) {
+    for (int i=0; i<size; i++)
+        if (list[i].isIntersection && list[i].id == id) return i;
+    return -1;
+}
+
 void performClipping() {
     resultSize = 0;
-    bool visited[50] = {false};
+    resultPoly.clear();
+    vector<bool> visited(subListSize, false);
+    // a ring never takes more steps than both lists together; more means the
+    // lists do not pair up (unmatched or degenerate intersections)
+    const int maxSteps = subListSize + clipListSize;
     for (int start=0; start<subListSize; start++) {
         if (subjectList[start].isIntersection && subjectList[start].isEntry && !visited[start]) {
-            int curr = start;
+            int curr = start, steps = 0;
             bool inSubject = true;
-            do {
+            while (steps++ < maxSteps) {
                 if (inSubject) {
                     visited[curr] = true;
-                    resultPoly[resultSize++] = subjectList[curr];
+                    resultPoly.push_back(subjectList[curr]); resultSize++;
                     if (subjectList[curr].isIntersection && !subjectList[curr].isEntry) {
+                        int j = findIntersection(clipList, clipListSize, subjectList[curr].id);
+                        if (j < 0) break;
                         inSubject = false;
-                        int intersectionID = subjectList[curr].id;
-                        for (int i=0; i<clipListSize; i++)
-                            if (clipList[i].isIntersection && clipList[i].id == intersectionID) {
-                                curr = i; break;
-                            }
+                        curr = (j+1) % clipListSize;
+                    } else {
+                        curr = (curr+1) % subListSize;
                     }
-                    curr = (curr+1) % subListSize;
                 } else {
-                    resultPoly[resultSize++] = clipList[curr];
                     if (clipList[curr].isIntersection && clipList[curr].isEntry) {
+                        int i = findIntersection(subjectList, subListSize, clipList[curr].id);
+                        if (i < 0) break;
                         inSubject = true;
-                        int intersectionID = clipList[curr].id;
-                        for (int i=0; i<subListSize; i++)
-                            if (subjectList[i].isIntersection && subjectList[i].id == intersectionID) {
-                                curr = i; break;
-                            }
-                        break;
+                        curr = i;
+                    } else {
+                        resultPoly.push_back(clipList[curr]); resultSize++;
+                        curr = (curr+1) % clipListSize;
                     }
-                    curr = (curr+1) % clipListSize;
                 }
-            } while (!(inSubject && curr == start));
+                if (inSubject && curr == start) break;
+            }
         }
     }
     cout << "Clipped vertices: " << resultSize << "\n";
@@ -169,13 +203,55 @@ void display() {
 
 void init() { glMatrixMode(GL_PROJECTION); gluOrtho2D(-250, 250, -250, 250); }
 
+// Batch mode: the point file (see ../common/BatchIO.h) holds the subject
+// polygon followed by the clipping polygon; the result is written as one polygon.
+int runBatch(const char* inPath, const char* outPath) {
+    batchio::PolygonSet in, out;
+    string err;
+    if (!batchio::readPolygons(inPath, in, err)) {
+        cerr << "Error reading " << inPath << ": " << err << endl;
+        return 1;
+    }
+    if (in.polygonCount() != 2) {
+        cerr << "Error: " << inPath << " must contain a subject and a clipping polygon\n";
+        return 1;
+    }
+
+    const float* v = in.xy.data();
+    subjectSize = (int)in.counts[0];
+    clipSize = (int)in.counts[1];
+    subjectPoly.resize(subjectSize);
+    clipPoly.resize(clipSize);
+    for (int i=0; i<subjectSize; i++, v+=2) subjectPoly[i] = Point(v[0], v[1]);
+    for (int i=0; i<clipSize; i++, v+=2) clipPoly[i] = Point(v[0], v[1]);
+
+    buildLists(); performClipping();
+
+    vector<float> xy;
+    xy.reserve(2 * resultSize);
+    for (int i=0; i<resultSize; i++) { xy.push_back(resultPoly[i].x); xy.push_back(resultPoly[i].y); }
+    out.addPolygon(xy.data(), resultSize);
+    if (!batchio::writePolygons(outPath, out, err)) {
+        cerr << "Error writing " << outPath << ": " << err << endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        if (argc != 4) { cerr << "Usage: " << argv[0] << " --batch <in> <out>\n"; return 1; }
+        return runBatch(argv[2], argv[3]);
+    }
+
     cout << "\n*** WEILER-ATHERTON POLYGON CLIPPING ***\n\n";
     cout << "Enter subject polygon vertices: "; cin >> subjectSize;
+    subjectPoly.resize(subjectSize);
     for (int i=0; i<subjectSize; i++) {
         cout << "V" << i << " (x y): "; cin >> subjectPoly[i].x >> subjectPoly[i].y;
     }
     cout << "\nEnter clipping polygon vertices: "; cin >> clipSize;
+    clipPoly.resize(clipSize);
     for (int i=0; i<clipSize; i++) {
         cout << "V" << i << " (x y): "; cin >> clipPoly[i].x >> clipPoly[i].y;
     }
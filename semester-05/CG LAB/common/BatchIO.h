@@ -0,0 +1,267 @@
+// BatchIO.h
+// Headless point / polygon file I/O shared by the polygon experiments
+// (Exp-10, Exp-11, Exp-12, Exp-17, Exp-18).
+//
+// Binary file (little-endian, read and written through mmap):
+//   char     magic[4]      "CGPT"
+//   uint32   version       1
+//   uint32   polyCount
+//   uint32   reserved      0
+//   uint64   counts[polyCount]
+//   float32  xy[sum(counts)][2]
+//
+// Text file (parsed with std::from_chars), same layout as the interactive
+// prompts, repeated once per polygon:
+//   n
+//   x y      (n times)
+//
+// Files are detected by their magic on read. On write, a ".bin" extension
+// selects the binary layout, anything else is written as text.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace batchio {
+
+// All polygons of a file, packed back to back.
+struct PolygonSet {
+    std::vector<uint64_t> counts; // vertices per polygon
+    std::vector<float> xy;        // interleaved x,y for every vertex
+
+    size_t polygonCount() const { return counts.size(); }
+    size_t vertexCount() const { return xy.size() / 2; }
+
+    // Index of the first vertex of polygon i
+    size_t first(size_t i) const {
+        size_t v = 0;
+        for (size_t k = 0; k < i; k++) v += counts[k];
+        return v;
+    }
+
+    void addPolygon(const float* pts, uint64_t n) {
+        counts.push_back(n);
+        xy.insert(xy.end(), pts, pts + 2 * n);
+    }
+};
+
+static const char MAGIC[4] = { 'C', 'G', 'P', 'T' };
+static const uint32_t VERSION = 1;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t polyCount;
+    uint32_t reserved;
+};
+
+// ---------------- Memory-mapped read-only file ----------------
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path, std::string& err) {
+        close();
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0) { err = std::string("cannot open ") + path; return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0) { err = std::string("cannot stat ") + path; close(); return false; }
+        len = (size_t)st.st_size;
+        if (len == 0) return true;
+        void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { err = std::string("cannot mmap ") + path; close(); return false; }
+        madvise(p, len, MADV_SEQUENTIAL);
+        base = (const char*)p;
+        return true;
+    }
+
+    void close() {
+        if (base) munmap((void*)base, len);
+        if (fd >= 0) ::close(fd);
+        base = nullptr; len = 0; fd = -1;
+    }
+
+    const char* data() const { return base; }
+    size_t size() const { return len; }
+
+private:
+    const char* base = nullptr;
+    size_t len = 0;
+    int fd = -1;
+};
+
+// ---------------- Readers ----------------
+static bool readBinary(const MappedFile& f, PolygonSet& out, std::string& err) {
+    FileHeader h;
+    if (f.size() < sizeof(h)) { err = "truncated header"; return false; }
+    std::memcpy(&h, f.data(), sizeof(h));
+    if (h.version != VERSION) { err = "unsupported version " + std::to_string(h.version); return false; }
+
+    size_t pos = sizeof(h);
+    if (f.size() < pos + h.polyCount * sizeof(uint64_t)) { err = "truncated polygon table"; return false; }
+    out.counts.resize(h.polyCount);
+    std::memcpy(out.counts.data(), f.data() + pos, h.polyCount * sizeof(uint64_t));
+    pos += h.polyCount * sizeof(uint64_t);
+
+    // each count must fit in the vertex data still left, which also keeps
+    // the sum from overflowing
+    const uint64_t vertexBytes = 2 * sizeof(float);
+    uint64_t total = 0;
+    for (uint64_t c : out.counts) {
+        if (c > (f.size() - pos) / vertexBytes - total) { err = "truncated vertex data"; return false; }
+        total += c;
+    }
+    out.xy.resize(total * 2);
+    std::memcpy(out.xy.data(), f.data() + pos, total * 2 * sizeof(float));
+    return true;
+}
+
+static const char* skipSpace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ',')) p++;
+    return p;
+}
+
+template <typename T>
+static bool parseNumber(const char*& p, const char* end, T& value) {
+    p = skipSpace(p, end);
+    if (p < end && *p == '+') p++;
+    auto res = std::from_chars(p, end, value);
+    if (res.ec != std::errc()) return false;
+    p = res.ptr;
+    return true;
+}
+
+// A whole command-line argument as a number (finite, if floating point);
+// false on anything else, including trailing characters
+template <typename T>
+static bool parseArgument(const char* s, T& value) {
+    const char* end = s + std::strlen(s);
+    auto res = std::from_chars(s, end, value);
+    if (res.ec != std::errc() || res.ptr != end || res.ptr == s) return false;
+    if constexpr (std::is_floating_point<T>::value) return std::isfinite(value);
+    return true;
+}
+
+static bool readText(const MappedFile& f, PolygonSet& out, std::string& err) {
+    const char* p = f.data();
+    const char* end = p + f.size();
+
+    while ((p = skipSpace(p, end)) < end) {
+        uint64_t n;
+        if (!parseNumber(p, end, n)) { err = "expected vertex count"; return false; }
+        // 2n coordinates take at least one character and one separator each
+        if (n > (uint64_t)(end - p) / 4) { err = "vertex count " + std::to_string(n) + " exceeds the file"; return false; }
+        out.counts.push_back(n);
+        size_t base = out.xy.size();
+        out.xy.resize(base + 2 * n);
+        float* dst = out.xy.data() + base;
+        for (uint64_t i = 0; i < 2 * n; i++) {
+            if (!parseNumber(p, end, dst[i])) { err = "expected coordinate"; return false; }
+        }
+    }
+    return true;
+}
+
+static bool readPolygons(const char* path, PolygonSet& out, std::string& err) {
+    out.counts.clear();
+    out.xy.clear();
+    MappedFile f;
+    if (!f.open(path, err)) return false;
+    if (f.size() >= sizeof(MAGIC) && std::memcmp(f.data(), MAGIC, sizeof(MAGIC)) == 0)
+        return readBinary(f, out, err);
+    return readText(f, out, err);
+}
+
+// ---------------- Writers ----------------
+static bool endsWith(const std::string& s, const char* suffix) {
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static bool writeBinary(const char* path, const PolygonSet& in, std::string& err) {
+    FileHeader h;
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.polyCount = (uint32_t)in.counts.size();
+    h.reserved = 0;
+
+    size_t tableBytes = in.counts.size() * sizeof(uint64_t);
+    size_t dataBytes = in.xy.size() * sizeof(float);
+    size_t total = sizeof(h) + tableBytes + dataBytes;
+
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { err = std::string("cannot create ") + path; return false; }
+    if (ftruncate(fd, (off_t)total) != 0) { err = std::string("cannot size ") + path; ::close(fd); return false; }
+
+    void* p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) { err = std::string("cannot mmap ") + path; ::close(fd); return false; }
+    char* dst = (char*)p;
+    std::memcpy(dst, &h, sizeof(h));
+    std::memcpy(dst + sizeof(h), in.counts.data(), tableBytes);
+    std::memcpy(dst + sizeof(h) + tableBytes, in.xy.data(), dataBytes);
+    munmap(p, total);
+    ::close(fd);
+    return true;
+}
+
+static bool writeText(const char* path, const PolygonSet& in, std::string& err) {
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { err = std::string("cannot create ") + path; return false; }
+
+    // Longest line is two shortest-round-trip floats plus separators
+    const size_t lineMax = 64;
+    std::vector<char> buf(1 << 20);
+    char* const begin = buf.data();
+    char* const limit = begin + buf.size() - lineMax;
+    char* q = begin;
+    bool ok = true;
+
+    auto flush = [&]() {
+        const char* p = begin;
+        while (ok && p < q) {
+            ssize_t w = ::write(fd, p, q - p);
+            if (w <= 0) ok = false;
+            else p += w;
+        }
+        q = begin;
+    };
+
+    const float* v = in.xy.data();
+    for (uint64_t n : in.counts) {
+        if (q > limit) flush();
+        q = std::to_chars(q, q + lineMax, n).ptr;
+        *q++ = '\n';
+        for (uint64_t i = 0; i < n; i++, v += 2) {
+            if (q > limit) flush();
+            q = std::to_chars(q, q + lineMax / 2 - 1, v[0]).ptr;
+            *q++ = ' ';
+            q = std::to_chars(q, q + lineMax / 2 - 1, v[1]).ptr;
+            *q++ = '\n';
+        }
+    }
+    flush();
+    ::close(fd);
+    if (!ok) err = std::string("write failed on ") + path;
+    return ok;
+}
+
+static bool writePolygons(const char* path, const PolygonSet& in, std::string& err) {
+    if (endsWith(path, ".bin")) return writeBinary(path, in, err);
+    return writeText(path, in, err);
+}
+
+} // namespace batchio
@@ -3,10 +3,11 @@
 
 // Build (Ubuntu):
 //   sudo apt-get install build-essential freeglut3-dev
-//   g++ CRT_2D.cpp -o CRT_2D -lGL -lGLU -lglut -std=c++11
+//   g++ CRT_2D.cpp -o CRT_2D -std=c++17 -O3 -fno-trapping-math -fno-math-errno -pthread -lGL -lGLU -lglut
 //   ./CRT_2D
 // ------------------------------------------------------------------------------
 
+#define GL_GLEXT_PROTOTYPES   // timer query entry points (CRT_Profiler.h)
 #include <GL/glut.h>
 #include <cmath>
 #include <vector>
@@ -16,6 +17,25 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "CRT_BeamSampler.h"
+#include "CRT_Electrons.h"
+#include "CRT_Headless.h"
+#include "CRT_Jobs.h"
+#include "CRT_Phosphor.h"
+#include "CRT_Profiler.h"
+#include "CRT_Random.h"
+#include "CRT_Raster.h"
+#include "CRT_Recorder.h"
+#include "CRT_SampleExport.h"
+#include "CRT_Signal.h"
+#include "CRT_SimClock.h"
+#include "CRT_SimThread.h"
+#include "CRT_Spectrum.h"
+#include "CRT_Text.h"
+#include "CRT_TraceHistory.h"
 
 // ------------------------------- Configuration --------------------------------
 static const int WIN_W = 900;
@@ -37,16 +57,24 @@ static const float screenCX = 370.0f;
 static const float screenCY = 270.0f;
 static const float screenA = 40.0f;
 static const float screenB = 130.0f;
+static const float spreadX0 = 245.0f;   // apex of the beam spread region
+static const float spreadY0 = 270.0f;
 
 // Animation timing
-static const int TIMER_MS = 16;        // ~60 FPS
-static const float beamSpeed = 0.02f;  // stage progress
+static const int TIMER_MS = 16;        // ~60 FPS redraw
+static const float beamSpeed = 1.25f;  // stage progress per second
+static const float thetaSpeed = 1.25f; // default screen sweep, radians per second
+static const double SIM_HZ = 10000.0;  // default fixed simulation rate
 static const int INTRO_AUTO_MS = 6000; // 6 sec auto start
 
 // Viewport inset size - REDUCED to prevent overlap
 static const int INSET_PIX = 150;
 static const int INSET_MARGIN = 10;
 
+// World window shown in the inset
+static const float INSET_WX0 = 230.0f, INSET_WX1 = 420.0f;
+static const float INSET_WY0 = 130.0f, INSET_WY1 = 410.0f;
+
 // ------------------------------- Project Info ---------------------------------
 const char* PROJECT_TITLE = "SIMULATION OF CATHODE RAY TUBE (CRT)";
 const char* COURSE_NAME = "Computer Graphics Lab";
@@ -63,9 +91,33 @@ const int MEMBER_COUNT = 4;
 enum BeamStage { STAGE_FILAMENT = 0, STAGE_ANODE, STAGE_DEFLECTION, STAGE_SCREEN };
 bool showIntro = true;
 bool paused = true;
+
+// Simulation state, advanced in fixed steps by stepBeam()
+struct BeamState {
+    BeamStage stage;
+    float progress;
+    double sweep;                  // seconds spent on the screen stage
+};
+BeamState simPrev = { STAGE_FILAMENT, 0.0f, 0.0f };
+BeamState simCurr = { STAGE_FILAMENT, 0.0f, 0.0f };
+SimClock simClock(SIM_HZ);
+float frameDt = 0.0f;              // simulated seconds covered by this frame
+
+// Render state: interpolated between simPrev and simCurr each frame
 BeamStage beamStage = STAGE_FILAMENT;
 float beamProgress = 0.0f;
-float screenTheta = 0.0f;
+double sweepTime = 0.0;            // signal time base
+float deflX = 0.0f, deflY = 0.0f;  // plate deflection at sweepTime, +-1 full scale
+
+// Plate deflection signals (--signal-x / --signal-y). The default is the
+// ellipse sweep: cos on X, sin on Y at thetaSpeed.
+static SignalGenerator defaultSignals() {
+    SignalGenerator g;
+    g.x.frequency = g.y.frequency = thetaSpeed / 6.283185f;
+    g.x.phase = 0.25f;
+    return g;
+}
+SignalGenerator signals = defaultSignals();
 
 // Beam position
 float beamX = filamentX0, beamY = filamentY;
@@ -78,44 +130,178 @@ bool typingDone = false;
 int typingIndex = 0;
 int lastTypingMs = 0;
 
-// Particles
-struct Particle {
-    float t;
-    float speed;
-    float phase;
-    float life;
+// Particles (structure of arrays)
+// updateParticles() advances every particle in one pass and packs the visible
+// ones into the snapshot's vertex array; drawBeamAndParticles() then submits
+// that array with a single glDrawArrays call.
+struct ParticleSystem {
+    std::vector<float> t;
+    std::vector<float> speed;
+    std::vector<float> sinPhase;   // sin/cos of the wobble phase, so the
+    std::vector<float> cosPhase;   // per-frame wobble needs no sin() per particle
 };
-std::vector<Particle> particles;
-const int NUM_PARTICLES = 120;
+ParticleSystem particles;
+int numParticles = 120;            // --particles N
+
+// Physical beam mode ([M] or --physics N): electrons integrated through the
+// tube fields (tube units, see CRT_Electrons.h) and projected onto the schematic
+static const float ELECTRON_DT = 1.0f / 2000.0f;  // integrator substep (s)
+static const int ELECTRON_MAX_STEPS = 64;         // substeps per frame at most
+static const float TUBE_X_AMP = 1.6f;             // screen deflection that maps to screenA
+static const float TUBE_Y_AMP = 1.2f;             // ... and to screenB
+const float PLATE_X_MAX = tube::plateVoltageFor(TUBE_X_AMP, tube::XPLATE_Z);
+const float PLATE_Y_MAX = tube::plateVoltageFor(TUBE_Y_AMP, tube::YPLATE_Z);
+bool physicsMode = false;
+size_t electronCount = 100000;
+uint64_t randomSeed = (uint64_t)time(nullptr);   // --seed N for reproducible runs
+ElectronBeam electrons;
+std::vector<TubeDrive> electronDrive;
+std::vector<ScreenHit> electronHits;
+float electronAcc = 0.0f;
+// Electron-electron repulsion ([C] or --space-charge Q), see CRT_SpaceCharge.h
+static const float SPACE_CHARGE_DEFAULT = 0.1f;   // total beam charge when [C] turns it on
+float spaceCharge = SPACE_CHARGE_DEFAULT;
+bool spaceChargeOn = false;
+bool spaceChargeCheck = false;                    // --space-charge-check: tree vs direct sum after a headless run
+bool solvedField = false;                         // [L] or --solved-field: gun and plate fields from CRT_FieldSolver.h
 
 // Path history
-std::vector<std::pair<float,float>> pathHistory;
-const int PATH_HISTORY_MAX = 800;
+TraceHistory pathHistory;
+size_t traceDepth = 800;           // --trace-depth N
+
+// Phosphor screen behind the inset; [T] shows the replayed path history instead
+PhosphorScreen phosphor;
+float persistence = 1.5f;          // --persistence SECONDS
+std::atomic<bool> showTrace{false};
+
+// Sub-frame sampling of the scripted beam (--sample-rate HZ)
+BeamSampler beamSampler;
+
+// Spectrum panel ([A] or --spectrum): the plate deflection sampled at
+// --spectrum-rate HZ and analysed in --spectrum-size N point blocks by
+// CRT_Spectrum.h, shown in a second inset above the first
+static const double SPECTRUM_RATE = 65536.0;
+static const size_t SPECTRUM_SIZE = 65536;
+SpectrumAnalyzer spectrum;
+double spectrumRate = SPECTRUM_RATE;
+size_t spectrumSize = SPECTRUM_SIZE;
+double spectrumNextT = 0.0;        // signal time of the next analysis sample
+std::vector<float> spectrumX, spectrumY, spectrumZ;
+std::atomic<bool> showSpectrum{false};
+
+// Raster TV mode (--raster LINES, --raster-input FILE): replaces the signal
+// generator for the scripted beam and paints a picture into the phosphor
+static const double RASTER_SAMPLE_HZ = 10e6;
+static const int RASTER_PHOSPHOR_RES = 512;
+RasterScan raster;
+int rasterLines = 0;
+std::string rasterInput;
+float rasterHitEnergy = 0.0f;
+
+// Thread pool for the particle, electron and beam-sample updates
+// (--threads N, default every core); work is split into chunks of these sizes
+static const size_t PARTICLE_GRAIN = 8192;
+static const size_t SAMPLE_GRAIN = 16384;
+JobSystem jobs;
+unsigned threadCount = 0;
+
+// Static geometry (grid, tube, labels), compiled once into display lists by
+// buildStaticLists() so a frame replays it with a few glCallList calls
+enum StaticList { LIST_GRID, LIST_SPREAD_LINES, LIST_STRUCTURE, STATIC_LIST_COUNT };
+GLuint staticLists = 0;
+
+// All text goes through the glyph atlas and is drawn in one batch per frame
+static void* const TEXT_FONTS[] = {
+    GLUT_BITMAP_TIMES_ROMAN_24, GLUT_BITMAP_HELVETICA_18, GLUT_BITMAP_HELVETICA_12, GLUT_BITMAP_HELVETICA_10
+};
+TextRenderer textRenderer;
+
+// Frame profiler: [F] shows the per-phase overlay, [E] writes it as CSV
+enum ProfilePhase { PROF_SIMULATE, PROF_GRID, PROF_SPREAD, PROF_STRUCTURE, PROF_BEAM, PROF_INSET, PROF_TEXT };
+static const char* PROFILE_PHASES[] = { "simulate", "grid", "spread", "structure", "beam", "inset", "text" };
+static const char* PROFILE_CSV = "CRT_2D_profile.csv";
+FrameProfiler profiler;
+bool showProfiler = false;
+
+// Headless mode (--headless N): N frames at a fixed timestep, drawn by the
+// CPU rasterizer in CRT_Headless.h instead of a GLUT window
+static const int HEADLESS_FPS = 60;
+int headlessFrames = 0;
+int headlessW = WIN_W, headlessH = WIN_H;  // --size WxH
+std::string dumpPath;                      // --dump FILE (.ppm, %d pattern or .y4m)
+
+// Simulation thread: simulateFrame() runs every TIMER_MS on simThread and
+// publishes a FrameSnapshot; display() draws only from the newest snapshot,
+// so a slow frame never holds up the simulation. Keys that change the
+// simulation are queued and applied on that thread. Everything above is
+// owned by the simulation thread once it has started.
+struct FrameSnapshot {
+    bool intro = true;
+    bool physics = false;
+    bool showTrace = false;            // inset shows trace rather than phosphor
+    BeamStage stage = STAGE_FILAMENT;
+    float beamX = filamentX0, beamY = filamentY;
+    float timeMs = 0.0f;
+    std::vector<float> points;         // x,y of visible particles or electrons
+    TraceSnapshot trace;               // copied only while showTrace
+    std::vector<uint8_t> phosphor;     // copied only while !showTrace
+    int phosphorRes = 0;
+    bool showSpectrum = false;
+    std::vector<float> spectrum;       // levels, copied only while showSpectrum
+    uint64_t frame = 0;
+    float simMs = 0.0f;                // CPU time of the update
+};
+TripleBuffer<FrameSnapshot> snapshots;
+CommandQueue<unsigned char> commands;
+uint64_t snapshotCount = 0;
+PhosphorTexture phosphorTexture;
+
+// Recording (--record FILE) writes every published snapshot as one tick of
+// a CRT_Recorder.h file; replay (--replay FILE) publishes the recorded ticks
+// instead of simulating. The snapshot is split into fields that change at
+// different rates so the deltas stay small.
+enum RecordField { REC_STATE, REC_POINTS, REC_TRACE, REC_TRACE_BANDS, REC_PHOSPHOR, REC_SPECTRUM, REC_FIELD_COUNT };
+struct RecordedState {                     // no padding: stored as raw bytes
+    uint8_t intro, physics, showTrace, stage;
+    float beamX, beamY, timeMs, simMs;
+    int32_t phosphorRes;
+};
+struct RecordInfo {                        // run settings the renderer needs
+    int32_t rasterLines, spectrumSize;
+    double spectrumRate;
+};
+static const int REPLAY_JUMP = 60;         // ticks skipped by [ and ]
+std::string recordPath, replayPath;
+StateRecorder recorder;
+StateReplay replay;
+size_t replayTick = 0;                     // --replay-from TICK
+bool replayPaused = false;
+bool replayDamaged = false;                // a tick failed to decode: hold the last good frame
+
+// --export FILE: every beam sample (the points fed to the trace) streamed to
+// a CSV or binary file by CRT_SampleExport.h's writer thread
+std::string exportPath;
+SampleExporter sampleExport;
+SimThread simThread;                       // last, so it is stopped first at exit
 
 // ------------------------------- Utilities -----------------------------------
 
-// Precise text centering using GLUT bitmap length
-static void drawStringCentered(float cx, float y, const std::string &s, void* font = GLUT_BITMAP_TIMES_ROMAN_24) {
-    if (s.empty()) return;
-    int lenPix = glutBitmapLength(font, (const unsigned char*)s.c_str());
-    float worldRatio = (worldRight - worldLeft) / (float)WIN_W;
-    float worldLen = lenPix * worldRatio;
-    glRasterPos2f(cx - worldLen * 0.5f, y);
-    for (char c : s) glutBitmapCharacter(font, c);
-}
+// Text is queued at world coordinates under the matrices last passed to
+// textRenderer.setMatrices(), and drawn by textRenderer.flush().
 
-static void drawString(float x, float y, const std::string &s, void* font = GLUT_BITMAP_HELVETICA_12) {
-    glRasterPos2f(x, y);
-    for (char c : s) glutBitmapCharacter(font, c);
+// Centered on cx using the cached string width
+static void drawStringCentered(float cx, float y, const std::string &s, void* font,
+                               float r, float g, float b, float a = 1.0f) {
+    textRenderer.add(font, s, cx, y, 0.0f, r, g, b, a, -0.5f * textRenderer.width(font, s));
 }
 
-static float frand(float a=0.0f, float b=1.0f) {
-    return a + (b-a) * (rand() / (float)RAND_MAX);
+static void drawString(float x, float y, const std::string &s, void* font,
+                       float r, float g, float b, float a = 1.0f) {
+    textRenderer.add(font, s, x, y, 0.0f, r, g, b, a);
 }
 
 // ------------------------------- Init ---------------------------------------
 static void initGL() {
-    srand((unsigned)time(nullptr));
     glClearColor(0.94f, 0.96f, 1.0f, 1.0f);
 
     glDisable(GL_DEPTH_TEST);
@@ -123,13 +309,46 @@ static void initGL() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    particles.clear();
-    for (int i = 0; i < NUM_PARTICLES; ++i) {
-        Particle p;
-        p.t = frand(-0.5f, 1.0f);
-        p.speed = 0.004f + frand(0.0f, 0.012f);
-        p.phase = frand(0.0f, 6.283f);
-        particles.push_back(p);
+    textRenderer.build(TEXT_FONTS, sizeof(TEXT_FONTS) / sizeof(TEXT_FONTS[0]));
+    for (const char* name : PROFILE_PHASES) profiler.addPhase(name);
+    profiler.initGL();
+}
+
+// Simulation state only, no GL calls (shared with headless mode)
+static void initSimulation() {
+    pathHistory.reset(traceDepth, INSET_PIX, INSET_WX0, INSET_WY0, INSET_WX1, INSET_WY1);
+    spectrum.configure(spectrumSize, spectrumRate, INSET_PIX);
+    spectrumSize = spectrum.size();    // rounded up to a power of two
+    phosphor.setPersistence(persistence);
+    if (rasterLines == 0) {
+        phosphor.reset(INSET_PIX, INSET_WX0, INSET_WY0, INSET_WX1, INSET_WY1);
+    } else {
+        // the trace window sits off to one side of the screen; a picture
+        // needs the inset centred on it
+        float shift = screenCX - 0.5f * (INSET_WX0 + INSET_WX1);
+        phosphor.reset(RASTER_PHOSPHOR_RES, INSET_WX0 + shift, INSET_WY0, INSET_WX1 + shift, INSET_WY1);
+        raster.configure(rasterLines);
+        if (rasterInput.empty() || !raster.image.open(rasterInput.c_str())) {
+            if (!rasterInput.empty()) std::fprintf(stderr, "CRT_2D: cannot read %s, showing a test pattern\n", rasterInput.c_str());
+            raster.image.testPattern(640, raster.lines());
+        }
+        if (!beamSampler.enabled()) beamSampler.setRate(RASTER_SAMPLE_HZ);
+        rasterHitEnergy = raster.hitEnergy(phosphor.cellsCovered(2.0f * screenA, 2.0f * screenB),
+                                           beamSampler.rate(), phosphor.getPersistence());
+    }
+
+    particles.t.resize(numParticles);
+    particles.speed.resize(numParticles);
+    particles.sinPhase.resize(numParticles);
+    particles.cosPhase.resize(numParticles);
+    Random rng(randomSeed);
+    rng.fillUniform(particles.t.data(), numParticles, -0.5f, 1.0f);
+    rng.fillUniform(particles.speed.data(), numParticles, 0.004f, 0.016f);
+    rng.fillUniform(particles.sinPhase.data(), numParticles, 0.0f, 6.283f);
+    for (int i = 0; i < numParticles; ++i) {
+        float phase = particles.sinPhase[i];
+        particles.sinPhase[i] = std::sin(phase);
+        particles.cosPhase[i] = std::cos(phase);
     }
 }
 
@@ -149,104 +368,108 @@ static void drawBackgroundGrid() {
 }
 
 // ------------------------------- CRT Drawing ---------------------------------
-static void drawLabelWithArrow(float lx, float ly, float tx, float ty, const std::string& text) {
-    glColor3f(0.1f, 0.1f, 0.1f);
-    drawString(lx, ly, text, GLUT_BITMAP_HELVETICA_12);
 
+// Component labels: text at (lx, ly) with an arrow to (tx, ty). The arrows
+// are part of the static structure list; the text is queued every frame.
+struct SchematicLabel {
+    float lx, ly, tx, ty;
+    const char* text;
+};
+
+static const SchematicLabel SCHEMATIC_LABELS[] = {
+    {  60, 340,  95, 292, "Electron Gun (Cathode)" },
+    { 130, 315, 150, 292, "Focusing Anodes" },
+    { 190, 340, 205, 289, "Y-Deflection Plates" },
+    { 220, 200, 235, 258, "X-Deflection Plates" }
+};
+
+static void drawLabelArrow(const SchematicLabel& l) {
     glColor4f(0.4f, 0.4f, 0.4f, 0.6f);
     glLineWidth(1.0f);
     glBegin(GL_LINES);
-        glVertex2f(lx + 10, ly - 4);
-        glVertex2f(tx, ty);
+        glVertex2f(l.lx + 10, l.ly - 4);
+        glVertex2f(l.tx, l.ty);
     glEnd();
 }
 
-static void drawCRTStructure() {
-    // 1. Outer Body
-    glColor3f(0.05f, 0.05f, 0.05f);
-    glLineWidth(2.5f);
-    glBegin(GL_LINES);
-        glVertex2f(70,320); glVertex2f(240,320);
-        glVertex2f(70,220); glVertex2f(240,220);
-        glVertex2f(70,210); glVertex2f(70,330);
-        glVertex2f(240,320); glVertex2f(370,400);
-        glVertex2f(240,220); glVertex2f(370,140);
-        glVertex2f(45,210); glVertex2f(45,330);
-        glVertex2f(45,210); glVertex2f(70,210);
-        glVertex2f(45,330); glVertex2f(70,330);
-    glEnd();
+static void queueSchematicLabels() {
+    for (const SchematicLabel& l : SCHEMATIC_LABELS) drawString(l.lx, l.ly, l.text, GLUT_BITMAP_HELVETICA_12, 0.1f, 0.1f, 0.1f);
+    // takes the screen fill colour, as the raster colour did before
+    drawString(screenCX+20, screenCY+screenB-20, "Phosphor Screen", GLUT_BITMAP_HELVETICA_12, 0.2f, 0.8f, 0.2f, 0.1f);
+}
 
-    // Pins
-    glColor3f(0.2f, 0.2f, 0.2f);
-    int pinY[] = {225,245,267,290,310};
-    for (int i=0;i<5;i++) {
-        glBegin(GL_POLYGON);
-            glVertex2f(35, pinY[i]); glVertex2f(45, pinY[i]);
-            glVertex2f(45, pinY[i]+5); glVertex2f(35, pinY[i]+5);
-        glEnd();
-    }
+// Schematic parts as plain vertex tables, shared by the GL and headless
+// renderers. lineWidth 0 means the vertices are filled quads.
+struct SchematicPart {
+    float r, g, b;
+    float lineWidth;
+    const float* xy;
+    int vertexCount;
+};
 
-    // 2. Filament
-    glColor3f(0.8f, 0.2f, 0.2f);
-    glLineWidth(2);
-    glBegin(GL_LINES);
-        glVertex2f(70, 292); glVertex2f(115, 292);
-        glVertex2f(70, 248); glVertex2f(115, 248);
-        glVertex2f(115, 248); glVertex2f(115, 292);
-        glVertex2f(70, 272); glVertex2f(95, 272);
-        glVertex2f(70, 267); glVertex2f(95, 267);
-    glEnd();
-    glColor3f(0.2f, 0.2f, 0.2f);
-    glBegin(GL_POLYGON);
-        glVertex2f(95, 267); glVertex2f(108, 267);
-        glVertex2f(108, 272); glVertex2f(95, 272);
-    glEnd();
-    drawLabelWithArrow(60, 340, 95, 292, "Electron Gun (Cathode)");
+static const float BODY_LINES[] = {
+    70,320, 240,320,   70,220, 240,220,   70,210, 70,330,
+    240,320, 370,400,  240,220, 370,140,  45,210, 45,330,
+    45,210, 70,210,    45,330, 70,330
+};
+static const float PIN_QUADS[] = {
+    35,225, 45,225, 45,230, 35,230,
+    35,245, 45,245, 45,250, 35,250,
+    35,267, 45,267, 45,272, 35,272,
+    35,290, 45,290, 45,295, 35,295,
+    35,310, 45,310, 45,315, 35,315
+};
+static const float FILAMENT_LINES[] = {
+    70,292, 115,292,   70,248, 115,248,   115,248, 115,292,
+    70,272, 95,272,    70,267, 95,267
+};
+static const float CATHODE_QUAD[] = { 95,267, 108,267, 108,272, 95,272 };
+static const float ANODE_LINES[] = {
+    120,248, 120,292,  120,248, 180,248,  120,292, 180,292,
+    130,248, 130,265,  130,274, 130,292,
+    140,248, 140,265,  140,274, 140,292,
+    150,248, 150,265,  150,274, 150,292,
+    160,248, 160,265,  160,274, 160,292,
+    170,248, 170,265,  170,274, 170,292,
+    185,244, 185,296,  175,244, 184,244,  175,296, 184,296
+};
+static const float YPLATE_QUADS[] = {
+    190,280, 205,280, 215,289, 200,289,
+    190,250, 205,250, 215,259, 200,259
+};
+static const float XPLATE_BACK_QUAD[] = { 230,261, 245,261, 245,285, 230,285 };
+static const float XPLATE_FRONT_QUAD[] = { 220,258, 235,258, 235,282, 220,282 };
+
+#define PART_VERTS(a) ((int)(sizeof(a) / sizeof(a[0]) / 2))
+static const SchematicPart SCHEMATIC[] = {
+    { 0.05f, 0.05f, 0.05f, 2.5f, BODY_LINES, PART_VERTS(BODY_LINES) },               // 1. Outer body
+    { 0.2f, 0.2f, 0.2f, 0.0f, PIN_QUADS, PART_VERTS(PIN_QUADS) },                    //    Pins
+    { 0.8f, 0.2f, 0.2f, 2.0f, FILAMENT_LINES, PART_VERTS(FILAMENT_LINES) },          // 2. Filament
+    { 0.2f, 0.2f, 0.2f, 0.0f, CATHODE_QUAD, PART_VERTS(CATHODE_QUAD) },
+    { 0.1f, 0.1f, 0.1f, 1.5f, ANODE_LINES, PART_VERTS(ANODE_LINES) },                // 3. Anodes
+    { 0.3f, 0.3f, 0.3f, 0.0f, YPLATE_QUADS, PART_VERTS(YPLATE_QUADS) },              // 4. Deflection plates
+    { 0.1f, 0.1f, 0.1f, 0.0f, XPLATE_BACK_QUAD, PART_VERTS(XPLATE_BACK_QUAD) },
+    { 0.4f, 0.4f, 0.4f, 0.0f, XPLATE_FRONT_QUAD, PART_VERTS(XPLATE_FRONT_QUAD) }
+};
+static const int SCHEMATIC_PARTS = sizeof(SCHEMATIC) / sizeof(SCHEMATIC[0]);
+#undef PART_VERTS
 
-    // 3. Anodes
-    glColor3f(0.1f, 0.1f, 0.1f);
-    glLineWidth(1.5f);
-    glBegin(GL_LINES);
-        glVertex2f(120, 248); glVertex2f(120, 292);
-        glVertex2f(120, 248); glVertex2f(180, 248);
-        glVertex2f(120, 292); glVertex2f(180, 292);
-    glEnd();
-    for (int xpos = 130; xpos <= 170; xpos += 10) {
-        glBegin(GL_LINES);
-            glVertex2f(xpos, 248); glVertex2f(xpos, 265);
-            glVertex2f(xpos, 274); glVertex2f(xpos, 292);
-        glEnd();
+static void drawCRTStructure() {
+    glEnableClientState(GL_VERTEX_ARRAY);
+    for (int i = 0; i < SCHEMATIC_PARTS; ++i) {
+        const SchematicPart& part = SCHEMATIC[i];
+        glColor3f(part.r, part.g, part.b);
+        glVertexPointer(2, GL_FLOAT, 0, part.xy);
+        if (part.lineWidth > 0.0f) {
+            glLineWidth(part.lineWidth);
+            glDrawArrays(GL_LINES, 0, part.vertexCount);
+        } else {
+            glDrawArrays(GL_QUADS, 0, part.vertexCount);
+        }
     }
-    glBegin(GL_LINES);
-        glVertex2f(185, 244); glVertex2f(185, 296);
-        glVertex2f(175, 244); glVertex2f(184, 244);
-        glVertex2f(175, 296); glVertex2f(184, 296);
-    glEnd();
-    drawLabelWithArrow(130, 315, 150, 292, "Focusing Anodes");
-
-    // 4. Deflection Plates
-    glColor3f(0.3f,0.3f,0.3f);
-    glBegin(GL_POLYGON);
-        glVertex2f(190, 280); glVertex2f(205, 280);
-        glVertex2f(215, 289); glVertex2f(200, 289);
-    glEnd();
-    glBegin(GL_POLYGON);
-        glVertex2f(190, 250); glVertex2f(205, 250);
-        glVertex2f(215, 259); glVertex2f(200, 259);
-    glEnd();
+    glDisableClientState(GL_VERTEX_ARRAY);
 
-    glColor3f(0.1f,0.1f,0.1f);
-    glBegin(GL_POLYGON);
-        glVertex2f(230, 261); glVertex2f(245, 261);
-        glVertex2f(245, 285); glVertex2f(230, 285);
-    glEnd();
-    glColor3f(0.4f,0.4f,0.4f);
-    glBegin(GL_POLYGON);
-        glVertex2f(220, 258); glVertex2f(235, 258);
-        glVertex2f(235, 282); glVertex2f(220, 282);
-    glEnd();
-    drawLabelWithArrow(190, 340, 205, 289, "Y-Deflection Plates");
-    drawLabelWithArrow(220, 200, 235, 258, "X-Deflection Plates");
+    for (const SchematicLabel& l : SCHEMATIC_LABELS) drawLabelArrow(l);
 
     // 5. Screen
     glPointSize(2);
@@ -268,39 +491,40 @@ static void drawCRTStructure() {
         glVertex2f(screenCX + screenA*std::cos(t), screenCY + screenB*std::sin(t));
     }
     glEnd();
-
-    drawString(screenCX+20, screenCY+screenB-20, "Phosphor Screen", GLUT_BITMAP_HELVETICA_12);
 }
 
 // ------------------------------- Beam Logic -----------------------------------
 
-static void drawBeamSpreadRegion() {
-    float startX = 245.0f;
-    float startY = 270.0f;
-    float endX = screenCX;
-    float endY_Top = screenCY + screenB - 10;
-    float endY_Bot = screenCY - screenB + 10;
-
+static void drawBeamSpreadLines() {
     glLineWidth(1.0f);
     glEnable(GL_LINE_STIPPLE);
     glLineStipple(1, 0xAAAA);
     glColor4f(0.6f, 0.6f, 0.6f, 0.5f);
 
     glBegin(GL_LINES);
-        glVertex2f(startX, startY); glVertex2f(endX, endY_Top);
-        glVertex2f(startX, startY); glVertex2f(endX, endY_Bot);
+        glVertex2f(spreadX0, spreadY0); glVertex2f(screenCX, screenCY + screenB - 10);
+        glVertex2f(spreadX0, spreadY0); glVertex2f(screenCX, screenCY - screenB + 10);
     glEnd();
     glDisable(GL_LINE_STIPPLE);
+}
+
+static void drawBeamSpreadRegion(const FrameSnapshot& snap) {
+    float startX = spreadX0;
+    float startY = spreadY0;
+    float endX = screenCX;
+    float endY_Top = screenCY + screenB - 10;
+    float endY_Bot = screenCY - screenB + 10;
 
-    if (beamStage == STAGE_SCREEN || beamStage == STAGE_DEFLECTION) {
+    glCallList(staticLists + LIST_SPREAD_LINES);
+
+    if (snap.stage == STAGE_SCREEN || snap.stage == STAGE_DEFLECTION) {
         glColor4f(0.0f, 0.5f, 1.0f, 0.05f);
         glBegin(GL_TRIANGLES);
             glVertex2f(startX, startY);
             glVertex2f(endX, endY_Top);
             glVertex2f(endX, endY_Bot);
         glEnd();
-        glColor3f(0.4f, 0.4f, 0.6f);
-        drawString(280, 420, "Deflection Region", GLUT_BITMAP_HELVETICA_10);
+        drawString(280, 420, "Deflection Region", GLUT_BITMAP_HELVETICA_10, 0.4f, 0.4f, 0.6f);
     }
 }
 
@@ -315,59 +539,170 @@ static void computeBeamTip() {
         beamX = anodeX1 + (platesX - anodeX1) * beamProgress;
         beamY = filamentY;
     } else { // STAGE_SCREEN
-        float tx = screenCX + screenA * std::cos(screenTheta);
-        float ty = screenCY + screenB * std::sin(screenTheta);
+        float tx = screenCX + screenA * deflX;
+        float ty = screenCY + screenB * deflY;
         beamX = platesX + (tx - platesX) * beamProgress;
         beamY = filamentY + (ty - filamentY) * beamProgress;
     }
 }
 
-static void drawBeamAndParticles(float timeMs) {
-    float tx = screenCX + screenA * std::cos(screenTheta);
-    float ty = screenCY + screenB * std::sin(screenTheta);
+static void updateParticles(float timeMs, float dt, std::vector<float>& points) {
+    const float tx = screenCX + screenA * deflX;
+    const float ty = screenCY + screenB * deflY;
+
+    // wobble = 5 * sin(phase + w), expanded so only w needs sin/cos
+    const float w = timeMs * 0.005f;
+    const float sinW = 5.0f * std::sin(w);
+    const float cosW = 5.0f * std::cos(w);
+
+    // speeds are per TIMER_MS tick
+    const float ticks = dt / (TIMER_MS * 0.001f);
+
+    float* t = particles.t.data();
+    const float* speed = particles.speed.data();
+    const float* sinP = particles.sinPhase.data();
+    const float* cosP = particles.cosPhase.data();
+    points.resize(2 * (size_t)numParticles);
+    size_t floats = jobs.parallelPack((size_t)numParticles, PARTICLE_GRAIN, points.data(), 2,
+                                      [&](size_t i0, size_t i1, float* out) {
+        for (size_t i = i0; i < i1; ++i) {
+            float nt = t[i] + speed[i] * ticks;
+            t[i] = (nt > 1.1f) ? -0.1f : nt;
+        }
+
+        // Two-segment path: filament -> plates (t < 0.3), plates -> screen target.
+        // Particles outside [0, 1] are invisible and are not written at all.
+        size_t k = 0;
+        for (size_t i = i0; i < i1; ++i) {
+            float pt = t[i];
+            if (pt < 0.0f || pt > 1.0f) continue;
+
+            float curX, curY;
+            if (pt < 0.3f) {
+                curX = filamentX0 + (platesX - filamentX0) * (pt / 0.3f);
+                curY = filamentY;
+            } else {
+                float sub_t = (pt - 0.3f) / 0.7f;
+                float wobble = sinP[i] * cosW + cosP[i] * sinW;
+                curX = platesX + (tx - platesX) * sub_t;
+                curY = filamentY + (ty - filamentY) * sub_t + wobble * (1.0f - sub_t);
+            }
+            out[k++] = curX;
+            out[k++] = curY;
+        }
+        return k;
+    });
+    points.resize(floats);
+}
 
+static void drawBeamAndParticles(const FrameSnapshot& snap) {
     glPointSize(3.0f);
-    for (int i = 0; i < (int)particles.size(); ++i) {
-        Particle &p = particles[i];
-        p.t += p.speed;
-        if (p.t > 1.1f) p.t = -0.1f;
-
-        float curX, curY;
-        float t_mapped = p.t;
-
-        float px_start = filamentX0;
-        float px_mid = platesX;
-        float px_end = tx;
-
-        if (t_mapped < 0.3f) {
-            float sub_t = t_mapped / 0.3f;
-            curX = px_start + (px_mid - px_start) * sub_t;
-            curY = filamentY;
-        } else {
-            float sub_t = (t_mapped - 0.3f) / 0.7f;
-            curX = px_mid + (px_end - px_mid) * sub_t;
-            float targetY = ty;
-            curY = filamentY + (targetY - filamentY) * sub_t;
+    glColor4f(0.2f, 0.2f, 0.9f, 0.8f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, snap.points.data());
+    glDrawArrays(GL_POINTS, 0, (GLsizei)(snap.points.size() / 2));
+    glDisableClientState(GL_VERTEX_ARRAY);
 
-            float wobble = 5.0f * sin(p.phase + timeMs * 0.005f);
-            curY += wobble * (1.0f - sub_t);
-        }
+    glColor3f(0.0f, 0.0f, 1.0f);
+    glPointSize(6.0f);
+    glBegin(GL_POINTS); glVertex2f(snap.beamX, snap.beamY); glEnd();
+}
 
-        float alpha = 0.8f;
-        if (p.t < 0.0f || p.t > 1.0f) alpha = 0.0f;
-        glColor4f(0.2f, 0.2f, 0.9f, alpha);
+// ------------------------------- Physical Beam --------------------------------
 
-        glBegin(GL_POINTS); glVertex2f(curX, curY); glEnd();
+// Tube z -> schematic x: cathode, anode start/end, Y plates, X plates, screen
+static float tubeToWorldX(float z) {
+    static const float tz[] = { 0.0f, tube::ANODE_Z0, tube::ANODE_Z1, tube::YPLATE_Z, tube::XPLATE_Z, tube::SCREEN_Z };
+    static const float wx[] = { filamentX0, anodeX0, anodeX1, 202.0f, platesX - 4.0f, screenCX };
+    if (z <= tz[0]) return wx[0];
+    for (int i = 1; i < 6; ++i) {
+        if (z <= tz[i]) return wx[i-1] + (wx[i] - wx[i-1]) * (z - tz[i-1]) / (tz[i] - tz[i-1]);
     }
+    return wx[5];
+}
+
+static void setPhysicsMode(bool on) {
+    physicsMode = on;
+    phosphor.lift();
+    if (on) {
+        electrons.reset(electronCount, randomSeed);
+        electrons.setSpaceCharge(spaceChargeOn ? spaceCharge : 0.0f);
+        electrons.setSolvedField(solvedField, jobs);
+        electronAcc = 0.0f;
+        // the electrons replace the staged animation: go straight to the screen stage
+        simCurr.stage = STAGE_SCREEN;
+        simCurr.progress = 0.0f;
+        simPrev = simCurr;
+    }
+}
+
+// Integrate the electrons over the frame. Plate voltages follow the same
+// signals the scripted beam uses, so the deflection comes from the fields.
+static void advanceElectrons(double tEnd) {
+    electronAcc += frameDt;
+    int steps = (int)(electronAcc / ELECTRON_DT);
+    electronAcc -= steps * ELECTRON_DT;
+    if (steps > ELECTRON_MAX_STEPS) steps = ELECTRON_MAX_STEPS;
+
+    electronDrive.resize(steps);
+    signals.evaluate(tEnd - (steps - 1) * (double)ELECTRON_DT, ELECTRON_DT, steps);
+    for (int s = 0; s < steps; ++s) {
+        electronDrive[s].plateX = PLATE_X_MAX * signals.xs[s];
+        electronDrive[s].plateY = PLATE_Y_MAX * signals.ys[s];
+    }
+    electrons.advance(electronDrive.data(), steps, ELECTRON_DT, electronHits, jobs);
+    if (electronHits.empty()) return;
+
+    // hits arrive grouped by electron block; put them back in time order
+    std::stable_sort(electronHits.begin(), electronHits.end(),
+                     [](const ScreenHit& a, const ScreenHit& b) { return a.t < b.t; });
+    // the frame's beam energy is shared between the electrons that landed
+    const float energy = PhosphorScreen::BEAM_CURRENT * frameDt / electronHits.size();
+    const double t0 = tEnd - steps * (double)ELECTRON_DT;
+    float sx = 0.0f, sy = 0.0f;
+    for (const ScreenHit& h : electronHits) {
+        float wx = screenCX + h.x * screenA / TUBE_X_AMP;
+        float wy = screenCY + h.y * screenB / TUBE_Y_AMP;
+        pathHistory.push({wx, wy});
+        if (sampleExport.isOpen()) sampleExport.add(t0 + h.t, wx, wy, 0.0f, STAGE_SCREEN);
+        phosphor.hit(wx, wy, energy);
+        sx += wx; sy += wy;
+    }
+    beamX = sx / electronHits.size();
+    beamY = sy / electronHits.size();
+}
+
+// Project the emitted electrons onto the schematic, packed for one draw call
+static void updateElectronVerts(std::vector<float>& points) {
+    points.resize(2 * electrons.size());
+    size_t n = jobs.parallelPack(electrons.size(), PARTICLE_GRAIN, points.data(), 2,
+                                 [](size_t i0, size_t i1, float* out) {
+        size_t k = 0;
+        for (size_t i = i0; i < i1; ++i) {
+            if (electrons.age[i] < 0.0f) continue;
+            out[k++] = tubeToWorldX(electrons.z[i]) + electrons.x[i] * screenA / TUBE_X_AMP;
+            out[k++] = filamentY + electrons.y[i] * screenB / TUBE_Y_AMP;
+        }
+        return k;
+    });
+    points.resize(n);
+}
+
+static void drawElectrons(const FrameSnapshot& snap) {
+    glPointSize(2.0f);
+    glColor4f(0.2f, 0.2f, 0.9f, 0.5f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, snap.points.data());
+    glDrawArrays(GL_POINTS, 0, (GLsizei)(snap.points.size() / 2));
+    glDisableClientState(GL_VERTEX_ARRAY);
 
-    computeBeamTip();
     glColor3f(0.0f, 0.0f, 1.0f);
     glPointSize(6.0f);
-    glBegin(GL_POINTS); glVertex2f(beamX, beamY); glEnd();
+    glBegin(GL_POINTS); glVertex2f(snap.beamX, snap.beamY); glEnd();
 }
 
 // ------------------------------- Viewport Inset ------------------------------
-static void drawInsetViewport() {
+static void drawInsetViewport(const FrameSnapshot& snap) {
     // 1. Get DYNAMIC window dimensions
     // This ensures that if the user maximizes, we use the real edges
     int current_W = glutGet(GLUT_WINDOW_WIDTH);
@@ -390,8 +725,9 @@ static void drawInsetViewport() {
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix(); glLoadIdentity();
 
-    // White background
-    glColor3f(1.0f, 1.0f, 1.0f);
+    // White background; dark for a TV picture
+    if (raster.enabled()) glColor3f(0.02f, 0.04f, 0.02f);
+    else glColor3f(1.0f, 1.0f, 1.0f);
     glBegin(GL_QUADS);
       glVertex2f(0,0); glVertex2f(1,0); glVertex2f(1,1); glVertex2f(0,1);
     glEnd();
@@ -403,24 +739,23 @@ static void drawInsetViewport() {
       glVertex2f(0.01f,0.01f); glVertex2f(0.99f,0.01f); glVertex2f(0.99f,0.99f); glVertex2f(0.01f,0.99f);
     glEnd();
 
-    // Map world coords to inset
-    float Wx0 = 230.0f, Wx1 = 420.0f;
-    float Wy0 = 130.0f, Wy1 = 410.0f;
-    auto mapX = [&](float wx)->float { return (wx - Wx0) / (Wx1 - Wx0); };
-    auto mapY = [&](float wy)->float { return (wy - Wy0) / (Wy1 - Wy0); };
-
-    glLineWidth(1.5f);
-    int total = (int)pathHistory.size();
-    glBegin(GL_LINE_STRIP);
-      for (int i=0; i<total; i++) {
-          float alpha = (float)i / total;
-          glColor4f(0.0f, 0.5f, 1.0f, alpha);
-          float mx = mapX(pathHistory[i].first);
-          float my = mapY(pathHistory[i].second);
-          if (mx >= 0 && mx <= 1 && my >= 0 && my <= 1)
-            glVertex2f(mx, my);
-      }
-    glEnd();
+    if (snap.showTrace) {
+        // The world->inset mapping lives in the modelview matrix so the
+        // decimated vertices are drawn as they are; the scissor clips to
+        // the box.
+        glPushMatrix();
+        glScalef(1.0f / (INSET_WX1 - INSET_WX0), 1.0f / (INSET_WY1 - INSET_WY0), 1.0f);
+        glTranslatef(-INSET_WX0, -INSET_WY0, 0.0f);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(px, py, INSET_PIX, INSET_PIX);
+        glLineWidth(1.5f);
+        drawTraceHistory(snap.trace, 0.0f, 0.5f, 1.0f);
+        glDisable(GL_SCISSOR_TEST);
+        glPopMatrix();
+    } else {
+        if (raster.enabled()) phosphorTexture.draw(snap.phosphor.data(), snap.phosphorRes, snap.frame, 0, 0, 1, 1, 0.75f, 1.0f, 0.8f);
+        else phosphorTexture.draw(snap.phosphor.data(), snap.phosphorRes, snap.frame, 0, 0, 1, 1, 0.0f, 0.5f, 1.0f);
+    }
 
     glColor3f(0.8f, 0.8f, 0.8f);
     glBegin(GL_LINES);
@@ -428,10 +763,50 @@ static void drawInsetViewport() {
       glVertex2f(0.5f, 0); glVertex2f(0.5f, 1);
     glEnd();
 
-    glColor3f(0.0f, 0.0f, 0.0f);
-    glRasterPos2f(0.05f, 0.92f);
-    std::string title = "Trace Path";
-    for(char c: title) glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, c);
+    textRenderer.addWindow(GLUT_BITMAP_HELVETICA_10, "Trace Path", px + 0.05f * INSET_PIX, py + 0.92f * INSET_PIX, 0.0f, 0.0f, 0.0f);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+// Spectrum panel above the trace inset: log frequency from spectrumRate /
+// spectrumSize to spectrumRate / 2 across, DB_FLOOR..0 dB up
+static std::string spectrumRangeLabel() {
+    char text[64];
+    const double f0 = spectrumRate / spectrumSize, f1 = 0.5 * spectrumRate;
+    if (f1 >= 1000.0) std::snprintf(text, sizeof(text), "%.3g Hz - %.3g kHz", f0, 0.001 * f1);
+    else std::snprintf(text, sizeof(text), "%.3g - %.3g Hz", f0, f1);
+    return text;
+}
+
+static void drawSpectrumInset(const FrameSnapshot& snap) {
+    int px = glutGet(GLUT_WINDOW_WIDTH) - INSET_PIX - INSET_MARGIN;
+    int py = 2 * INSET_MARGIN + INSET_PIX;
+
+    glPushAttrib(GL_VIEWPORT_BIT);
+    glViewport(px, py, INSET_PIX, INSET_PIX);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix(); glLoadIdentity();
+    gluOrtho2D(0, 1, 0, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix(); glLoadIdentity();
+
+    glColor3f(0.05f, 0.06f, 0.1f);
+    glBegin(GL_QUADS);
+      glVertex2f(0,0); glVertex2f(1,0); glVertex2f(1,1); glVertex2f(0,1);
+    glEnd();
+    drawSpectrum(snap.spectrum, 0.0f, 0.0f, 1.0f, 1.0f);
+    glLineWidth(2);
+    glColor3f(0.0f, 0.2f, 0.6f);
+    glBegin(GL_LINE_LOOP);
+      glVertex2f(0.01f,0.01f); glVertex2f(0.99f,0.01f); glVertex2f(0.99f,0.99f); glVertex2f(0.01f,0.99f);
+    glEnd();
+
+    textRenderer.addWindow(GLUT_BITMAP_HELVETICA_10, "Spectrum X / Y", px + 0.05f * INSET_PIX, py + 0.92f * INSET_PIX, 0.9f, 0.9f, 0.9f);
+    textRenderer.addWindow(GLUT_BITMAP_HELVETICA_10, spectrumRangeLabel(), px + 0.05f * INSET_PIX, py + 0.03f * INSET_PIX, 0.7f, 0.7f, 0.7f);
 
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
@@ -445,7 +820,7 @@ static void displayIntro(float timeMs) {
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    drawBackgroundGrid();
+    glCallList(staticLists + LIST_GRID);
 
     float a = introAlpha;
     if (a > 1.0f) a = 1.0f;
@@ -454,25 +829,22 @@ static void displayIntro(float timeMs) {
     float cx = (worldLeft + worldRight) * 0.5f;
     float startY = 380.0f + slide;
 
-    glColor4f(0.0f, 0.1f, 0.4f, a);
-    drawStringCentered(cx, startY, PROJECT_TITLE, GLUT_BITMAP_TIMES_ROMAN_24);
+    textRenderer.setMatrices();
+    drawStringCentered(cx, startY, PROJECT_TITLE, GLUT_BITMAP_TIMES_ROMAN_24, 0.0f, 0.1f, 0.4f, a);
 
-    glColor4f(0.2f, 0.2f, 0.2f, a);
-    drawStringCentered(cx, startY - 40, COURSE_NAME, GLUT_BITMAP_HELVETICA_18);
-    drawStringCentered(cx, startY - 65, std::string("Course Code: ") + COURSE_CODE, GLUT_BITMAP_HELVETICA_18);
+    drawStringCentered(cx, startY - 40, COURSE_NAME, GLUT_BITMAP_HELVETICA_18, 0.2f, 0.2f, 0.2f, a);
+    drawStringCentered(cx, startY - 65, std::string("Course Code: ") + COURSE_CODE, GLUT_BITMAP_HELVETICA_18, 0.2f, 0.2f, 0.2f, a);
 
-    glColor4f(0.0f, 0.0f, 0.0f, a);
-    drawStringCentered(cx, startY - 110, "Group Members:", GLUT_BITMAP_HELVETICA_18);
+    drawStringCentered(cx, startY - 110, "Group Members:", GLUT_BITMAP_HELVETICA_18, 0.0f, 0.0f, 0.0f, a);
 
     float my = startY - 140;
     for(int i=0; i<MEMBER_COUNT; i++) {
-        glColor4f(0.1f, 0.1f, 0.1f, a);
-        drawStringCentered(cx, my, MEMBERS[i], GLUT_BITMAP_HELVETICA_18);
+        drawStringCentered(cx, my, MEMBERS[i], GLUT_BITMAP_HELVETICA_18, 0.1f, 0.1f, 0.1f, a);
         my -= 25.0f;
     }
 
-    glColor4f(0.5f, 0.0f, 0.0f, a);
-    drawStringCentered(cx, 80, "Press [S] to Start Simulation", GLUT_BITMAP_HELVETICA_18);
+    drawStringCentered(cx, 80, "Press [S] to Start Simulation", GLUT_BITMAP_HELVETICA_18, 0.5f, 0.0f, 0.0f, a);
+    textRenderer.flush(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
 }
 
 // ------------------------------- Main Display --------------------------------
@@ -485,32 +857,419 @@ static void setupOrtho() {
     glLoadIdentity();
 }
 
-static void display() {
-    int timeMs = glutGet(GLUT_ELAPSED_TIME);
+// Compile the parts of the frame that never change. Nothing in them depends
+// on the window size, so they are built once after the context exists.
+static void buildStaticLists() {
+    if (!staticLists) staticLists = glGenLists(STATIC_LIST_COUNT);
 
-    if (showIntro) {
+    glNewList(staticLists + LIST_GRID, GL_COMPILE);
+    drawBackgroundGrid();
+    glEndList();
+
+    glNewList(staticLists + LIST_SPREAD_LINES, GL_COMPILE);
+    drawBeamSpreadLines();
+    glEndList();
+
+    glNewList(staticLists + LIST_STRUCTURE, GL_COMPILE);
+    drawCRTStructure();
+    glEndList();
+}
+
+// ------------------------------- Simulation ----------------------------------
+
+static void stepBeam(BeamState& s, float dt) {
+    s.progress += beamSpeed * dt;
+    if (s.progress > 1.0f) s.progress = 1.0f;
+
+    if (s.stage == STAGE_SCREEN) {
+        s.sweep += dt;
+        if (s.progress >= 1.0f) s.progress = 0.0f;
+    } else {
+        if (s.progress >= 1.0f) {
+            s.progress = 0.0f;
+            s.stage = (BeamStage)(s.stage + 1);
+        }
+    }
+}
+
+// Blend the last two simulation states into the render state. Progress
+// resets and stage changes are not blended across.
+static void interpolateBeam(float alpha) {
+    beamStage = simCurr.stage;
+    if (simPrev.stage == simCurr.stage && simCurr.progress >= simPrev.progress)
+        beamProgress = simPrev.progress + (simCurr.progress - simPrev.progress) * alpha;
+    else
+        beamProgress = simCurr.progress;
+
+    sweepTime = simPrev.sweep + (simCurr.sweep - simPrev.sweep) * alpha;
+    if (raster.enabled()) raster.valueAt(sweepTime, deflX, deflY);
+    else signals.valueAt(sweepTime, deflX, deflY);
+}
+
+// Evaluate the beam tip at the sampler's rate over the frame that just ended,
+// with the same closed form as computeBeamTip(), and feed every sample to the
+// path history and the phosphor. Only valid while the whole frame was spent
+// on the screen stage.
+static void sampleBeam() {
+    double t0 = 0.0;
+    const size_t n = beamSampler.window(sweepTime, frameDt, t0);
+    if (n == 0) return;
+    const float h = (float)(1.0 / beamSampler.rate());
+
+    // samples from where the last frame stopped up to now
+    const float back = (float)(sweepTime - t0);
+    std::vector<float>& xs = beamSampler.x;
+    std::vector<float>& ys = beamSampler.y;
+    xs.resize(n);
+    ys.resize(n);
+
+    if (raster.enabled()) {
+        // the picture is painted where the beam lands, not at the flying tip,
+        // and goes to the phosphor only
+        std::vector<float>& zs = beamSampler.z;
+        zs.resize(n);
+        jobs.parallelFor(n, SAMPLE_GRAIN, [&](size_t k0, size_t k1) {
+            raster.evaluate(t0 + k0 * (double)h, h, k1 - k0, &xs[k0], &ys[k0], &zs[k0]);
+        });
+        for (size_t k = 0; k < n; ++k) {
+            if (zs[k] > 0.0f) phosphor.hit(screenCX + screenA * xs[k], screenCY + screenB * ys[k], rasterHitEnergy * zs[k]);
+        }
+        if (sampleExport.isOpen()) {
+            // where the beam lands, blanked or not
+            for (size_t k = 0; k < n; ++k)
+                sampleExport.add(t0 + k * (double)h, screenCX + screenA * xs[k], screenCY + screenB * ys[k], 0.0f, STAGE_SCREEN);
+        }
+        return;
+    }
+
+    float p0 = beamProgress - beamSpeed * back;
+    p0 -= std::floor(p0);
+    const float dp = beamSpeed * h;
+
+    // deflection first, then mapped to the beam tip in place
+    jobs.parallelFor(n, SAMPLE_GRAIN, [&](size_t k0, size_t k1) {
+        const double t0 = t0 + k0 * (double)h;
+        signals.x.evaluate(t0, h, k1 - k0, &xs[k0]);
+        signals.y.evaluate(t0, h, k1 - k0, &ys[k0]);
+        for (size_t k = k0; k < k1; ++k) {
+            float p = p0 + dp * k;
+            p -= (float)(int)p;   // progress restarts at each flight
+            float tx = screenCX + screenA * xs[k];
+            float ty = screenCY + screenB * ys[k];
+            xs[k] = platesX + (tx - platesX) * p;
+            ys[k] = filamentY + (ty - filamentY) * p;
+        }
+    });
+    for (size_t k = 0; k < n; ++k) {
+        pathHistory.push({xs[k], ys[k]});
+        phosphor.sweep(xs[k], ys[k], h);
+    }
+    if (sampleExport.isOpen()) {
+        for (size_t k = 0; k < n; ++k) sampleExport.add(t0 + k * (double)h, xs[k], ys[k], 0.0f, STAGE_SCREEN);
+    }
+}
+
+// Feed the plate deflection since the last frame to the spectrum analyser
+// at its own rate, evaluated directly so the panel does not depend on
+// --sample-rate. A jump in the signal time, or the panel having been off,
+// starts the history over.
+static void updateSpectrum() {
+    const double h = 1.0 / spectrumRate;
+    if (spectrumNextT > sweepTime + h || sweepTime - spectrumNextT > spectrum.size() * h) {
+        spectrum.clear();
+        spectrumNextT = sweepTime;
+    }
+    if (sweepTime < spectrumNextT) return;
+    const size_t n = (size_t)((sweepTime - spectrumNextT) * spectrumRate) + 1;
+    spectrumX.resize(n);
+    spectrumY.resize(n);
+    if (raster.enabled()) {
+        spectrumZ.resize(n);
+        raster.evaluate(spectrumNextT, h, n, spectrumX.data(), spectrumY.data(), spectrumZ.data());
+    } else {
+        signals.x.evaluate(spectrumNextT, h, n, spectrumX.data());
+        signals.y.evaluate(spectrumNextT, h, n, spectrumY.data());
+    }
+    spectrum.push(spectrumX.data(), spectrumY.data(), n);
+    spectrumNextT += n * h;
+}
+
+// Run `steps` fixed steps, interpolate, then update the particles (or
+// electrons, packed into `points`) and the trace for this frame.
+static void advanceSimulation(int steps, std::vector<float>& points) {
+    float dt = (float)simClock.dt();
+    frameDt = steps * dt;
+    const BeamStage startStage = simCurr.stage;
+
+    if (!showIntro && !paused) {
+        for (int i = 0; i < steps; ++i) {
+            simPrev = simCurr;
+            stepBeam(simCurr, dt);
+        }
+        interpolateBeam((float)simClock.alpha());
+    } else {
+        simPrev = simCurr;
+        interpolateBeam(0.0f);
+    }
+
+    if (showIntro) return;
+    if (physicsMode) {
+        if (!paused) advanceElectrons(sweepTime);
+        updateElectronVerts(points);
+    } else {
+        updateParticles((float)(simClock.time() * 1000.0), frameDt, points);
+        computeBeamTip();
+        if (beamSampler.enabled() && !paused && startStage == STAGE_SCREEN && beamStage == STAGE_SCREEN) {
+            sampleBeam();
+        } else {
+            pathHistory.push({beamX, beamY});
+            if (sampleExport.isOpen() && !paused) sampleExport.add(sweepTime, beamX, beamY, 0.0f, beamStage);
+            if (!paused) beamSampler.coveredTo(sweepTime);
+            // only a beam that has reached the screen excites the phosphor
+            if (beamStage != STAGE_SCREEN) phosphor.lift();
+            else if (!paused && !raster.enabled()) phosphor.sweep(beamX, beamY, frameDt);
+        }
+    }
+    if (!paused) phosphor.decay(frameDt);
+    if (showSpectrum.load(std::memory_order_relaxed)) updateSpectrum();
+}
+
+// ------------------------------- Record and Replay ----------------------------
+
+static void recordSnapshot(const FrameSnapshot& snap) {
+    const RecordedState state = {
+        (uint8_t)snap.intro, (uint8_t)snap.physics, (uint8_t)snap.showTrace, (uint8_t)snap.stage,
+        snap.beamX, snap.beamY, snap.timeMs, snap.simMs,
+        snap.phosphorRes
+    };
+    // the snapshot holds the trace or the phosphor, whichever is shown
+    const size_t traceBytes = snap.showTrace ? snap.trace.points.size() * sizeof(TracePoint) : 0;
+    const size_t bandBytes = snap.showTrace ? sizeof(snap.trace.bandStart) : 0;
+    const size_t phosphorBytes = snap.showTrace ? 0 : snap.phosphor.size();
+    const size_t spectrumBytes = snap.showSpectrum ? snap.spectrum.size() * sizeof(float) : 0;
+
+    recorder.beginTick();
+    recorder.field(&state, sizeof(state));
+    recorder.field(snap.points.data(), snap.points.size() * sizeof(float));
+    recorder.field(snap.trace.points.data(), traceBytes);
+    recorder.field(snap.trace.bandStart, bandBytes);
+    recorder.field(snap.phosphor.data(), phosphorBytes);
+    recorder.field(snap.spectrum.data(), spectrumBytes);
+    if (!recorder.endTick()) {
+        std::fprintf(stderr, "CRT_2D: write to %s failed, recording stopped\n", recordPath.c_str());
+        recorder.close();
+    }
+}
+
+// Recorded trace fields back into a TraceSnapshot, checking the bands fit
+static bool loadTrace(const std::vector<uint8_t>& points, const std::vector<uint8_t>& bands, TraceSnapshot& trace) {
+    const size_t n = points.size() / sizeof(TracePoint);
+    trace.points.resize(n);
+    if (n) std::memcpy(trace.points.data(), points.data(), n * sizeof(TracePoint));
+    std::memcpy(trace.bandStart, bands.data(), sizeof(trace.bandStart));
+    for (int b = 0; b < TRACE_FADE_BANDS; ++b)
+        if (trace.bandStart[b] > trace.bandStart[b + 1]) return false;
+    return trace.bandStart[TRACE_FADE_BANDS] <= n;
+}
+
+// Fill snap from recorded tick t; false if the tick does not decode
+static bool loadSnapshot(size_t t, FrameSnapshot& snap) {
+    if (!replay.seek(t)) return false;
+    const std::vector<uint8_t>& state = replay.field(REC_STATE);
+    const std::vector<uint8_t>& points = replay.field(REC_POINTS);
+    const std::vector<uint8_t>& trace = replay.field(REC_TRACE);
+    const std::vector<uint8_t>& bands = replay.field(REC_TRACE_BANDS);
+    const std::vector<uint8_t>& image = replay.field(REC_PHOSPHOR);
+    const std::vector<uint8_t>& levels = replay.field(REC_SPECTRUM);
+    RecordedState s;
+    if (state.size() != sizeof(s) || points.size() % sizeof(float) || trace.size() % sizeof(TracePoint)) return false;
+    if (levels.size() % sizeof(float)) return false;
+    std::memcpy(&s, state.data(), sizeof(s));
+    if (!s.showTrace && (s.phosphorRes <= 0 || image.size() != (size_t)s.phosphorRes * s.phosphorRes)) return false;
+    if (s.showTrace && bands.size() != sizeof(snap.trace.bandStart)) return false;
+
+    snap.intro = s.intro;
+    snap.physics = s.physics;
+    snap.showTrace = s.showTrace;
+    snap.stage = (BeamStage)s.stage;
+    snap.beamX = s.beamX;
+    snap.beamY = s.beamY;
+    snap.timeMs = s.timeMs;
+    snap.points.resize(points.size() / sizeof(float));
+    if (!points.empty()) std::memcpy(snap.points.data(), points.data(), points.size());
+    if (snap.showTrace) {
+        if (!loadTrace(trace, bands, snap.trace)) return false;
+    } else {
+        snap.phosphor = image;
+        snap.phosphorRes = s.phosphorRes;
+    }
+    snap.showSpectrum = !levels.empty();
+    snap.spectrum.resize(levels.size() / sizeof(float));
+    if (!levels.empty()) std::memcpy(snap.spectrum.data(), levels.data(), levels.size());
+    return true;
+}
+
+// Open the --record or --replay file and the --export file; a replay also
+// brings back the run settings stored with it. False (with a message) if the file cannot be used.
+static bool openRecording() {
+    if (!replayPath.empty()) {
+        RecordInfo info;
+        if (!replay.open(replayPath.c_str()) || replay.ticks() == 0 || replay.infoSize() != sizeof(info) ||
+            replay.fieldsPerTick() != REC_FIELD_COUNT) {
+            std::fprintf(stderr, "CRT_2D: %s is not a CRT_2D recording\n", replayPath.c_str());
+            return false;
+        }
+        std::memcpy(&info, replay.info(), sizeof(info));
+        rasterLines = info.rasterLines;
+        spectrumSize = (size_t)info.spectrumSize;
+        spectrumRate = info.spectrumRate;
+        replayTick = std::min(replayTick, replay.ticks() - 1);
+        if (!recordPath.empty()) std::fprintf(stderr, "CRT_2D: --record is ignored while replaying\n");
+    } else if (!recordPath.empty()) {
+        const RecordInfo info = { rasterLines, (int32_t)spectrumSize, spectrumRate };
+        if (!recorder.open(recordPath.c_str(), REC_FIELD_COUNT, &info, sizeof(info))) {
+            std::fprintf(stderr, "CRT_2D: cannot write %s\n", recordPath.c_str());
+            return false;
+        }
+    }
+    if (!exportPath.empty() && replayPath.empty() && !sampleExport.open(exportPath.c_str())) {
+        std::fprintf(stderr, "CRT_2D: cannot write %s\n", exportPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Keys that change the simulation, applied on the simulation thread
+static void runCommand(unsigned char key) {
+    switch (key) {
+        case 's': showIntro = false; paused = false; break;
+        case 'p': paused = !paused; break;
+        case 'm': setPhysicsMode(!physicsMode); break;
+        case 'c':
+            spaceChargeOn = !spaceChargeOn;
+            electrons.setSpaceCharge(spaceChargeOn ? spaceCharge : 0.0f);
+            break;
+        case 'l':
+            solvedField = !solvedField;
+            electrons.setSolvedField(solvedField, jobs);
+            break;
+        case 'r':
+            paused = true;
+            simCurr.stage = STAGE_FILAMENT;
+            simCurr.progress = 0.0f;
+            simPrev = simCurr;
+            pathHistory.clear();
+            phosphor.clear();
+            beamSampler.restart();
+            break;
+    }
+}
+
+// One update of the simulation thread: apply the queued keys, advance by
+// `steps` fixed steps and publish what display() needs as a snapshot
+static void simulateFrame(int steps) {
+    commands.drain(runCommand);
+
+    FrameSnapshot& snap = snapshots.back();
+    FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+    advanceSimulation(steps, snap.points);
+    snap.simMs = (float)FrameTimings::msSince(t0);
+
+    snap.intro = showIntro;
+    snap.physics = physicsMode;
+    snap.stage = beamStage;
+    snap.beamX = beamX;
+    snap.beamY = beamY;
+    snap.timeMs = (float)(simClock.time() * 1000.0);
+    snap.showTrace = showTrace.load(std::memory_order_relaxed);
+    if (snap.showTrace) {
+        pathHistory.copyTo(snap.trace);
+    } else {
+        const size_t cells = (size_t)phosphor.resolution() * phosphor.resolution();
+        snap.phosphor.assign(phosphor.image(), phosphor.image() + cells);
+        snap.phosphorRes = phosphor.resolution();
+    }
+    snap.showSpectrum = showSpectrum.load(std::memory_order_relaxed);
+    if (snap.showSpectrum) snap.spectrum = spectrum.levelsXY();
+    snap.frame = ++snapshotCount;
+    if (recorder.isOpen()) recordSnapshot(snap);
+    if (sampleExport.isOpen()) sampleExport.flush();
+    snapshots.publish();
+}
+
+// Replay update: apply the replay keys, decode the current tick into the
+// snapshot and step to the next one. The simulate time is the decode time.
+static void replayFrame() {
+    commands.drain([](unsigned char key) {
+        const size_t last = replay.ticks() - 1;
+        switch (key) {
+            case 'p': replayPaused = !replayPaused; break;
+            case 'r': replayTick = 0; break;
+            case '[': replayTick = replayTick > (size_t)REPLAY_JUMP ? replayTick - REPLAY_JUMP : 0; break;
+            case ']': replayTick = std::min(last, replayTick + REPLAY_JUMP); break;
+        }
+        if (key == 'r' || key == '[' || key == ']') replayDamaged = false;
+    });
+    if (replayDamaged) return;   // until a seek
+
+    FrameSnapshot& snap = snapshots.back();
+    FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+    if (!loadSnapshot(replayTick, snap)) {
+        std::fprintf(stderr, "CRT_2D: %s is damaged at tick %zu\n", replayPath.c_str(), replayTick);
+        replayDamaged = true;
+        return;
+    }
+    snap.simMs = (float)FrameTimings::msSince(t0);
+    snap.frame = ++snapshotCount;
+    snapshots.publish();
+    if (!replayPaused && replayTick + 1 < replay.ticks()) ++replayTick;
+}
+
+static void display() {
+    const FrameSnapshot& snap = snapshots.acquire();
+    if (snap.intro) {
         setupOrtho();
-        displayIntro((float)timeMs);
+        displayIntro(snap.timeMs);
         glutSwapBuffers();
         return;
     }
 
+    // the update ran on the simulation thread; its time is charged to the
+    // frame that shows it
+    profiler.beginFrame();
+    profiler.record(PROF_SIMULATE, snap.simMs);
+
     glClear(GL_COLOR_BUFFER_BIT);
 
     setupOrtho();
+    textRenderer.setMatrices();
+
+    { ProfileScope scope(profiler, PROF_GRID); glCallList(staticLists + LIST_GRID); }
+    { ProfileScope scope(profiler, PROF_SPREAD); drawBeamSpreadRegion(snap); }
+    {
+        ProfileScope scope(profiler, PROF_STRUCTURE);
+        glCallList(staticLists + LIST_STRUCTURE);
+        queueSchematicLabels();
+    }
+    {
+        ProfileScope scope(profiler, PROF_BEAM);
+        if (snap.physics) drawElectrons(snap);
+        else drawBeamAndParticles(snap);
+    }
+    {
+        ProfileScope scope(profiler, PROF_INSET);
+        drawInsetViewport(snap);
+        if (snap.showSpectrum) drawSpectrumInset(snap);
+    }
+    {
+        ProfileScope scope(profiler, PROF_TEXT);
+        drawString(10, 15, "Controls: [S] Start/Skip  [P] Pause  [R] Reset  [M] Physics  [C] Charge  [L] Field  [T] Trace  [A] Spectrum  [F] Stats  [E] Export  [Esc] Exit",
+                   GLUT_BITMAP_HELVETICA_12, 0.4f, 0.4f, 0.4f);
+        textRenderer.flush(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+    }
 
-    drawBackgroundGrid();
-    drawBeamSpreadRegion();
-    drawCRTStructure();
-    drawBeamAndParticles((float)timeMs);
-
-    pathHistory.emplace_back(beamX, beamY);
-    if (pathHistory.size() > PATH_HISTORY_MAX) pathHistory.erase(pathHistory.begin());
-
-    drawInsetViewport();
-
-    glColor3f(0.4f, 0.4f, 0.4f);
-    drawString(10, 15, "Controls: [S] Start/Skip  [P] Pause  [R] Reset  [Esc] Exit", GLUT_BITMAP_HELVETICA_12);
+    if (showProfiler) profiler.drawOverlay(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+    profiler.endFrame();
 
     glutSwapBuffers();
 }
@@ -542,7 +1301,7 @@ static void reshape(int w, int h) {
 // ------------------------------- Timer and Input ------------------------------
 
 static void timerFunc(int) {
-    if (showIntro && !introEffectsDone) {
+    if (!introEffectsDone) {
         introAlpha += 0.015f;
         introSlide += 0.8f;
         if (introAlpha >= 1.0f) introAlpha = 1.0f;
@@ -550,21 +1309,7 @@ static void timerFunc(int) {
         if (introAlpha >= 1.0f && introSlide >= 0.0f) introEffectsDone = true;
     }
 
-    if (!showIntro && !paused) {
-        beamProgress += beamSpeed;
-        if (beamProgress > 1.0f) beamProgress = 1.0f;
-
-        if (beamStage == STAGE_SCREEN) {
-            screenTheta += 0.02f;
-            if (screenTheta > 6.283f) screenTheta -= 6.283f;
-            if (beamProgress >= 1.0f) beamProgress = 0.0f;
-        } else {
-            if (beamProgress >= 1.0f) {
-                beamProgress = 0.0f;
-                beamStage = (BeamStage)(beamStage + 1);
-            }
-        }
-    }
+    // The simulation runs on simThread; this only asks for the newest snapshot
     glutPostRedisplay();
     glutTimerFunc(TIMER_MS, timerFunc, 0);
 }
@@ -573,18 +1318,331 @@ static void timerFunc(int) {
 static void keyboardHandler(unsigned char key, int, int) {
     switch (key) {
         case 27: std::exit(0); break;
-        case 's': case 'S': showIntro = false; paused = false; break;
-        case 'p': case 'P': paused = !paused; break;
-        case 'r': case 'R':
-            paused = true;
-            beamStage = STAGE_FILAMENT;
-            beamProgress = 0.0f;
-            pathHistory.clear();
+        case 's': case 'S': commands.push('s'); break;
+        case 'p': case 'P': commands.push('p'); break;
+        case 'm': case 'M': commands.push('m'); break;
+        case 'c': case 'C': commands.push('c'); break;
+        case 'l': case 'L': commands.push('l'); break;
+        case 'r': case 'R': commands.push('r'); break;
+        case '[': case ']': commands.push(key); break;
+        case 't': case 'T': showTrace = !showTrace; break;
+        case 'a': case 'A': showSpectrum = !showSpectrum; break;
+        case 'f': case 'F': showProfiler = !showProfiler; break;
+        case 'e': case 'E':
+            if (profiler.writeCsv(PROFILE_CSV)) std::printf("Frame profile written to %s\n", PROFILE_CSV);
+            else std::fprintf(stderr, "CRT_2D: cannot write %s\n", PROFILE_CSV);
             break;
     }
 }
 
+// ------------------------------- Headless Mode --------------------------------
+
+// World -> canvas pixels, fitted to the canvas the same way reshape() fits
+// the ortho view to the window
+struct SoftView {
+    float x0, y0, sx, sy;
+    void map(float wx, float wy, float& px, float& py) const {
+        px = (wx - x0) * sx;
+        py = (wy - y0) * sy;
+    }
+};
+
+static SoftView fitWorldToCanvas(int w, int h) {
+    float l = worldLeft, r = worldRight, b = worldBottom, t = worldTop;
+    float worldAspect = (r - l) / (t - b);
+    float canvasAspect = (float)w / (float)h;
+    if (canvasAspect > worldAspect) {
+        float newWidth = (t - b) * canvasAspect;
+        float center = (l + r) / 2.0f;
+        l = center - newWidth/2.0f; r = center + newWidth/2.0f;
+    } else {
+        float newHeight = (r - l) / canvasAspect;
+        float center = (b + t) / 2.0f;
+        b = center - newHeight/2.0f; t = center + newHeight/2.0f;
+    }
+    return { l, b, w / (r - l), h / (t - b) };
+}
+
+static void softLine(SoftCanvas& c, const SoftView& v, float x0, float y0, float x1, float y1,
+                     const SoftColor& col, float width = 1.0f) {
+    float ax, ay, bx, by;
+    v.map(x0, y0, ax, ay);
+    v.map(x1, y1, bx, by);
+    c.line(ax, ay, bx, by, col, width);
+}
+
+static void softPoints(SoftCanvas& c, const SoftView& v, const float* xy, size_t n,
+                       float size, const SoftColor& col) {
+    for (size_t i = 0; i < n; ++i) {
+        float px, py;
+        v.map(xy[2*i], xy[2*i + 1], px, py);
+        c.point(px, py, size, col);
+    }
+}
+
+// The simulation scene of display() on the CPU rasterizer. Text labels are
+// left out (there are no fonts without GLUT).
+static void renderSoft(SoftCanvas& c, const FrameSnapshot& snap) {
+    const SoftView v = fitWorldToCanvas(c.width, c.height);
+    c.noClip();
+    c.clear(0.94f, 0.96f, 1.0f);
+
+    const SoftColor grid = { 0.8f, 0.85f, 0.9f, 0.5f };
+    for (float x = worldLeft; x <= worldRight; x += 25.0f) softLine(c, v, x, worldBottom, x, worldTop, grid);
+    for (float y = worldBottom; y <= worldTop; y += 25.0f) softLine(c, v, worldLeft, y, worldRight, y, grid);
+
+    // Beam spread region (drawn solid; there is no line stipple)
+    float spread[6] = { spreadX0, spreadY0, screenCX, screenCY + screenB - 10, screenCX, screenCY - screenB + 10 };
+    const SoftColor spreadLine = { 0.6f, 0.6f, 0.6f, 0.5f };
+    softLine(c, v, spread[0], spread[1], spread[2], spread[3], spreadLine);
+    softLine(c, v, spread[0], spread[1], spread[4], spread[5], spreadLine);
+    if (snap.stage == STAGE_SCREEN || snap.stage == STAGE_DEFLECTION) {
+        for (int i = 0; i < 3; ++i) v.map(spread[2*i], spread[2*i + 1], spread[2*i], spread[2*i + 1]);
+        c.convex(spread, 3, { 0.0f, 0.5f, 1.0f, 0.05f });
+    }
+
+    for (int i = 0; i < SCHEMATIC_PARTS; ++i) {
+        const SchematicPart& part = SCHEMATIC[i];
+        const SoftColor col = { part.r, part.g, part.b, 1.0f };
+        if (part.lineWidth > 0.0f) {
+            for (int k = 0; k + 1 < part.vertexCount; k += 2)
+                softLine(c, v, part.xy[2*k], part.xy[2*k + 1], part.xy[2*k + 2], part.xy[2*k + 3], col, part.lineWidth);
+        } else {
+            for (int k = 0; k + 3 < part.vertexCount; k += 4) {
+                float quad[8];
+                for (int j = 0; j < 4; ++j) v.map(part.xy[2*(k + j)], part.xy[2*(k + j) + 1], quad[2*j], quad[2*j + 1]);
+                c.convex(quad, 4, col);
+            }
+        }
+    }
+
+    // Screen
+    float ellipse[2 * 72];
+    for (int k = 0; k < 72; ++k) {
+        float t = k * 5.0f * 3.14159f / 180.0f;
+        v.map(screenCX + screenA * std::cos(t), screenCY + screenB * std::sin(t), ellipse[2*k], ellipse[2*k + 1]);
+    }
+    c.convex(ellipse, 72, { 0.2f, 0.8f, 0.2f, 0.1f });
+    for (int k = 0; k < 72; ++k) {
+        int n = (k + 1) % 72;
+        c.line(ellipse[2*k], ellipse[2*k + 1], ellipse[2*n], ellipse[2*n + 1], { 0.1f, 0.1f, 0.1f, 1.0f }, 2.0f);
+    }
+
+    const size_t points = snap.points.size() / 2;
+    if (snap.physics) softPoints(c, v, snap.points.data(), points, 2.0f, { 0.2f, 0.2f, 0.9f, 0.5f });
+    else softPoints(c, v, snap.points.data(), points, 3.0f, { 0.2f, 0.2f, 0.9f, 0.8f });
+    float tipX, tipY;
+    v.map(snap.beamX, snap.beamY, tipX, tipY);
+    c.point(tipX, tipY, 6.0f, { 0.0f, 0.0f, 1.0f, 1.0f });
+
+    // Inset, same placement and world window as drawInsetViewport()
+    const float px = (float)(c.width - INSET_PIX - INSET_MARGIN), py = (float)INSET_MARGIN;
+    const float S = (float)INSET_PIX;
+    float box[8] = { px, py, px + S, py, px + S, py + S, px, py + S };
+    if (raster.enabled()) c.convex(box, 4, { 0.02f, 0.04f, 0.02f, 1.0f });
+    else c.convex(box, 4, { 1.0f, 1.0f, 1.0f, 1.0f });
+    const SoftColor border = { 0.0f, 0.2f, 0.6f, 1.0f };
+    float b0 = 0.01f * S, b1 = 0.99f * S;
+    c.line(px + b0, py + b0, px + b1, py + b0, border, 2.0f);
+    c.line(px + b1, py + b0, px + b1, py + b1, border, 2.0f);
+    c.line(px + b1, py + b1, px + b0, py + b1, border, 2.0f);
+    c.line(px + b0, py + b1, px + b0, py + b0, border, 2.0f);
+
+    if (snap.showTrace) {
+        float sx = S / (INSET_WX1 - INSET_WX0), sy = S / (INSET_WY1 - INSET_WY0);
+        c.clip((int)px, (int)py, INSET_PIX, INSET_PIX);
+        softTrace(c, snap.trace, px - INSET_WX0 * sx, py - INSET_WY0 * sy, sx, sy, { 0.0f, 0.5f, 1.0f, 1.0f }, TRACE_FADE_BANDS);
+        c.noClip();
+    } else {
+        SoftColor glow = raster.enabled() ? SoftColor{ 0.75f, 1.0f, 0.8f, 1.0f } : SoftColor{ 0.0f, 0.5f, 1.0f, 1.0f };
+        softAlphaImage(c, snap.phosphor.data(), snap.phosphorRes, px, py, S, glow);
+    }
+
+    const SoftColor cross = { 0.8f, 0.8f, 0.8f, 1.0f };
+    c.line(px, py + 0.5f * S, px + S, py + 0.5f * S, cross);
+    c.line(px + 0.5f * S, py, px + 0.5f * S, py + S, cross);
+
+    if (snap.showSpectrum) {
+        const float qy = py + INSET_MARGIN + S;
+        float panel[8] = { px, qy, px + S, qy, px + S, qy + S, px, qy + S };
+        c.convex(panel, 4, { 0.05f, 0.06f, 0.1f, 1.0f });
+        softSpectrum(c, snap.spectrum, px, qy, S, S, SPECTRUM_GRID_DB, SpectrumAnalyzer::DB_FLOOR);
+        c.line(px + b0, qy + b0, px + b1, qy + b0, border, 2.0f);
+        c.line(px + b1, qy + b0, px + b1, qy + b1, border, 2.0f);
+        c.line(px + b1, qy + b1, px + b0, qy + b1, border, 2.0f);
+        c.line(px + b0, qy + b1, px + b0, qy + b0, border, 2.0f);
+    }
+}
+
+static void printFieldSolve() {
+    const FieldSolver& grid = electrons.fieldGrid();
+    const FieldSolveStats& s = electrons.fieldSolveStats();
+    std::printf("Field solve: 3 potentials on %dx%dx%d nodes, %d sweeps (omega %.2f), last change %.1e, %.2f ms\n",
+                grid.sizeX(), grid.sizeY(), grid.sizeZ(), s.sweeps, grid.overRelaxation(), s.residual, s.ms);
+}
+
+// Barnes-Hut tree against the direct sum on the final beam
+static void printSpaceChargeCheck() {
+    const SpaceChargeCheck c = electrons.checkSpaceCharge(jobs);
+    std::printf("Space charge, %zu electrons: tree %.2f ms (%zu nodes, %.0f interactions each), direct %.2f ms, "
+                "error rms %.2e max %.2e\n", c.electrons, c.treeMs, c.nodes, c.interactions, c.directMs,
+                c.rmsError, c.maxError);
+}
+
+// Run headlessFrames frames at a fixed 1/HEADLESS_FPS step without GLUT,
+// optionally dumping them, and print per-frame timing statistics. The
+// simulation runs on this thread, one snapshot per frame. Frame writes are
+// not included in the timings. A replay renders the recorded ticks from
+// --replay-from on, up to N of them.
+static int runHeadless() {
+    if (!openRecording()) return 1;
+    initSimulation();
+    if (physicsMode) setPhysicsMode(true);
+    showIntro = false;
+    paused = false;
+    const bool replaying = !replayPath.empty();
+    if (replaying) headlessFrames = (int)std::min((size_t)headlessFrames, replay.ticks() - replayTick);
+    const size_t firstTick = replayTick;
+
+    SoftCanvas canvas(headlessW, headlessH);
+    FrameDumper dumper;
+    if (!dumpPath.empty() && !dumper.open(dumpPath, headlessW, headlessH, HEADLESS_FPS)) {
+        std::fprintf(stderr, "CRT_2D: cannot open %s\n", dumpPath.c_str());
+        return 1;
+    }
+
+    FrameTimings simTimes, renderTimes, frameTimes;
+    for (int f = 0; f < headlessFrames; ++f) {
+        FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+        if (replaying) replayFrame();
+        else simulateFrame(simClock.advanceBy(1.0 / HEADLESS_FPS));
+        if (replayDamaged) return 1;
+        double simMs = FrameTimings::msSince(t0);
+
+        FrameTimings::Clock::time_point t1 = FrameTimings::Clock::now();
+        renderSoft(canvas, snapshots.acquire());
+        double renderMs = FrameTimings::msSince(t1);
+
+        simTimes.add(simMs);
+        renderTimes.add(renderMs);
+        frameTimes.add(simMs + renderMs);
+
+        if (!dumpPath.empty() && !dumper.write(canvas, f)) {
+            std::fprintf(stderr, "CRT_2D: write to %s failed at frame %d\n", dumpPath.c_str(), f);
+            return 1;
+        }
+    }
+    if (!dumper.close()) {
+        std::fprintf(stderr, "CRT_2D: write to %s failed\n", dumpPath.c_str());
+        return 1;
+    }
+
+    if (replaying) {
+        std::printf("CRT_2D headless: %d frames, %dx%d, replay of %s from tick %zu\n", headlessFrames,
+                    headlessW, headlessH, replayPath.c_str(), firstTick);
+    } else {
+        std::printf("CRT_2D headless: %d frames, %dx%d, %d fps fixed step, %s, seed %llu, threads %u\n", headlessFrames,
+                    headlessW, headlessH, HEADLESS_FPS,
+                    physicsMode ? (spaceChargeOn ? "physics with space charge" : "physics") : "scripted",
+                    (unsigned long long)randomSeed, jobs.threadCount());
+    }
+    if (recorder.isOpen()) {
+        const unsigned long long ticks = recorder.ticks();
+        if (!recorder.close()) {
+            std::fprintf(stderr, "CRT_2D: write to %s failed\n", recordPath.c_str());
+            return 1;
+        }
+        std::printf("Recorded %llu ticks to %s\n", ticks, recordPath.c_str());
+    }
+    if (sampleExport.isOpen()) {
+        if (!sampleExport.close()) {
+            std::fprintf(stderr, "CRT_2D: write to %s failed\n", exportPath.c_str());
+            return 1;
+        }
+        std::printf("Exported %llu beam samples to %s (%llu dropped)\n", (unsigned long long)sampleExport.samplesWritten(),
+                    exportPath.c_str(), (unsigned long long)sampleExport.samplesDropped());
+    }
+    simTimes.print(replaying ? "decode" : "simulate");
+    renderTimes.print("render");
+    frameTimes.print("frame");
+    if (solvedField && physicsMode && !replaying) printFieldSolve();
+    if (spaceChargeCheck && physicsMode && !replaying) printSpaceChargeCheck();
+    return 0;
+}
+
+// Options are parsed before glutInit() so --headless never needs a display;
+// GLUT's own options are skipped here
+static void parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--particles" && i + 1 < argc) {
+            numParticles = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--trace-depth" && i + 1 < argc) {
+            traceDepth = (size_t)std::max(2L, std::atol(argv[++i]));
+        } else if (arg == "--persistence" && i + 1 < argc) {
+            persistence = (float)std::atof(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threadCount = (unsigned)std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            randomSeed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--physics" && i + 1 < argc) {
+            electronCount = (size_t)std::max(1L, std::atol(argv[++i]));
+            physicsMode = true;
+        } else if (arg == "--space-charge" && i + 1 < argc) {
+            spaceCharge = std::max(0.0f, (float)std::atof(argv[++i]));
+            spaceChargeOn = spaceCharge > 0.0f;
+        } else if (arg == "--space-charge-check") {
+            spaceChargeCheck = true;
+        } else if (arg == "--solved-field") {
+            solvedField = true;
+        } else if (arg == "--sample-rate" && i + 1 < argc) {
+            beamSampler.setRate(std::atof(argv[++i]));
+        } else if ((arg == "--signal-x" || arg == "--signal-y") && i + 1 < argc) {
+            SignalChannel& channel = arg == "--signal-x" ? signals.x : signals.y;
+            if (!channel.parse(argv[++i])) std::fprintf(stderr, "CRT_2D: ignoring bad signal '%s'\n", argv[i]);
+        } else if (arg == "--raster" && i + 1 < argc) {
+            rasterLines = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--raster-input" && i + 1 < argc) {
+            rasterInput = argv[++i];
+            if (rasterLines == 0) rasterLines = 480;
+        } else if (arg == "--sim-hz" && i + 1 < argc) {
+            simClock.setRate(std::atof(argv[++i]));
+        } else if (arg == "--time-scale" && i + 1 < argc) {
+            simClock.setTimeScale(std::atof(argv[++i]));
+        } else if (arg == "--headless" && i + 1 < argc) {
+            headlessFrames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--size" && i + 1 < argc) {
+            int w = 0, h = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+                headlessW = w;
+                headlessH = h;
+            }
+        } else if (arg == "--dump" && i + 1 < argc) {
+            dumpPath = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--export" && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (arg == "--spectrum") {
+            showSpectrum = true;
+        } else if (arg == "--spectrum-size" && i + 1 < argc) {
+            spectrumSize = (size_t)std::max(16L, std::atol(argv[++i]));
+        } else if (arg == "--spectrum-rate" && i + 1 < argc) {
+            spectrumRate = std::max(1.0, std::atof(argv[++i]));
+        } else if (arg == "--replay-from" && i + 1 < argc) {
+            replayTick = (size_t)std::max(0LL, std::atoll(argv[++i]));
+        }
+    }
+}
+
 int main(int argc, char** argv) {
+    parseArgs(argc, argv);
+    jobs.start(threadCount);
+    if (headlessFrames > 0) return runHeadless();
+    if (!openRecording()) return 1;
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
     glutInitWindowSize(WIN_W, WIN_H);
@@ -592,6 +1650,16 @@ int main(int argc, char** argv) {
     glutCreateWindow("CRT Simulation");
 
     initGL();
+    buildStaticLists();
+    initSimulation();
+    if (!replayPath.empty()) {
+        replayFrame();
+        simThread.start(TIMER_MS, replayFrame);
+    } else {
+        if (physicsMode) setPhysicsMode(true);
+        simulateFrame(0);
+        simThread.start(TIMER_MS, []() { simulateFrame(simClock.advance()); });
+    }
 
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
@@ -1,10 +1,11 @@
 // CRT_3D_Labeled.cpp
 //
 // Build (Ubuntu):
-//  g++ CRT_3D_Labeled.cpp -o CRT_3D -lGL -lGLU -lglut -std=c++11
+//  g++ CRT_3D.cpp -o CRT_3D -std=c++17 -O3 -fno-trapping-math -fno-math-errno -pthread -lGL -lGLU -lglut
 //   ./CRT_3D
 // ------------------------------------------------------------------------------
 
+#define GL_GLEXT_PROTOTYPES   // timer query entry points (CRT_Profiler.h)
 #include <GL/glut.h>
 #include <cmath>
 #include <vector>
@@ -12,6 +13,27 @@
 #include <cstdlib>
 #include <ctime>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "CRT_BeamSampler.h"
+#include "CRT_Electrons.h"
+#include "CRT_Headless.h"
+#include "CRT_Heatmap.h"
+#include "CRT_Jobs.h"
+#include "CRT_Phosphor.h"
+#include "CRT_PointSprites.h"
+#include "CRT_Profiler.h"
+#include "CRT_Random.h"
+#include "CRT_Raster.h"
+#include "CRT_Recorder.h"
+#include "CRT_SampleExport.h"
+#include "CRT_Signal.h"
+#include "CRT_SimClock.h"
+#include "CRT_SimThread.h"
+#include "CRT_Spectrum.h"
+#include "CRT_Text.h"
+#include "CRT_TraceHistory.h"
 
 // --------------------------- Configuration ------------------------------------
 static const int WIN_W = 1000;
@@ -24,6 +46,12 @@ float camDist = 28.0f;    // Zoom (Slightly further back to see labels)
 int lastMouseX = -1, lastMouseY = -1;
 bool isDragging = false;
 
+// Animation timing
+static const int TIMER_MS = 16;          // ~60 FPS redraw
+static const float beamSpeed = 0.9375f;  // stage progress per second
+static const float thetaSpeed = 3.125f;  // default screen sweep, radians per second
+static const double SIM_HZ = 10000.0;    // default fixed simulation rate
+
 // CRT Geometry constants
 const float SCREEN_W = 4.0f;
 const float SCREEN_H = 3.0f;
@@ -32,9 +60,34 @@ const float SCREEN_H = 3.0f;
 enum BeamStage { STAGE_FILAMENT = 0, STAGE_ANODE, STAGE_DEFLECTION, STAGE_SCREEN };
 bool showIntro = true;
 bool paused = true;
+
+// Simulation state, advanced in fixed steps by stepBeam()
+struct BeamState {
+    BeamStage stage;
+    float progress;
+    double sweep;                // seconds spent on the screen stage
+};
+BeamState simPrev = { STAGE_FILAMENT, 0.0f, 0.0f };
+BeamState simCurr = { STAGE_FILAMENT, 0.0f, 0.0f };
+SimClock simClock(SIM_HZ);
+float frameDt = 0.0f;            // simulated seconds covered by this frame
+
+// Render state: interpolated between simPrev and simCurr each frame
 BeamStage beamStage = STAGE_FILAMENT;
 float beamProgress = 0.0f;
-float screenTheta = 0.0f;
+double sweepTime = 0.0;          // signal time base
+float deflX = 0.0f, deflY = 0.0f; // plate deflection at sweepTime, +-1 full scale
+
+// Plate deflection signals (--signal-x / --signal-y). The default is the
+// figure-eight sweep: cos(theta) on X, sin(2 theta) on Y.
+SignalGenerator defaultSignals() {
+    SignalGenerator g;
+    g.x.frequency = thetaSpeed / 6.283185f;
+    g.x.phase = 0.25f;
+    g.y.frequency = 2.0f * g.x.frequency;
+    return g;
+}
+SignalGenerator signals = defaultSignals();
 
 // Beam Data
 float beamTipX = 0, beamTipY = 0, beamTipZ = 0;
@@ -44,17 +97,217 @@ float introAlpha = 0.0f;
 bool introEffectsDone = false;
 
 // 2D Trace History
-std::vector<std::pair<float,float>> traceHistory;
-
-// Particles
-struct Particle {
-    float t;
-    float speed;
-    float offsetR;
-    float offsetA;
+TraceHistory traceHistory;
+size_t traceDepth = 500;          // --trace-depth N
+
+// HUD inset and the part of the screen it shows
+const int HUD_INSET_SIZE = 150;
+const int HUD_MARGIN = 20;
+const float HUD_MAP_MIN = -2.5f;
+const float HUD_MAP_MAX = 2.5f;
+
+// Phosphor screen shown in the inset; [T] shows the replayed trace instead
+PhosphorScreen phosphor;
+float persistence = 1.5f;         // --persistence SECONDS
+std::atomic<bool> showTrace{false};
+
+// Where the beam has landed over the whole run; [H] shows it in the inset,
+// [X] saves it (to --heatmap FILE, which headless runs write at the end)
+static const int HEATMAP_RES = 256;
+static const char* HEATMAP_FILE = "CRT_3D_heatmap.bin";
+ImpactHeatmap heatmap;
+std::atomic<bool> showHeatmap{false};
+std::string heatmapPath;
+
+// Sub-frame sampling of the scripted beam (--sample-rate HZ)
+BeamSampler beamSampler;
+
+// Spectrum panel ([A] or --spectrum): the plate deflection sampled at
+// --spectrum-rate HZ and analysed in --spectrum-size N point blocks by
+// CRT_Spectrum.h, shown in a second inset above the first
+static const double SPECTRUM_RATE = 65536.0;
+static const size_t SPECTRUM_SIZE = 65536;
+SpectrumAnalyzer spectrum;
+double spectrumRate = SPECTRUM_RATE;
+size_t spectrumSize = SPECTRUM_SIZE;
+double spectrumNextT = 0.0;       // signal time of the next analysis sample
+std::vector<float> spectrumX, spectrumY, spectrumZ;
+std::atomic<bool> showSpectrum{false};
+
+// Thread pool for the particle, electron and beam-sample updates
+// (--threads N, default every core); work is split into chunks of these sizes
+static const size_t PARTICLE_GRAIN = 8192;
+static const size_t SAMPLE_GRAIN = 16384;
+JobSystem jobs;
+unsigned threadCount = 0;
+
+// Raster TV mode (--raster LINES, --raster-input FILE): replaces the signal
+// generator for the scripted beam and paints a picture into the phosphor,
+// which is then also shown on the tube's screen
+static const double RASTER_SAMPLE_HZ = 10e6;
+static const int RASTER_PHOSPHOR_RES = 512;
+RasterScan raster;
+int rasterLines = 0;
+std::string rasterInput;
+float rasterHitEnergy = 0.0f;
+
+// Physical beam mode ([M] or --physics N): electrons integrated through the
+// tube fields instead of the scripted stage animation
+static const float ELECTRON_DT = 1.0f / 2000.0f;  // integrator substep (s)
+static const int ELECTRON_MAX_STEPS = 64;         // substeps per frame at most
+const float PLATE_X_MAX = tube::plateVoltageFor(SCREEN_W/2.5f, tube::XPLATE_Z);
+const float PLATE_Y_MAX = tube::plateVoltageFor(SCREEN_H/2.5f, tube::YPLATE_Z);
+bool physicsMode = false;
+size_t electronCount = 100000;
+uint64_t randomSeed = (uint64_t)time(0);   // --seed N for reproducible runs
+ElectronBeam electrons;
+std::vector<TubeDrive> electronDrive;
+std::vector<ScreenHit> electronHits;
+float electronAcc = 0.0f;
+// Electron-electron repulsion ([C] or --space-charge Q), see CRT_SpaceCharge.h
+static const float SPACE_CHARGE_DEFAULT = 0.1f;   // total beam charge when [C] turns it on
+float spaceCharge = SPACE_CHARGE_DEFAULT;
+bool spaceChargeOn = false;
+bool spaceChargeCheck = false;                    // --space-charge-check: tree vs direct sum after a headless run
+bool solvedField = false;                         // [L] or --solved-field: gun and plate fields from CRT_FieldSolver.h
+
+// Particles (structure of arrays). updateParticles() advances them in
+// parallel, drops those past the beam tip and packs the rest into the
+// snapshot; drawBeam() streams that array to pointSprites in one draw call.
+struct ParticleSystem {
+    std::vector<float> t;
+    std::vector<float> speed;
+    std::vector<float> offsetR;
+    std::vector<float> offsetA;
+};
+ParticleSystem particles;
+int numParticles = 150;           // --particles N
+
+// Static geometry, compiled into display lists: the tube once at startup,
+// the HUD frame (which depends on the window size) on every reshape
+GLUquadric* quadric = nullptr;
+GLuint crtList = 0;               // TubeList parts, then every cylinder at every LOD tier
+GLuint hudList = 0;
+PointSprites pointSprites;        // particles and electrons
+
+// The tube in drawing order: fixed parts in their own lists, the two
+// cylinders once per LOD tier
+enum TubeList { LIST_GUN, LIST_PLATES, LIST_SCREEN, LIST_LEADERS, TUBE_LIST_COUNT };
+struct TubeCylinder {
+    float z, baseR, topR, height;
+    float r, g, b, alpha;
+};
+static const TubeCylinder TUBE_CYLINDERS[] = {
+    { 2.5f, 0.5f, 0.5f, 2.0f, 0.7f, 0.7f, 0.7f, 0.9f },    // anodes, grey
+    { 8.5f, 0.6f, 2.5f, 4.0f, 0.8f, 0.9f, 1.0f, 0.15f },   // glass funnel, very transparent blue
+};
+static const int TUBE_CYLINDER_COUNT = 2;
+static const float TUBE_LENGTH = 13.0f;   // heater to screen
+
+// Level of detail, picked every frame from projected size by chooseLod():
+// the cylinder tier, a cap on the particles drawn, and whether the tube
+// labels have room. The update packs only the first particleLimit
+// particles; their order is random, so any prefix is an even sample.
+static const int LOD_TIERS = 3;
+static const int LOD_SLICES[LOD_TIERS] = { 32, 16, 8 };        // filled surface
+static const int LOD_WIRE_SLICES[LOD_TIERS] = { 16, 8, 8 };    // wireframe over it
+static const float LOD_EDGE_PIXELS = 1.0f;          // allowed silhouette error
+static const float LOD_PARTICLES_PER_PIXEL = 1.0f;  // over the tube's projected square
+static const float LOD_LABEL_PIXELS = 250.0f;       // labels need the tube this long
+struct LodChoice {
+    int cylinderTier[TUBE_CYLINDER_COUNT];
+    size_t particleLimit;
+    bool labels;
+};
+bool lodEnabled = true;                             // --no-lod
+std::atomic<size_t> particleLimit{SIZE_MAX};        // renderer -> update
+
+// Frame profiler: [F] shows the per-phase overlay, [E] writes it as CSV
+enum ProfilePhase { PROF_SIMULATE, PROF_CRT, PROF_BEAM, PROF_HUD, PROF_TEXT };
+static const char* PROFILE_PHASES[] = { "simulate", "crt", "beam", "hud", "text" };
+static const char* PROFILE_CSV = "CRT_3D_profile.csv";
+FrameProfiler profiler;
+bool showProfiler = false;
+
+// Headless mode (--headless N): N frames at a fixed timestep, drawn by the
+// CPU rasterizer in CRT_Headless.h instead of a GLUT window
+static const int HEADLESS_FPS = 60;
+int headlessFrames = 0;
+int headlessW = WIN_W, headlessH = WIN_H;  // --size WxH
+std::string dumpPath;                      // --dump FILE (.ppm, %d pattern or .y4m)
+
+// Particle benchmark (--bench-particles): doubles the particle count from
+// BENCH_MIN until a frame no longer fits in 1/60 s and reports the largest
+// count that did. Runs in the window, or on the CPU rasterizer with
+// --headless N (N frames per count).
+static const size_t BENCH_MIN = 1024, BENCH_MAX = 1 << 20;
+static const int BENCH_WARMUP = 10, BENCH_FRAMES = 60;
+static const double BENCH_BUDGET_MS = 1000.0 / 60.0;
+bool benchParticles = false;
+struct ParticleBench {
+    size_t count = 0;
+    int frame = 0;
+    FrameTimings sim, render;
+    size_t drawn = 0;              // particles drawn, summed over the measured frames
+    size_t reached = 0;
+};
+ParticleBench bench;
+
+// Simulation thread: simulateFrame() runs every TIMER_MS on simThread and
+// publishes a FrameSnapshot; display() draws only from the newest one. Keys
+// that change the simulation are queued and applied on that thread.
+struct FrameSnapshot {
+    bool intro = true;
+    bool physics = false;
+    bool showTrace = false;            // inset shows trace rather than phosphor
+    BeamStage stage = STAGE_FILAMENT;
+    float tipX = 0, tipY = 0, tipZ = 0;
+    std::vector<float> points;         // x,y,z of the particles behind the tip, or electrons
+    TraceSnapshot trace;               // copied only while showTrace
+    std::vector<uint8_t> phosphor;     // copied only while !showTrace
+    int phosphorRes = 0;
+    bool showHeatmap = false;          // inset shows the heatmap over either
+    std::vector<uint8_t> heatmap;      // RGB, colorized only while showHeatmap
+    int heatmapRes = 0;
+    bool showSpectrum = false;
+    std::vector<float> spectrum;       // levels, copied only while showSpectrum
+    uint64_t frame = 0;
+    float simMs = 0.0f;                // CPU time of the update
 };
-std::vector<Particle> particles;
-const int NUM_PARTICLES = 150;
+TripleBuffer<FrameSnapshot> snapshots;
+CommandQueue<unsigned char> commands;
+uint64_t snapshotCount = 0;
+PhosphorTexture phosphorTexture;
+PhosphorTexture heatmapTexture(3);
+
+// Recording (--record FILE) writes every published snapshot as one tick of
+// a CRT_Recorder.h file; replay (--replay FILE) publishes the recorded ticks
+// instead of simulating. The snapshot is split into fields that change at
+// different rates so the deltas stay small.
+enum RecordField { REC_STATE, REC_POINTS, REC_TRACE, REC_TRACE_BANDS, REC_PHOSPHOR, REC_HEATMAP, REC_SPECTRUM, REC_FIELD_COUNT };
+struct RecordedState {                     // no padding: stored as raw bytes
+    uint8_t intro, physics, showTrace, stage;
+    float tipX, tipY, tipZ, simMs;
+    int32_t phosphorRes, heatmapRes;
+    uint8_t showHeatmap, unused[3];
+};
+struct RecordInfo {                        // run settings the renderer needs
+    int32_t rasterLines, spectrumSize;
+    double spectrumRate;
+};
+static const int REPLAY_JUMP = 60;         // ticks skipped by [ and ]
+std::string recordPath, replayPath;
+StateRecorder recorder;
+StateReplay replay;
+size_t replayTick = 0;                     // --replay-from TICK
+bool replayPaused = false;
+bool replayDamaged = false;                // a tick failed to decode: hold the last good frame
+
+// --export FILE: every beam sample (the points fed to the trace) streamed to
+// a CSV or binary file by CRT_SampleExport.h's writer thread
+std::string exportPath;
+SampleExporter sampleExport;
+SimThread simThread;                       // last, so it is stopped first at exit
 
 // --------------------------- Project Info -------------------------------------
 const char* PROJECT_TITLE = "SIMULATION OF CATHODE RAY TUBE (3D)";
@@ -70,44 +323,59 @@ const int MEMBER_COUNT = 4;
 
 // --------------------------- Utilities ----------------------------------------
 
-static float frand(float a=0.0f, float b=1.0f) {
-    return a + (b-a) * (rand() / (float)RAND_MAX);
-}
+// Every label goes through the glyph atlas. Window-space strings are queued
+// with addWindow(); tube labels are anchored in 3D under the matrices taken
+// by textRenderer.setMatrices(). All of it is drawn by textRenderer.flush().
+static void* const TEXT_FONTS[] = {
+    GLUT_BITMAP_TIMES_ROMAN_24, GLUT_BITMAP_HELVETICA_18, GLUT_BITMAP_HELVETICA_12
+};
+TextRenderer textRenderer;
 
-static void drawStringCentered(float cx, float y, const std::string &s, void* font = GLUT_BITMAP_TIMES_ROMAN_24) {
+static void drawStringCentered(float cx, float y, const std::string &s, void* font,
+                               float r, float g, float b, float a = 1.0f) {
     if (s.empty()) return;
-    int lenPix = glutBitmapLength(font, (const unsigned char*)s.c_str());
-    glRasterPos2f(cx - lenPix/2.0f, y);
-    for (char c : s) glutBitmapCharacter(font, c);
+    textRenderer.addWindow(font, s, cx - textRenderer.width(font, s) / 2.0f, y, r, g, b, a);
 }
 
-static void drawString(float x, float y, const std::string &s) {
-    glRasterPos2f(x, y);
-    for (char c : s) glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, c);
+static void drawString(float x, float y, const std::string &s, float r, float g, float b) {
+    textRenderer.addWindow(GLUT_BITMAP_HELVETICA_12, s, x, y, r, g, b);
 }
 
-// Draw a Label with a "Leader Line" pointing to the object
-static void drawLabelWithLeader(float textX, float textY, float textZ,
-                                float targetX, float targetY, float targetZ,
-                                const std::string &text) {
+// A label with a "Leader Line" pointing to the object
+struct TubeLabel {
+    float textX, textY, textZ;
+    float targetX, targetY, targetZ;
+    const char* text;
+};
+
+static const TubeLabel TUBE_LABELS[] = {
+    {  0.0f, -2.0f,  -0.5f,  0.0f, -0.2f, -0.5f, "Heater / Filament" },
+    { -2.5f,  1.5f,   0.5f, -0.4f,  0.4f,  0.5f, "Cathode (Negative Potential)" },
+    {  2.0f,  2.0f,   3.5f,  0.5f,  0.5f,  3.5f, "Focusing & Accelerating Anodes" },
+    {  2.5f,  1.0f,   5.5f,  0.5f,  0.6f,  5.5f, "Vertical Deflection Plates (Y-Plates)" },
+    { -3.0f, -1.5f,   7.5f, -0.6f,  0.0f,  7.5f, "Horizontal Deflection Plates (X-Plates)" },
+    {  0.0f,  2.5f,  12.5f,  0.0f,  1.5f, 12.5f, "Phosphor Coated Screen" }
+};
 
-    // 1. Draw the Leader Line
+static void drawLeaderLine(const TubeLabel &l) {
     glColor4f(0.4f, 0.4f, 0.4f, 0.6f); // Grey
     glLineWidth(1.0f);
     glBegin(GL_LINES);
-        glVertex3f(textX, textY - 0.2f, textZ); // Start slightly below text
-        glVertex3f(targetX, targetY, targetZ);  // End at object
+        glVertex3f(l.textX, l.textY - 0.2f, l.textZ); // Start slightly below text
+        glVertex3f(l.targetX, l.targetY, l.targetZ);  // End at object
     glEnd();
+}
+
+static void queueLabel(const TubeLabel &l) {
+    textRenderer.add(GLUT_BITMAP_HELVETICA_12, l.text, l.textX, l.textY, l.textZ, 0.0f, 0.0f, 0.0f); // Black Text
+}
 
-    // 2. Draw the Text
-    glColor3f(0.0f, 0.0f, 0.0f); // Black Text
-    glRasterPos3f(textX, textY, textZ);
-    for (char c : text) glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, c);
+static void queueTubeLabels() {
+    for (const TubeLabel &l : TUBE_LABELS) queueLabel(l);
 }
 
 // --------------------------- Initialization -----------------------------------
 void init() {
-    srand(time(0));
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // White Background
 
     glEnable(GL_DEPTH_TEST);
@@ -116,14 +384,48 @@ void init() {
     glEnable(GL_LINE_SMOOTH);
     glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 
-    for(int i=0; i<NUM_PARTICLES; i++) {
-        Particle p;
-        p.t = frand(-0.5f, 1.0f);
-        p.speed = 0.005f + frand(0.0f, 0.01f);
-        p.offsetR = frand(0.0f, 0.05f);
-        p.offsetA = frand(0.0f, 6.28f);
-        particles.push_back(p);
+    textRenderer.build(TEXT_FONTS, sizeof(TEXT_FONTS) / sizeof(TEXT_FONTS[0]));
+
+    for(const char* name : PROFILE_PHASES) profiler.addPhase(name);
+    profiler.initGL();
+    pointSprites.initGL();
+}
+
+// Scatter numParticles particles along the tube
+void initParticles() {
+    particles.t.resize(numParticles);
+    particles.speed.resize(numParticles);
+    particles.offsetR.resize(numParticles);
+    particles.offsetA.resize(numParticles);
+    Random rng(randomSeed);
+    for(int i=0; i<numParticles; i++) {
+        particles.t[i] = rng.uniform(-0.5f, 1.0f);
+        particles.speed[i] = rng.uniform(0.005f, 0.015f);
+        particles.offsetR[i] = rng.uniform(0.0f, 0.05f);
+        particles.offsetA[i] = rng.uniform(0.0f, 6.28f);
+    }
+}
+
+// Simulation state only, no GL calls (shared with headless mode)
+void initSimulation() {
+    traceHistory.reset(traceDepth, HUD_INSET_SIZE, HUD_MAP_MIN, HUD_MAP_MIN, HUD_MAP_MAX, HUD_MAP_MAX);
+    spectrum.configure(spectrumSize, spectrumRate, HUD_INSET_SIZE);
+    spectrumSize = spectrum.size();   // rounded up to a power of two
+    phosphor.reset(rasterLines > 0 ? RASTER_PHOSPHOR_RES : HUD_INSET_SIZE, HUD_MAP_MIN, HUD_MAP_MIN, HUD_MAP_MAX, HUD_MAP_MAX);
+    phosphor.setPersistence(persistence);
+    heatmap.reset(HEATMAP_RES, HUD_MAP_MIN, HUD_MAP_MIN, HUD_MAP_MAX, HUD_MAP_MAX);
+    if(rasterLines > 0) {
+        raster.configure(rasterLines);
+        if(rasterInput.empty() || !raster.image.open(rasterInput.c_str())) {
+            if(!rasterInput.empty()) fprintf(stderr, "CRT_3D: cannot read %s, showing a test pattern\n", rasterInput.c_str());
+            raster.image.testPattern(640, raster.lines());
+        }
+        if(!beamSampler.enabled()) beamSampler.setRate(RASTER_SAMPLE_HZ);
+        rasterHitEnergy = raster.hitEnergy(phosphor.cellsCovered(2.0f * SCREEN_W/2.5f, 2.0f * SCREEN_H/2.5f),
+                                           beamSampler.rate(), phosphor.getPersistence());
     }
+
+    initParticles();
 }
 
 // --------------------------- Drawing Helpers ----------------------------------
@@ -139,20 +441,21 @@ void drawTechBox(float w, float h, float d, float r, float g, float b) {
     glPopMatrix();
 }
 
-void drawCylinderPart(float baseR, float topR, float height, float r, float g, float b, float alpha) {
-    GLUquadric* quad = gluNewQuadric();
-    glColor4f(r, g, b, alpha);
-    gluQuadricDrawStyle(quad, GLU_FILL);
-    gluCylinder(quad, baseR, topR, height, 32, 1);
+void drawCylinderPart(const TubeCylinder &c, int slices, int wireSlices) {
+    glPushMatrix();
+    glTranslatef(0, 0, c.z);
+    glColor4f(c.r, c.g, c.b, c.alpha);
+    gluQuadricDrawStyle(quadric, GLU_FILL);
+    gluCylinder(quadric, c.baseR, c.topR, c.height, slices, 1);
     glColor4f(0.2f, 0.2f, 0.2f, 0.5f);
-    gluQuadricDrawStyle(quad, GLU_LINE);
-    gluCylinder(quad, baseR*1.001, topR*1.001, height, 16, 1);
-    gluDeleteQuadric(quad);
+    gluQuadricDrawStyle(quadric, GLU_LINE);
+    gluCylinder(quadric, c.baseR*1.001, c.topR*1.001, c.height, wireSlices, 1);
+    glPopMatrix();
 }
 
 // --------------------------- 3D Scene -----------------------------------------
 
-void drawCRT() {
+void drawGun() {
     // --- 1. ELECTRON GUN SECTION ---
 
     // Heater / Filament (Base)
@@ -160,24 +463,17 @@ void drawCRT() {
     glTranslatef(0, 0, -0.5f);
     drawTechBox(0.4f, 0.4f, 0.5f, 0.8f, 0.4f, 0.1f); // Orange
     glPopMatrix();
-    drawLabelWithLeader(0.0f, -2.0f, -0.5f, 0.0f, -0.2f, -0.5f, "Heater / Filament");
 
     // Cathode (Source of electrons)
     glPushMatrix();
     glTranslatef(0, 0, 0.5f);
     drawTechBox(0.8f, 0.8f, 1.0f, 0.8f, 0.3f, 0.3f); // Reddish
     glPopMatrix();
-    drawLabelWithLeader(-2.5f, 1.5f, 0.5f, -0.4f, 0.4f, 0.5f, "Cathode (Negative Potential)");
 
-    // --- 2. FOCUSING SECTION ---
-
-    // Anodes (Focusing & Accelerating)
-    glPushMatrix();
-    glTranslatef(0, 0, 2.5f);
-    drawCylinderPart(0.5f, 0.5f, 2.0f, 0.7f, 0.7f, 0.7f, 0.9f); // Grey Cylinder
-    glPopMatrix();
-    drawLabelWithLeader(2.0f, 2.0f, 3.5f, 0.5f, 0.5f, 3.5f, "Focusing & Accelerating Anodes");
+    // --- 2. FOCUSING SECTION: the anodes, TUBE_CYLINDERS[0] ---
+}
 
+void drawPlates() {
     // --- 3. DEFLECTION SYSTEM ---
 
     // Y-Deflection Plates (Horizontal plates moving beam vertically)
@@ -189,7 +485,6 @@ void drawCRT() {
     glPushMatrix(); glTranslatef(0, -0.6f, 0); drawTechBox(1.0f, 0.1f, 1.5f, 0.4f, 0.4f, 0.4f); glPopMatrix();
     glPopMatrix();
 
-    drawLabelWithLeader(2.5f, 1.0f, 5.5f, 0.5f, 0.6f, 5.5f, "Vertical Deflection Plates (Y-Plates)");
 
     // X-Deflection Plates (Vertical plates moving beam horizontally)
     glPushMatrix();
@@ -200,16 +495,10 @@ void drawCRT() {
     glPushMatrix(); glTranslatef(0.6f, 0, 0); drawTechBox(0.1f, 1.0f, 1.5f, 0.3f, 0.3f, 0.3f); glPopMatrix();
     glPopMatrix();
 
-    drawLabelWithLeader(-3.0f, -1.5f, 7.5f, -0.6f, 0.0f, 7.5f, "Horizontal Deflection Plates (X-Plates)");
-
-    // --- 4. GLASS ENVELOPE ---
-
-    glPushMatrix();
-    glTranslatef(0, 0, 8.5f);
-    // Glass funnel
-    drawCylinderPart(0.6f, 2.5f, 4.0f, 0.8f, 0.9f, 1.0f, 0.15f); // Very transparent blue
-    glPopMatrix();
+    // --- 4. GLASS ENVELOPE: the funnel, TUBE_CYLINDERS[1] ---
+}
 
+void drawScreen() {
     // --- 5. SCREEN ---
 
     glPushMatrix();
@@ -233,7 +522,42 @@ void drawCRT() {
     glEnd();
     glPopMatrix();
 
-    drawLabelWithLeader(0.0f, 2.5f, 12.5f, 0.0f, 1.5f, 12.5f, "Phosphor Coated Screen");
+}
+
+GLuint cylinderList(int cylinder, int tier) {
+    return crtList + TUBE_LIST_COUNT + cylinder * LOD_TIERS + tier;
+}
+
+// The tube and its leader lines never change; compile them once, with every
+// LOD tier of the cylinders. The label text is queued every frame by
+// queueTubeLabels().
+void buildStaticLists() {
+    quadric = gluNewQuadric();
+    crtList = glGenLists(TUBE_LIST_COUNT + TUBE_CYLINDER_COUNT * LOD_TIERS);
+    glNewList(crtList + LIST_GUN, GL_COMPILE); drawGun(); glEndList();
+    glNewList(crtList + LIST_PLATES, GL_COMPILE); drawPlates(); glEndList();
+    glNewList(crtList + LIST_SCREEN, GL_COMPILE); drawScreen(); glEndList();
+    glNewList(crtList + LIST_LEADERS, GL_COMPILE);
+    for (const TubeLabel &l : TUBE_LABELS) drawLeaderLine(l);
+    glEndList();
+    for(int c=0; c<TUBE_CYLINDER_COUNT; c++) {
+        for(int t=0; t<LOD_TIERS; t++) {
+            glNewList(cylinderList(c, t), GL_COMPILE);
+            drawCylinderPart(TUBE_CYLINDERS[c], LOD_SLICES[t], LOD_WIRE_SLICES[t]);
+            glEndList();
+        }
+    }
+}
+
+// Same order as the tube was always drawn in: gun, anodes, plates, funnel,
+// screen, leader lines
+void drawTube(const LodChoice &lod) {
+    glCallList(crtList + LIST_GUN);
+    glCallList(cylinderList(0, lod.cylinderTier[0]));
+    glCallList(crtList + LIST_PLATES);
+    glCallList(cylinderList(1, lod.cylinderTier[1]));
+    glCallList(crtList + LIST_SCREEN);
+    if(lod.labels) glCallList(crtList + LIST_LEADERS);
 }
 
 // --------------------------- Beam Logic ---------------------------------------
@@ -243,8 +567,8 @@ void calculateBeam() {
     float finalX = 0, finalY = 0;
 
     if (beamStage == STAGE_SCREEN || beamStage == STAGE_DEFLECTION) {
-        finalX = (SCREEN_W/2.5f) * std::cos(screenTheta);
-        finalY = (SCREEN_H/2.5f) * std::sin(screenTheta * 2.0f);
+        finalX = (SCREEN_W/2.5f) * deflX;
+        finalY = (SCREEN_H/2.5f) * deflY;
     }
 
     if (beamStage == STAGE_FILAMENT) {
@@ -269,9 +593,9 @@ void calculateBeam() {
     }
 }
 
-void drawBeam() {
+void drawBeam(const FrameSnapshot &snap, const LodChoice &lod) {
     // 1. Deflection Region (Envelope)
-    if (beamStage == STAGE_SCREEN || beamStage == STAGE_DEFLECTION) {
+    if (snap.stage == STAGE_SCREEN || snap.stage == STAGE_DEFLECTION) {
         glPushMatrix();
         glEnable(GL_BLEND);
         glDepthMask(GL_FALSE);
@@ -288,35 +612,11 @@ void drawBeam() {
         glPopMatrix();
     }
 
-    // 2. Particles
-    glPointSize(4.0f);
-    glBegin(GL_POINTS);
-    for(auto &p : particles) {
-        p.t += p.speed;
-        if(p.t > 1.0f) p.t = -0.2f;
-
-        float tGlobal = p.t;
-        float curZ = tGlobal * 12.5f;
-        if (curZ > beamTipZ) continue;
-
-        float curX = 0, curY = 0;
-        float tx = (SCREEN_W/2.5f) * std::cos(screenTheta);
-        float ty = (SCREEN_H/2.5f) * std::sin(screenTheta * 2.0f);
-
-        if (curZ > 5.5f) {
-             float factor = (curZ - 5.5f) / (12.5f - 5.5f);
-             curX = tx * factor;
-             curY = ty * factor;
-        }
-
-        float jitter = 0.05f;
-        curX += cos(p.offsetA + curZ) * p.offsetR;
-        curY += sin(p.offsetA + curZ) * p.offsetR;
-
-        glColor4f(0.1f, 0.2f, 1.0f, 0.8f);
-        glVertex3f(curX, curY, curZ);
-    }
-    glEnd();
+    // 2. Particles, culled and packed by the update step and capped by the
+    // LOD; sized for the orbit distance and smaller further away
+    const size_t n = std::min(snap.points.size() / 3, lod.particleLimit);
+    if(snap.physics) pointSprites.draw(snap.points.data(), n, snap.frame, 2.0f, camDist, 0.1f, 0.2f, 1.0f, 0.5f);
+    else pointSprites.draw(snap.points.data(), n, snap.frame, 4.0f, camDist, 0.1f, 0.2f, 1.0f, 0.8f);
 
     // 3. Beam Line
     glLineWidth(2.0f);
@@ -324,48 +624,57 @@ void drawBeam() {
     glBegin(GL_LINE_STRIP);
         glVertex3f(0,0,0);
         glVertex3f(0,0,5.5f);
-        glVertex3f(beamTipX, beamTipY, beamTipZ);
+        glVertex3f(snap.tipX, snap.tipY, snap.tipZ);
     glEnd();
 
     // 4. Glow Spot
     glPointSize(8.0f);
     glColor3f(0.0f, 1.0f, 1.0f);
     glBegin(GL_POINTS);
-        glVertex3f(beamTipX, beamTipY, beamTipZ);
+        glVertex3f(snap.tipX, snap.tipY, snap.tipZ);
     glEnd();
 
     // Beam Label
-    if(beamTipZ > 2.0f) {
-        drawLabelWithLeader(2.0f, -2.0f, 4.0f, 0.0f, 0.0f, 4.0f, "Electron Beam");
+    if(lod.labels && snap.tipZ > 2.0f) {
+        static const TubeLabel beamLabel = { 2.0f, -2.0f, 4.0f, 0.0f, 0.0f, 4.0f, "Electron Beam" };
+        drawLeaderLine(beamLabel);
+        queueLabel(beamLabel);
     }
 }
 
-// --------------------------- 2D Overlay (HUD) ---------------------------------
-
-void drawHUD() {
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix(); glLoadIdentity();
-    gluOrtho2D(0, glutGet(GLUT_WINDOW_WIDTH), 0, glutGet(GLUT_WINDOW_HEIGHT));
-
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix(); glLoadIdentity();
-    glDisable(GL_DEPTH_TEST);
-
-    int w = glutGet(GLUT_WINDOW_WIDTH);
-    int h = glutGet(GLUT_WINDOW_HEIGHT);
+// The raster picture on the screen face: a dark tube face with the part of
+// the phosphor grid the beam can reach stretched over where it lands
+void drawRasterScreen(const FrameSnapshot &snap) {
+    const float xMax = SCREEN_W/2.5f, yMax = SCREEN_H/2.5f;
+    const float span = HUD_MAP_MAX - HUD_MAP_MIN;
+    glPushMatrix();
+    glTranslatef(0, 0, 12.51f);
+    glDepthMask(GL_FALSE);
+    glColor3f(0.02f, 0.04f, 0.02f);
+    glBegin(GL_QUADS);
+        glVertex2f(-SCREEN_W/2, -SCREEN_H/2);
+        glVertex2f( SCREEN_W/2, -SCREEN_H/2);
+        glVertex2f( SCREEN_W/2,  SCREEN_H/2);
+        glVertex2f(-SCREEN_W/2,  SCREEN_H/2);
+    glEnd();
+    phosphorTexture.draw(snap.phosphor.data(), snap.phosphorRes, snap.frame,
+                  -xMax, -yMax, xMax, yMax, 0.75f, 1.0f, 0.8f,
+                  (-xMax - HUD_MAP_MIN) / span, (-yMax - HUD_MAP_MIN) / span,
+                  ( xMax - HUD_MAP_MIN) / span, ( yMax - HUD_MAP_MIN) / span);
+    glDepthMask(GL_TRUE);
+    glPopMatrix();
+}
 
-    // Controls
-    glColor3f(0.3f, 0.3f, 0.3f);
-    drawString(20, 40, "Orbit: Left Mouse Drag  |  Zoom: Scroll");
-    drawString(20, 20, "Controls: [S] Start/Skip  [P] Pause  [R] Reset");
+// --------------------------- 2D Overlay (HUD) ---------------------------------
 
-    // Inset Trace
-    int insetSize = 150;
-    int margin = 20;
-    int px = w - insetSize - margin;
-    int py = margin;
+// The inset box; everything in the HUD except the trace and the text
+void drawHUDFrame(int w) {
+    int insetSize = HUD_INSET_SIZE;
+    int px = w - insetSize - HUD_MARGIN;
+    int py = HUD_MARGIN;
 
-    glColor3f(1.0f, 1.0f, 1.0f);
+    if(raster.enabled()) glColor3f(0.02f, 0.04f, 0.02f);
+    else glColor3f(1.0f, 1.0f, 1.0f);
     glBegin(GL_QUADS);
         glVertex2f(px, py);
         glVertex2f(px + insetSize, py);
@@ -381,25 +690,77 @@ void drawHUD() {
         glVertex2f(px + insetSize, py + insetSize);
         glVertex2f(px, py + insetSize);
     glEnd();
+}
 
-    glColor3f(0.0f, 0.0f, 0.0f);
-    drawString(px + 5, py + insetSize - 15, "Screen Trace");
+// Spectrum panel at (px, py) in HUD pixels: log frequency from
+// spectrumRate / spectrumSize to spectrumRate / 2 across, DB_FLOOR..0 dB up
+void drawSpectrumPanel(const FrameSnapshot &snap, int px, int py) {
+    const int size = HUD_INSET_SIZE;
+    glColor3f(0.05f, 0.06f, 0.1f);
+    glBegin(GL_QUADS);
+        glVertex2f(px, py);
+        glVertex2f(px + size, py);
+        glVertex2f(px + size, py + size);
+        glVertex2f(px, py + size);
+    glEnd();
+    drawSpectrum(snap.spectrum, (float)px, (float)py, (float)size, (float)size);
+    glLineWidth(2.0f);
+    glColor3f(0.1f, 0.2f, 0.5f);
+    glBegin(GL_LINE_LOOP);
+        glVertex2f(px, py);
+        glVertex2f(px + size, py);
+        glVertex2f(px + size, py + size);
+        glVertex2f(px, py + size);
+    glEnd();
 
-    float mapMin = -2.5f;
-    float mapMax = 2.5f;
+    char range[64];
+    const double f0 = spectrumRate / spectrumSize, f1 = 0.5 * spectrumRate;
+    if(f1 >= 1000.0) snprintf(range, sizeof(range), "%.3g Hz - %.3g kHz", f0, 0.001 * f1);
+    else snprintf(range, sizeof(range), "%.3g - %.3g Hz", f0, f1);
+    drawString(px + 5, py + size - 15, "Spectrum X / Y", 0.9f, 0.9f, 0.9f);
+    drawString(px + 5, py + 5, range, 0.7f, 0.7f, 0.7f);
+}
 
-    glLineWidth(1.5f);
-    glBegin(GL_LINE_STRIP);
-    for(size_t i=0; i<traceHistory.size(); i++) {
-        float alpha = (float)i / traceHistory.size();
-        glColor4f(0.0f, 0.4f, 1.0f, alpha);
+void drawHUD(const FrameSnapshot &snap) {
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix(); glLoadIdentity();
+    gluOrtho2D(0, glutGet(GLUT_WINDOW_WIDTH), 0, glutGet(GLUT_WINDOW_HEIGHT));
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix(); glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
 
-        float nx = (traceHistory[i].first - mapMin) / (mapMax - mapMin);
-        float ny = (traceHistory[i].second - mapMin) / (mapMax - mapMin);
+    glCallList(hudList);
 
-        glVertex2f(px + nx * insetSize, py + ny * insetSize);
+    // Inset Trace
+    int insetSize = HUD_INSET_SIZE;
+    int px = glutGet(GLUT_WINDOW_WIDTH) - insetSize - HUD_MARGIN;
+    int py = HUD_MARGIN;
+
+    drawString(20, 40, "Orbit: Left Mouse Drag  |  Zoom: Scroll", 0.3f, 0.3f, 0.3f);
+    drawString(20, 20, "Controls: [S] Start/Skip  [P] Pause  [R] Reset  [M] Physics  [C] Charge  [L] Field  [T] Trace  [A] Spectrum  [H] Heatmap  [X] Save Map  [F] Stats  [E] Export", 0.3f, 0.3f, 0.3f);
+    if(snap.showHeatmap) drawString(px + 5, py + insetSize - 15, "Impact Density", 0.9f, 0.9f, 0.9f);
+    else drawString(px + 5, py + insetSize - 15, "Screen Trace", 0.0f, 0.0f, 0.0f);
+
+    if(snap.showHeatmap) {
+        heatmapTexture.draw(snap.heatmap.data(), snap.heatmapRes, snap.frame, px, py, px + insetSize, py + insetSize, 1.0f, 1.0f, 1.0f);
+    } else if(snap.showTrace) {
+        // Map trace coordinates into the inset with the modelview matrix so
+        // the decimated vertices are drawn as they are
+        float k = insetSize / (HUD_MAP_MAX - HUD_MAP_MIN);
+        glPushMatrix();
+        glTranslatef((float)px, (float)py, 0.0f);
+        glScalef(k, k, 1.0f);
+        glTranslatef(-HUD_MAP_MIN, -HUD_MAP_MIN, 0.0f);
+        glLineWidth(1.5f);
+        drawTraceHistory(snap.trace, 0.0f, 0.4f, 1.0f);
+        glPopMatrix();
+    } else {
+        if(raster.enabled()) phosphorTexture.draw(snap.phosphor.data(), snap.phosphorRes, snap.frame, px, py, px + insetSize, py + insetSize, 0.75f, 1.0f, 0.8f);
+        else phosphorTexture.draw(snap.phosphor.data(), snap.phosphorRes, snap.frame, px, py, px + insetSize, py + insetSize, 0.0f, 0.4f, 1.0f);
     }
-    glEnd();
+
+    if(snap.showSpectrum) drawSpectrumPanel(snap, px, py + insetSize + HUD_MARGIN);
 
     glEnable(GL_DEPTH_TEST);
     glPopMatrix();
@@ -426,20 +787,18 @@ void drawIntro() {
     glEnd();
 
     float a = introAlpha;
-    glColor4f(0.0f, 0.1f, 0.5f, a);
-    drawStringCentered(cx, cy + 100, PROJECT_TITLE);
+    drawStringCentered(cx, cy + 100, PROJECT_TITLE, GLUT_BITMAP_TIMES_ROMAN_24, 0.0f, 0.1f, 0.5f, a);
 
-    glColor4f(0.2f, 0.2f, 0.2f, a);
-    drawStringCentered(cx, cy + 60, COURSE_NAME, GLUT_BITMAP_HELVETICA_18);
-    drawStringCentered(cx, cy + 35, std::string("Code: ") + COURSE_CODE, GLUT_BITMAP_HELVETICA_18);
+    drawStringCentered(cx, cy + 60, COURSE_NAME, GLUT_BITMAP_HELVETICA_18, 0.2f, 0.2f, 0.2f, a);
+    drawStringCentered(cx, cy + 35, std::string("Code: ") + COURSE_CODE, GLUT_BITMAP_HELVETICA_18, 0.2f, 0.2f, 0.2f, a);
 
-    drawStringCentered(cx, cy - 20, "Group Members:", GLUT_BITMAP_HELVETICA_18);
+    drawStringCentered(cx, cy - 20, "Group Members:", GLUT_BITMAP_HELVETICA_18, 0.2f, 0.2f, 0.2f, a);
     for(int i=0; i<MEMBER_COUNT; i++) {
-        drawStringCentered(cx, cy - 50 - (i*25), MEMBERS[i], GLUT_BITMAP_HELVETICA_18);
+        drawStringCentered(cx, cy - 50 - (i*25), MEMBERS[i], GLUT_BITMAP_HELVETICA_18, 0.2f, 0.2f, 0.2f, a);
     }
 
-    glColor4f(0.6f, 0.0f, 0.0f, a);
-    drawStringCentered(cx, 50, "Press [S] to Start Simulation", GLUT_BITMAP_HELVETICA_18);
+    drawStringCentered(cx, 50, "Press [S] to Start Simulation", GLUT_BITMAP_HELVETICA_18, 0.6f, 0.0f, 0.0f, a);
+    textRenderer.flush(w, h);
 
     glEnable(GL_DEPTH_TEST);
     glPopMatrix();
@@ -450,26 +809,571 @@ void drawIntro() {
 
 // --------------------------- Rendering ----------------------------------------
 
-void display() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// --------------------------- Physical Beam ------------------------------------
+
+void setPhysicsMode(bool on) {
+    physicsMode = on;
+    phosphor.lift();
+    if(on) {
+        electrons.reset(electronCount, randomSeed);
+        electrons.setSpaceCharge(spaceChargeOn ? spaceCharge : 0.0f);
+        electrons.setSolvedField(solvedField, jobs);
+        electronAcc = 0.0f;
+        // the electrons replace the staged animation: go straight to the screen stage
+        simCurr.stage = STAGE_SCREEN;
+        simCurr.progress = 0.0f;
+        simPrev = simCurr;
+    }
+}
 
-    if(showIntro) {
-        drawIntro();
+// Integrate the electrons over the frame. Plate voltages follow the same
+// signals the scripted beam uses, so the deflection comes from the fields.
+void advanceElectrons(double tEnd) {
+    electronAcc += frameDt;
+    int steps = (int)(electronAcc / ELECTRON_DT);
+    electronAcc -= steps * ELECTRON_DT;
+    if(steps > ELECTRON_MAX_STEPS) steps = ELECTRON_MAX_STEPS;
+
+    electronDrive.resize(steps);
+    signals.evaluate(tEnd - (steps - 1) * (double)ELECTRON_DT, ELECTRON_DT, steps);
+    for(int s=0; s<steps; s++) {
+        electronDrive[s].plateX = PLATE_X_MAX * signals.xs[s];
+        electronDrive[s].plateY = PLATE_Y_MAX * signals.ys[s];
+    }
+    electrons.advance(electronDrive.data(), steps, ELECTRON_DT, electronHits, jobs);
+    if(electronHits.empty()) return;
+
+    // hits arrive grouped by electron block; put them back in time order
+    std::stable_sort(electronHits.begin(), electronHits.end(),
+                     [](const ScreenHit &a, const ScreenHit &b) { return a.t < b.t; });
+    // the frame's beam energy is shared between the electrons that landed
+    const float energy = PhosphorScreen::BEAM_CURRENT * frameDt / electronHits.size();
+    const double t0 = tEnd - steps * (double)ELECTRON_DT;
+    float sx = 0, sy = 0;
+    for(const ScreenHit &h : electronHits) {
+        traceHistory.push({h.x, h.y});
+        if(sampleExport.isOpen()) sampleExport.add(t0 + h.t, h.x, h.y, tube::SCREEN_Z, STAGE_SCREEN);
+        phosphor.hit(h.x, h.y, energy);
+        heatmap.add(h.x, h.y);
+        sx += h.x; sy += h.y;
+    }
+    beamTipX = sx / electronHits.size();
+    beamTipY = sy / electronHits.size();
+    beamTipZ = tube::SCREEN_Z;
+}
+
+// Electrons already emitted, packed for one draw call. Above the LOD cap
+// only every stride-th one is kept, since slots are reused in emission order.
+void updateElectronVerts(std::vector<float> &points) {
+    const size_t limit = std::max<size_t>(1, particleLimit.load(std::memory_order_relaxed));
+    const size_t stride = electrons.size() <= limit ? 1 : (electrons.size() + limit - 1) / limit;
+    points.resize(3 * electrons.size());
+    size_t n = jobs.parallelPack(electrons.size(), PARTICLE_GRAIN, points.data(), 3,
+                                 [stride](size_t i0, size_t i1, float* out) {
+        size_t k = 0;
+        for(size_t i=i0; i<i1; i++) {
+            if(electrons.age[i] < 0.0f || i % stride) continue;
+            out[k++] = electrons.x[i];
+            out[k++] = electrons.y[i];
+            out[k++] = electrons.z[i];
+        }
+        return k;
+    });
+    points.resize(n);
+}
+
+// --------------------------- Simulation ---------------------------------------
+
+// Scripted particles (speeds are per TIMER_MS tick); only those behind the
+// beam tip are kept, and they are culled before any trig is done
+void updateParticles(std::vector<float> &points) {
+    const float ticks = frameDt / (TIMER_MS * 0.001f);
+    const float tx = (SCREEN_W/2.5f) * deflX;
+    const float ty = (SCREEN_H/2.5f) * deflY;
+    const float tipZ = beamTipZ;
+    const size_t limit = std::min((size_t)numParticles, particleLimit.load(std::memory_order_relaxed));
+
+    float* t = particles.t.data();
+    const float* speed = particles.speed.data();
+    const float* offR = particles.offsetR.data();
+    const float* offA = particles.offsetA.data();
+    points.resize(3 * (size_t)numParticles);
+    size_t n = jobs.parallelPack((size_t)numParticles, PARTICLE_GRAIN, points.data(), 3,
+                                 [&](size_t i0, size_t i1, float* out) {
+        for(size_t i=i0; i<i1; i++) {
+            float nt = t[i] + speed[i] * ticks;
+            t[i] = nt > 1.0f ? -0.2f : nt;
+        }
+
+        // only the first `limit` are drawn at this LOD
+        size_t k = 0;
+        for(size_t i=i0; i<std::min(i1, limit); i++) {
+            float curZ = t[i] * 12.5f;
+            if(curZ > tipZ) continue;
+
+            float curX = 0, curY = 0;
+            if(curZ > 5.5f) {
+                float factor = (curZ - 5.5f) / (12.5f - 5.5f);
+                curX = tx * factor;
+                curY = ty * factor;
+            }
+            float a = offA[i] + curZ;
+            out[k++] = curX + std::cos(a) * offR[i];
+            out[k++] = curY + std::sin(a) * offR[i];
+            out[k++] = curZ;
+        }
+        return k;
+    });
+    points.resize(n);
+}
+
+void stepBeam(BeamState &s, float dt) {
+    s.progress += beamSpeed * dt;
+    if(s.progress > 1.0f) s.progress = 1.0f;
+
+    if(s.stage == STAGE_SCREEN) {
+        s.sweep += dt;
+        if(s.progress >= 1.0f) s.progress = 0.0f;
+    } else {
+        if(s.progress >= 1.0f) {
+            s.progress = 0.0f;
+            s.stage = (BeamStage)(s.stage + 1);
+        }
+    }
+}
+
+// Blend the last two simulation states into the render state. Progress
+// resets and stage changes are not blended across.
+void interpolateBeam(float alpha) {
+    beamStage = simCurr.stage;
+    if(simPrev.stage == simCurr.stage && simCurr.progress >= simPrev.progress)
+        beamProgress = simPrev.progress + (simCurr.progress - simPrev.progress) * alpha;
+    else
+        beamProgress = simCurr.progress;
+
+    sweepTime = simPrev.sweep + (simCurr.sweep - simPrev.sweep) * alpha;
+    if(raster.enabled()) raster.valueAt(sweepTime, deflX, deflY);
+    else signals.valueAt(sweepTime, deflX, deflY);
+}
+
+// Evaluate the beam tip at the sampler's rate over the frame that just ended,
+// with the same closed form as calculateBeam(), and feed every sample to the
+// trace history and the phosphor. Only valid while the whole frame was spent
+// on the screen stage.
+void sampleBeam() {
+    double t0 = 0.0;
+    const size_t n = beamSampler.window(sweepTime, frameDt, t0);
+    if(n == 0) return;
+    const float h = (float)(1.0 / beamSampler.rate());
+
+    // samples from where the last frame stopped up to now
+    const float back = (float)(sweepTime - t0);
+    std::vector<float> &xs = beamSampler.x;
+    std::vector<float> &ys = beamSampler.y;
+    xs.resize(n);
+    ys.resize(n);
+
+    if(raster.enabled()) {
+        // the picture is painted where the beam lands, not at the flying tip,
+        // and goes to the phosphor only
+        std::vector<float> &zs = beamSampler.z;
+        zs.resize(n);
+        jobs.parallelFor(n, SAMPLE_GRAIN, [&](size_t k0, size_t k1) {
+            raster.evaluate(t0 + k0 * (double)h, h, k1 - k0, &xs[k0], &ys[k0], &zs[k0]);
+            for(size_t k=k0; k<k1; k++) {
+                if(zs[k] > 0.0f) heatmap.add((SCREEN_W/2.5f) * xs[k], (SCREEN_H/2.5f) * ys[k]);
+            }
+        });
+        for(size_t k=0; k<n; k++) {
+            if(zs[k] > 0.0f) phosphor.hit((SCREEN_W/2.5f) * xs[k], (SCREEN_H/2.5f) * ys[k], rasterHitEnergy * zs[k]);
+        }
+        if(sampleExport.isOpen()) {
+            // where the beam lands, blanked or not
+            for(size_t k=0; k<n; k++)
+                sampleExport.add(t0 + k * (double)h, (SCREEN_W/2.5f) * xs[k], (SCREEN_H/2.5f) * ys[k], tube::SCREEN_Z, STAGE_SCREEN);
+        }
+        return;
+    }
+
+    float p0 = beamProgress - beamSpeed * back;
+    p0 -= std::floor(p0);
+    const float dp = beamSpeed * h;
+    // deflection first, then scaled to the beam tip in place
+    jobs.parallelFor(n, SAMPLE_GRAIN, [&](size_t k0, size_t k1) {
+        const double t0 = t0 + k0 * (double)h;
+        signals.x.evaluate(t0, h, k1 - k0, &xs[k0]);
+        signals.y.evaluate(t0, h, k1 - k0, &ys[k0]);
+        for(size_t k=k0; k<k1; k++) {
+            heatmap.add((SCREEN_W/2.5f) * xs[k], (SCREEN_H/2.5f) * ys[k]);   // where this flight lands
+            float p = p0 + dp * k;
+            p -= (float)(int)p;   // progress restarts at each flight
+            float scale = 0.1f + 0.9f * p;   // tip runs from 10% of the target out to it
+            xs[k] = (SCREEN_W/2.5f) * xs[k] * scale;
+            ys[k] = (SCREEN_H/2.5f) * ys[k] * scale;
+        }
+    });
+    for(size_t k=0; k<n; k++) {
+        traceHistory.push({xs[k], ys[k]});
+        phosphor.sweep(xs[k], ys[k], h);
+    }
+    if(sampleExport.isOpen()) {
+        for(size_t k=0; k<n; k++) {
+            float p = p0 + dp * k;
+            p -= (float)(int)p;
+            sampleExport.add(t0 + k * (double)h, xs[k], ys[k], 8.5f + (12.5f - 8.5f) * p, STAGE_SCREEN);
+        }
+    }
+}
+
+// Feed the plate deflection since the last frame to the spectrum analyser
+// at its own rate, evaluated directly so the panel does not depend on
+// --sample-rate. A jump in the signal time, or the panel having been off,
+// starts the history over.
+void updateSpectrum() {
+    const double h = 1.0 / spectrumRate;
+    if(spectrumNextT > sweepTime + h || sweepTime - spectrumNextT > spectrum.size() * h) {
+        spectrum.clear();
+        spectrumNextT = sweepTime;
+    }
+    if(sweepTime < spectrumNextT) return;
+    const size_t n = (size_t)((sweepTime - spectrumNextT) * spectrumRate) + 1;
+    spectrumX.resize(n);
+    spectrumY.resize(n);
+    if(raster.enabled()) {
+        spectrumZ.resize(n);
+        raster.evaluate(spectrumNextT, h, n, spectrumX.data(), spectrumY.data(), spectrumZ.data());
+    } else {
+        signals.x.evaluate(spectrumNextT, h, n, spectrumX.data());
+        signals.y.evaluate(spectrumNextT, h, n, spectrumY.data());
+    }
+    spectrum.push(spectrumX.data(), spectrumY.data(), n);
+    spectrumNextT += n * h;
+}
+
+// Run `steps` fixed steps, interpolate, then update the particles (or
+// electrons, packed into `points`) and the trace for this frame.
+void advanceSimulation(int steps, std::vector<float> &points) {
+    float dt = (float)simClock.dt();
+    frameDt = steps * dt;
+    const BeamStage startStage = simCurr.stage;
+
+    if(!showIntro && !paused) {
+        for(int i=0; i<steps; i++) {
+            simPrev = simCurr;
+            stepBeam(simCurr, dt);
+        }
+        interpolateBeam((float)simClock.alpha());
+    } else {
+        simPrev = simCurr;
+        interpolateBeam(0.0f);
+    }
+
+    if(physicsMode) {
+        if(!showIntro && !paused) advanceElectrons(sweepTime);
+        if(!showIntro) updateElectronVerts(points);
+    } else {
+        calculateBeam();
+        if(!showIntro) updateParticles(points);
+
+        // only a beam that has reached the screen excites the phosphor
+        if(beamStage != STAGE_SCREEN) phosphor.lift();
+        if(steps > 0 && !showIntro && !paused && beamStage == STAGE_SCREEN) {
+            if(beamSampler.enabled() && startStage == STAGE_SCREEN) {
+                sampleBeam();
+            } else {
+                traceHistory.push({beamTipX, beamTipY});
+                if(sampleExport.isOpen()) sampleExport.add(sweepTime, beamTipX, beamTipY, beamTipZ, beamStage);
+                beamSampler.coveredTo(sweepTime);
+                if(!raster.enabled()) {
+                    phosphor.sweep(beamTipX, beamTipY, frameDt);
+                    heatmap.add((SCREEN_W/2.5f) * deflX, (SCREEN_H/2.5f) * deflY);
+                }
+            }
+        }
+    }
+    if(!showIntro && !paused) phosphor.decay(frameDt);
+    if(!showIntro && showSpectrum.load(std::memory_order_relaxed)) updateSpectrum();
+}
+
+// Orbit camera around the middle of the tube
+void cameraEye(float &eyeX, float &eyeY, float &eyeZ) {
+    float radPhi = camPhi * 3.14159f / 180.0f;
+    float radTheta = camTheta * 3.14159f / 180.0f;
+
+    eyeX = camDist * cos(radPhi) * sin(radTheta);
+    eyeY = camDist * sin(radPhi);
+    eyeZ = camDist * cos(radPhi) * cos(radTheta) + 6.0f;
+}
+
+// Pixels per world unit at distance d, for the 45 degree field of view
+float pixelsPerUnit(float d, int viewportH) {
+    return viewportH / (2.0f * 0.41421356f * std::max(d, 1.0f));
+}
+
+// LOD for this view: each cylinder gets the coarsest tier whose polygon
+// stays within LOD_EDGE_PIXELS of the true circle at its projected radius
+LodChoice chooseLod(float eyeX, float eyeY, float eyeZ, int viewportH) {
+    LodChoice lod = { {0, 0}, SIZE_MAX, true };
+    if(!lodEnabled) return lod;
+
+    for(int c=0; c<TUBE_CYLINDER_COUNT; c++) {
+        const TubeCylinder &cy = TUBE_CYLINDERS[c];
+        float dz = eyeZ - (cy.z + 0.5f * cy.height);
+        float d = sqrtf(eyeX*eyeX + eyeY*eyeY + dz*dz);
+        float radius = std::max(cy.baseR, cy.topR) * pixelsPerUnit(d, viewportH);
+        // a chord of n slices strays radius * (1 - cos(pi / n)) from the circle
+        float slices = radius > LOD_EDGE_PIXELS ? 3.14159265f / acosf(1.0f - LOD_EDGE_PIXELS / radius) : 3.0f;
+        int tier = LOD_TIERS - 1;
+        while(tier > 0 && LOD_SLICES[tier] < slices) tier--;
+        lod.cylinderTier[c] = tier;
+    }
+
+    float tube = TUBE_LENGTH * pixelsPerUnit(camDist, viewportH);
+    lod.particleLimit = (size_t)(LOD_PARTICLES_PER_PIXEL * tube * tube);
+    lod.labels = tube >= LOD_LABEL_PIXELS;
+    return lod;
+}
+
+// --------------------------- Record and Replay --------------------------------
+
+void recordSnapshot(const FrameSnapshot &snap) {
+    const RecordedState state = {
+        (uint8_t)snap.intro, (uint8_t)snap.physics, (uint8_t)snap.showTrace, (uint8_t)snap.stage,
+        snap.tipX, snap.tipY, snap.tipZ, snap.simMs,
+        snap.phosphorRes, snap.heatmapRes,
+        (uint8_t)snap.showHeatmap, {0, 0, 0}
+    };
+    // the snapshot holds the trace or the phosphor, whichever is shown, and
+    // the heatmap only while it is shown
+    const size_t traceBytes = snap.showTrace ? snap.trace.points.size() * sizeof(TracePoint) : 0;
+    const size_t bandBytes = snap.showTrace ? sizeof(snap.trace.bandStart) : 0;
+
+    recorder.beginTick();
+    recorder.field(&state, sizeof(state));
+    recorder.field(snap.points.data(), snap.points.size() * sizeof(float));
+    recorder.field(snap.trace.points.data(), traceBytes);
+    recorder.field(snap.trace.bandStart, bandBytes);
+    recorder.field(snap.phosphor.data(), snap.showTrace ? 0 : snap.phosphor.size());
+    recorder.field(snap.heatmap.data(), snap.showHeatmap ? snap.heatmap.size() : 0);
+    recorder.field(snap.spectrum.data(), snap.showSpectrum ? snap.spectrum.size() * sizeof(float) : 0);
+    if(!recorder.endTick()) {
+        fprintf(stderr, "CRT_3D: write to %s failed, recording stopped\n", recordPath.c_str());
+        recorder.close();
+    }
+}
+
+// Recorded trace fields back into a TraceSnapshot, checking the bands fit
+bool loadTrace(const std::vector<uint8_t> &points, const std::vector<uint8_t> &bands, TraceSnapshot &trace) {
+    const size_t n = points.size() / sizeof(TracePoint);
+    trace.points.resize(n);
+    if(n) memcpy(trace.points.data(), points.data(), n * sizeof(TracePoint));
+    memcpy(trace.bandStart, bands.data(), sizeof(trace.bandStart));
+    for(int b=0; b<TRACE_FADE_BANDS; b++)
+        if(trace.bandStart[b] > trace.bandStart[b+1]) return false;
+    return trace.bandStart[TRACE_FADE_BANDS] <= n;
+}
+
+// Fill snap from recorded tick t; false if the tick does not decode
+bool loadSnapshot(size_t t, FrameSnapshot &snap) {
+    if(!replay.seek(t)) return false;
+    const std::vector<uint8_t> &state = replay.field(REC_STATE);
+    const std::vector<uint8_t> &points = replay.field(REC_POINTS);
+    const std::vector<uint8_t> &trace = replay.field(REC_TRACE);
+    const std::vector<uint8_t> &bands = replay.field(REC_TRACE_BANDS);
+    const std::vector<uint8_t> &image = replay.field(REC_PHOSPHOR);
+    const std::vector<uint8_t> &heat = replay.field(REC_HEATMAP);
+    const std::vector<uint8_t> &levels = replay.field(REC_SPECTRUM);
+    RecordedState r;
+    if(state.size() != sizeof(r) || points.size() % sizeof(float) || trace.size() % sizeof(TracePoint)) return false;
+    if(levels.size() % sizeof(float)) return false;
+    memcpy(&r, state.data(), sizeof(r));
+    if(!r.showTrace && (r.phosphorRes <= 0 || image.size() != (size_t)r.phosphorRes * r.phosphorRes)) return false;
+    if(r.showTrace && bands.size() != sizeof(snap.trace.bandStart)) return false;
+    if(r.showHeatmap && (r.heatmapRes <= 0 || heat.size() != 3 * (size_t)r.heatmapRes * r.heatmapRes)) return false;
+
+    snap.intro = r.intro;
+    snap.physics = r.physics;
+    snap.showTrace = r.showTrace;
+    snap.stage = (BeamStage)r.stage;
+    snap.tipX = r.tipX; snap.tipY = r.tipY; snap.tipZ = r.tipZ;
+    snap.points.resize(points.size() / sizeof(float));
+    if(!points.empty()) memcpy(snap.points.data(), points.data(), points.size());
+    if(snap.showTrace) {
+        if(!loadTrace(trace, bands, snap.trace)) return false;
     } else {
-        glLoadIdentity();
-        float radPhi = camPhi * 3.14159f / 180.0f;
-        float radTheta = camTheta * 3.14159f / 180.0f;
+        snap.phosphor = image;
+        snap.phosphorRes = r.phosphorRes;
+    }
+    snap.showHeatmap = r.showHeatmap;
+    if(snap.showHeatmap) {
+        snap.heatmap = heat;
+        snap.heatmapRes = r.heatmapRes;
+    }
+    snap.showSpectrum = !levels.empty();
+    snap.spectrum.resize(levels.size() / sizeof(float));
+    if(!levels.empty()) memcpy(snap.spectrum.data(), levels.data(), levels.size());
+    return true;
+}
+
+// Open the --record or --replay file and the --export file; a replay also
+// brings back the run settings stored with it. False (with a message) if the file cannot be used.
+bool openRecording() {
+    if(!replayPath.empty()) {
+        RecordInfo info;
+        if(!replay.open(replayPath.c_str()) || replay.ticks() == 0 || replay.infoSize() != sizeof(info) ||
+           replay.fieldsPerTick() != REC_FIELD_COUNT) {
+            fprintf(stderr, "CRT_3D: %s is not a CRT_3D recording\n", replayPath.c_str());
+            return false;
+        }
+        memcpy(&info, replay.info(), sizeof(info));
+        rasterLines = info.rasterLines;
+        spectrumSize = (size_t)info.spectrumSize;
+        spectrumRate = info.spectrumRate;
+        replayTick = std::min(replayTick, replay.ticks() - 1);
+        if(!recordPath.empty()) fprintf(stderr, "CRT_3D: --record is ignored while replaying\n");
+    } else if(!recordPath.empty()) {
+        const RecordInfo info = { rasterLines, (int32_t)spectrumSize, spectrumRate };
+        if(!recorder.open(recordPath.c_str(), REC_FIELD_COUNT, &info, sizeof(info))) {
+            fprintf(stderr, "CRT_3D: cannot write %s\n", recordPath.c_str());
+            return false;
+        }
+    }
+    if(!exportPath.empty() && replayPath.empty() && !sampleExport.open(exportPath.c_str())) {
+        fprintf(stderr, "CRT_3D: cannot write %s\n", exportPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Keys that change the simulation, applied on the simulation thread
+void runCommand(unsigned char key) {
+    if(key == 's') { showIntro = false; paused = false; }
+    if(key == 'p') paused = !paused;
+    if(key == 'm') setPhysicsMode(!physicsMode);
+    if(key == 'c') {
+        spaceChargeOn = !spaceChargeOn;
+        electrons.setSpaceCharge(spaceChargeOn ? spaceCharge : 0.0f);
+    }
+    if(key == 'l') {
+        solvedField = !solvedField;
+        electrons.setSolvedField(solvedField, jobs);
+    }
+    if(key == 'x') {
+        const char* path = heatmapPath.empty() ? HEATMAP_FILE : heatmapPath.c_str();
+        if(heatmap.write(path)) printf("Impact heatmap written to %s\n", path);
+        else fprintf(stderr, "CRT_3D: cannot write %s\n", path);
+    }
+    if(key == 'r') {
+        paused = true;
+        simCurr.stage = STAGE_FILAMENT;
+        simCurr.progress = 0.0f;
+        simPrev = simCurr;
+        traceHistory.clear();
+        phosphor.clear();
+        beamSampler.restart();
+    }
+}
 
-        float eyeX = camDist * cos(radPhi) * sin(radTheta);
-        float eyeY = camDist * sin(radPhi);
-        float eyeZ = camDist * cos(radPhi) * cos(radTheta);
+// One update of the simulation thread: apply the queued keys, advance by
+// `steps` fixed steps and publish what display() needs as a snapshot
+void simulateFrame(int steps) {
+    commands.drain(runCommand);
+
+    FrameSnapshot &snap = snapshots.back();
+    FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+    advanceSimulation(steps, snap.points);
+    snap.simMs = (float)FrameTimings::msSince(t0);
+
+    snap.intro = showIntro;
+    snap.physics = physicsMode;
+    snap.stage = beamStage;
+    snap.tipX = beamTipX; snap.tipY = beamTipY; snap.tipZ = beamTipZ;
+    snap.showTrace = showTrace.load(std::memory_order_relaxed);
+    if(snap.showTrace) {
+        traceHistory.copyTo(snap.trace);
+    } else {
+        const size_t cells = (size_t)phosphor.resolution() * phosphor.resolution();
+        snap.phosphor.assign(phosphor.image(), phosphor.image() + cells);
+        snap.phosphorRes = phosphor.resolution();
+    }
+    snap.showHeatmap = showHeatmap.load(std::memory_order_relaxed);
+    if(snap.showHeatmap) {
+        heatmap.colorize(snap.heatmap);
+        snap.heatmapRes = heatmap.resolution();
+    }
+    snap.showSpectrum = showSpectrum.load(std::memory_order_relaxed);
+    if(snap.showSpectrum) snap.spectrum = spectrum.levelsXY();
+    snap.frame = ++snapshotCount;
+    if(recorder.isOpen()) recordSnapshot(snap);
+    if(sampleExport.isOpen()) sampleExport.flush();
+    snapshots.publish();
+}
 
-        gluLookAt(eyeX, eyeY, eyeZ + 6.0f,  0, 0, 6.0f,  0, 1, 0);
+// Replay update: apply the replay keys, decode the current tick into the
+// snapshot and step to the next one. The simulate time is the decode time.
+void replayFrame() {
+    commands.drain([](unsigned char key) {
+        const size_t last = replay.ticks() - 1;
+        if(key == 'p') replayPaused = !replayPaused;
+        if(key == 'r') replayTick = 0;
+        if(key == '[') replayTick = replayTick > (size_t)REPLAY_JUMP ? replayTick - REPLAY_JUMP : 0;
+        if(key == ']') replayTick = std::min(last, replayTick + REPLAY_JUMP);
+        if(key == 'r' || key == '[' || key == ']') replayDamaged = false;
+    });
+    if(replayDamaged) return;   // until a seek
+
+    FrameSnapshot &snap = snapshots.back();
+    FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+    if(!loadSnapshot(replayTick, snap)) {
+        fprintf(stderr, "CRT_3D: %s is damaged at tick %zu\n", replayPath.c_str(), replayTick);
+        replayDamaged = true;
+        return;
+    }
+    snap.simMs = (float)FrameTimings::msSince(t0);
+    snap.frame = ++snapshotCount;
+    snapshots.publish();
+    if(!replayPaused && replayTick + 1 < replay.ticks()) replayTick++;
+}
 
-        drawCRT();
-        drawBeam();
-        drawHUD();
+void display() {
+    const FrameSnapshot &snap = snapshots.acquire();
+    if(snap.intro) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawIntro();
+        glutSwapBuffers();
+        return;
     }
+
+    // the update ran on the simulation thread; its time is charged to the
+    // frame that shows it
+    profiler.beginFrame();
+    profiler.record(PROF_SIMULATE, snap.simMs);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glLoadIdentity();
+    float eyeX, eyeY, eyeZ;
+    cameraEye(eyeX, eyeY, eyeZ);
+    gluLookAt(eyeX, eyeY, eyeZ,  0, 0, 6.0f,  0, 1, 0);
+    textRenderer.setMatrices();
+
+    const LodChoice lod = chooseLod(eyeX, eyeY, eyeZ, glutGet(GLUT_WINDOW_HEIGHT));
+    particleLimit.store(lod.particleLimit, std::memory_order_relaxed);
+
+    {
+        ProfileScope scope(profiler, PROF_CRT);
+        drawTube(lod);
+        if(raster.enabled()) drawRasterScreen(snap);
+        if(lod.labels) queueTubeLabels();
+    }
+    { ProfileScope scope(profiler, PROF_BEAM); drawBeam(snap, lod); }
+    { ProfileScope scope(profiler, PROF_HUD); drawHUD(snap); }
+    {
+        ProfileScope scope(profiler, PROF_TEXT);
+        textRenderer.flush(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+    }
+
+    if(showProfiler) profiler.drawOverlay(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+    profiler.endFrame();
     glutSwapBuffers();
 }
 
@@ -480,49 +1384,45 @@ void reshape(int w, int h) {
     glLoadIdentity();
     gluPerspective(45.0f, (float)w/h, 1.0f, 100.0f);
     glMatrixMode(GL_MODELVIEW);
+
+    if(!hudList) hudList = glGenLists(1);
+    glNewList(hudList, GL_COMPILE);
+    drawHUDFrame(w);
+    glEndList();
 }
 
 // --------------------------- Logic --------------------------------------------
 
 void timer(int val) {
-    if(showIntro && !introEffectsDone) {
+    if(!introEffectsDone) {
         introAlpha += 0.02f;
         if(introAlpha >= 1.0f) { introAlpha = 1.0f; introEffectsDone = true; }
     }
 
-    if(!showIntro && !paused) {
-        calculateBeam();
-        beamProgress += 0.015f;
-        if(beamProgress > 1.0f) beamProgress = 1.0f;
-
-        if(beamStage == STAGE_SCREEN) {
-            screenTheta += 0.05f;
-            if(screenTheta > 6.28f) screenTheta -= 6.28f;
-            if(beamProgress >= 1.0f) beamProgress = 0.0f;
-            traceHistory.push_back({beamTipX, beamTipY});
-            if(traceHistory.size() > 500) traceHistory.erase(traceHistory.begin());
-        } else {
-            if(beamProgress >= 1.0f) {
-                beamProgress = 0.0f;
-                beamStage = (BeamStage)(beamStage + 1);
-            }
-        }
-    }
+    // The simulation runs on simThread; this only asks for the newest snapshot
     glutPostRedisplay();
-    glutTimerFunc(16, timer, 0);
+    glutTimerFunc(TIMER_MS, timer, 0);
 }
 
 // --------------------------- Input --------------------------------------------
 
 void keyboard(unsigned char key, int x, int y) {
     if(key == 27) exit(0);
-    if(key == 's' || key == 'S') { showIntro = false; paused = false; }
-    if(key == 'p' || key == 'P') paused = !paused;
-    if(key == 'r' || key == 'R') {
-        paused = true;
-        beamStage = STAGE_FILAMENT;
-        beamProgress = 0.0f;
-        traceHistory.clear();
+    if(key == 's' || key == 'S') commands.push('s');
+    if(key == 'p' || key == 'P') commands.push('p');
+    if(key == 'm' || key == 'M') commands.push('m');
+    if(key == 'c' || key == 'C') commands.push('c');
+    if(key == 'l' || key == 'L') commands.push('l');
+    if(key == 'r' || key == 'R') commands.push('r');
+    if(key == '[' || key == ']') commands.push(key);
+    if(key == 't' || key == 'T') showTrace = !showTrace;
+    if(key == 'h' || key == 'H') showHeatmap = !showHeatmap;
+    if(key == 'a' || key == 'A') showSpectrum = !showSpectrum;
+    if(key == 'x' || key == 'X') commands.push('x');
+    if(key == 'f' || key == 'F') showProfiler = !showProfiler;
+    if(key == 'e' || key == 'E') {
+        if(profiler.writeCsv(PROFILE_CSV)) printf("Frame profile written to %s\n", PROFILE_CSV);
+        else fprintf(stderr, "CRT_3D: cannot write %s\n", PROFILE_CSV);
     }
 }
 
@@ -551,18 +1451,493 @@ void motion(int x, int y) {
     }
 }
 
+// --------------------------- Headless Mode ------------------------------------
+
+// Projects world points for the CPU rasterizer with the same camera and
+// perspective as display() / reshape()
+struct SoftScene {
+    SoftCanvas &c;
+    SoftMat4 mvp;
+
+    bool project(float x, float y, float z, float &px, float &py) const {
+        return mvp.project(x, y, z, c.width, c.height, px, py);
+    }
+
+    void line(float x0, float y0, float z0, float x1, float y1, float z1, const SoftColor &col, float width = 1.0f) {
+        float ax, ay, bx, by;
+        if(project(x0, y0, z0, ax, ay) && project(x1, y1, z1, bx, by)) c.line(ax, ay, bx, by, col, width);
+    }
+
+    // Convex planar polygon; back faces (clockwise on screen) are skipped
+    // when cull is set, which stands in for the depth test on closed solids
+    void polygon(const float *xyz, int n, const SoftColor &col, bool cull) {
+        float pts[2 * 8];
+        for(int i=0; i<n; i++) {
+            if(!project(xyz[3*i], xyz[3*i+1], xyz[3*i+2], pts[2*i], pts[2*i+1])) return;
+        }
+        if(cull) {
+            float area = 0;
+            for(int i=0; i<n; i++) {
+                int j = (i + 1) % n;
+                area += pts[2*i] * pts[2*j+1] - pts[2*j] * pts[2*i+1];
+            }
+            if(area <= 0) return;
+        }
+        c.convex(pts, n, col);
+    }
+};
+
+// Counterpart of drawTechBox(): front faces filled, then the edges
+void softTechBox(SoftScene &sc, float cx, float cy, float cz, float w, float h, float d,
+                 float r, float g, float b) {
+    static const int FACES[6][4] = {
+        {0,1,3,2}, {4,6,7,5}, {0,4,5,1}, {2,3,7,6}, {0,2,6,4}, {1,5,7,3}
+    };
+    float v[8][3];
+    for(int i=0; i<8; i++) {
+        v[i][0] = cx + ((i & 4) ? 0.5f : -0.5f) * w;
+        v[i][1] = cy + ((i & 2) ? 0.5f : -0.5f) * h;
+        v[i][2] = cz + ((i & 1) ? 0.5f : -0.5f) * d;
+    }
+    for(int f=0; f<6; f++) {
+        float quad[12];
+        for(int k=0; k<4; k++) {
+            quad[3*k] = v[FACES[f][k]][0]; quad[3*k+1] = v[FACES[f][k]][1]; quad[3*k+2] = v[FACES[f][k]][2];
+        }
+        sc.polygon(quad, 4, {r, g, b, 0.8f}, true);
+    }
+    SoftColor edge = {0.1f, 0.1f, 0.1f, 1.0f};
+    for(int i=0; i<8; i++) {
+        for(int bit=1; bit<8; bit<<=1) {
+            int j = i | bit;
+            if(j != i) sc.line(v[i][0], v[i][1], v[i][2], v[j][0], v[j][1], v[j][2], edge, 1.5f);
+        }
+    }
+}
+
+// Counterpart of drawCylinderPart(): cylinder along +z from z0
+void softCylinderPart(SoftScene &sc, float z0, float baseR, float topR, float height,
+                      float r, float g, float b, float alpha) {
+    const int SLICES = 32;
+    for(int i=0; i<SLICES; i++) {
+        float a0 = 6.2831853f * i / SLICES, a1 = 6.2831853f * (i + 1) / SLICES;
+        float quad[12] = {
+            baseR*cosf(a0), baseR*sinf(a0), z0,
+            baseR*cosf(a1), baseR*sinf(a1), z0,
+            topR*cosf(a1),  topR*sinf(a1),  z0 + height,
+            topR*cosf(a0),  topR*sinf(a0),  z0 + height
+        };
+        sc.polygon(quad, 4, {r, g, b, alpha}, true);
+    }
+    SoftColor wire = {0.2f, 0.2f, 0.2f, 0.5f};
+    for(int i=0; i<16; i++) {
+        float a0 = 6.2831853f * i / 16, a1 = 6.2831853f * (i + 1) / 16;
+        sc.line(baseR*cosf(a0), baseR*sinf(a0), z0, topR*cosf(a0), topR*sinf(a0), z0 + height, wire);
+        sc.line(baseR*cosf(a0), baseR*sinf(a0), z0, baseR*cosf(a1), baseR*sinf(a1), z0, wire);
+        sc.line(topR*cosf(a0), topR*sinf(a0), z0 + height, topR*cosf(a1), topR*sinf(a1), z0 + height, wire);
+    }
+}
+
+// The simulation scene of display() on the CPU rasterizer. There is no depth
+// buffer, so parts are drawn back to front along the tube as seen from the
+// default camera; text labels are left out (no fonts without GLUT).
+void renderSoft(SoftCanvas &c, const FrameSnapshot &snap) {
+    c.noClip();
+    c.clear(1.0f, 1.0f, 1.0f);
+
+    float eyeX, eyeY, eyeZ;
+    cameraEye(eyeX, eyeY, eyeZ);
+    SoftScene sc = { c, SoftMat4::perspective(45.0f, (float)c.width / c.height, 1.0f, 100.0f) *
+                        SoftMat4::lookAt(eyeX, eyeY, eyeZ, 0, 0, 6.0f, 0, 1, 0) };
+
+    softTechBox(sc, 0, 0, -0.5f, 0.4f, 0.4f, 0.5f, 0.8f, 0.4f, 0.1f);   // heater
+    softTechBox(sc, 0, 0, 0.5f, 0.8f, 0.8f, 1.0f, 0.8f, 0.3f, 0.3f);    // cathode
+    softCylinderPart(sc, 2.5f, 0.5f, 0.5f, 2.0f, 0.7f, 0.7f, 0.7f, 0.9f); // anodes
+    softTechBox(sc, 0, 0.6f, 5.5f, 1.0f, 0.1f, 1.5f, 0.4f, 0.4f, 0.4f);  // Y plates
+    softTechBox(sc, 0, -0.6f, 5.5f, 1.0f, 0.1f, 1.5f, 0.4f, 0.4f, 0.4f);
+    softTechBox(sc, -0.6f, 0, 7.5f, 0.1f, 1.0f, 1.5f, 0.3f, 0.3f, 0.3f); // X plates
+    softTechBox(sc, 0.6f, 0, 7.5f, 0.1f, 1.0f, 1.5f, 0.3f, 0.3f, 0.3f);
+    softCylinderPart(sc, 8.5f, 0.6f, 2.5f, 4.0f, 0.8f, 0.9f, 1.0f, 0.15f); // glass funnel
+
+    float screen[12] = {
+        -SCREEN_W/2, -SCREEN_H/2, 12.5f,   SCREEN_W/2, -SCREEN_H/2, 12.5f,
+         SCREEN_W/2,  SCREEN_H/2, 12.5f,  -SCREEN_W/2,  SCREEN_H/2, 12.5f
+    };
+    sc.polygon(screen, 4, {0.9f, 0.95f, 0.9f, 0.9f}, false);
+    for(int i=0; i<4; i++) {
+        int j = (i + 1) % 4;
+        sc.line(screen[3*i], screen[3*i+1], screen[3*i+2], screen[3*j], screen[3*j+1], screen[3*j+2],
+                {0.1f, 0.1f, 0.1f, 1.0f}, 3.0f);
+    }
+
+    // Beam
+    if(snap.stage == STAGE_SCREEN || snap.stage == STAGE_DEFLECTION) {
+        for(int i=0; i<4; i++) {
+            int j = (i + 1) % 4;
+            float tri[9] = { 0, 0, 8.5f, screen[3*i], screen[3*i+1], screen[3*i+2], screen[3*j], screen[3*j+1], screen[3*j+2] };
+            sc.polygon(tri, 3, {0.0f, 0.5f, 1.0f, 0.05f}, false);
+        }
+    }
+    const std::vector<float> &verts = snap.points;
+    SoftColor dot = {0.1f, 0.2f, 1.0f, snap.physics ? 0.5f : 0.8f};
+    float dotSize = snap.physics ? 2.0f : 4.0f;
+    for(size_t i=0; i + 2 < verts.size(); i += 3) {
+        float px, py;
+        if(sc.project(verts[i], verts[i+1], verts[i+2], px, py)) c.point(px, py, dotSize, dot);
+    }
+    SoftColor beam = {0.0f, 0.0f, 1.0f, 0.6f};
+    sc.line(0, 0, 0, 0, 0, 5.5f, beam, 2.0f);
+    sc.line(0, 0, 5.5f, snap.tipX, snap.tipY, snap.tipZ, beam, 2.0f);
+    float tipX, tipY;
+    if(sc.project(snap.tipX, snap.tipY, snap.tipZ, tipX, tipY)) c.point(tipX, tipY, 8.0f, {0.0f, 1.0f, 1.0f, 1.0f});
+
+    // HUD inset, same placement and mapping as drawHUD()
+    float px = (float)(c.width - HUD_INSET_SIZE - HUD_MARGIN), py = (float)HUD_MARGIN, S = (float)HUD_INSET_SIZE;
+    float box[8] = { px, py, px + S, py, px + S, py + S, px, py + S };
+    if(raster.enabled()) c.convex(box, 4, {0.02f, 0.04f, 0.02f, 1.0f});
+    else c.convex(box, 4, {1.0f, 1.0f, 1.0f, 1.0f});
+    SoftColor border = {0.1f, 0.2f, 0.5f, 1.0f};
+    for(int i=0; i<4; i++) {
+        int j = (i + 1) % 4;
+        c.line(box[2*i], box[2*i+1], box[2*j], box[2*j+1], border, 2.0f);
+    }
+    if(snap.showTrace) {
+        float k = S / (HUD_MAP_MAX - HUD_MAP_MIN);
+        softTrace(c, snap.trace, px - HUD_MAP_MIN * k, py - HUD_MAP_MIN * k, k, k, {0.0f, 0.4f, 1.0f, 1.0f}, TRACE_FADE_BANDS);
+    } else {
+        SoftColor glow = raster.enabled() ? SoftColor{0.75f, 1.0f, 0.8f, 1.0f} : SoftColor{0.0f, 0.4f, 1.0f, 1.0f};
+        softAlphaImage(c, snap.phosphor.data(), snap.phosphorRes, px, py, S, glow);
+    }
+    if(snap.showSpectrum) {
+        float qy = py + S + HUD_MARGIN;
+        float panel[8] = { px, qy, px + S, qy, px + S, qy + S, px, qy + S };
+        c.convex(panel, 4, {0.05f, 0.06f, 0.1f, 1.0f});
+        softSpectrum(c, snap.spectrum, px, qy, S, S, SPECTRUM_GRID_DB, SpectrumAnalyzer::DB_FLOOR);
+        for(int i=0; i<4; i++) {
+            int j = (i + 1) % 4;
+            c.line(panel[2*i], panel[2*i+1], panel[2*j], panel[2*j+1], border, 2.0f);
+        }
+    }
+}
+
+void printFieldSolve() {
+    const FieldSolver& grid = electrons.fieldGrid();
+    const FieldSolveStats& s = electrons.fieldSolveStats();
+    printf("Field solve: 3 potentials on %dx%dx%d nodes, %d sweeps (omega %.2f), last change %.1e, %.2f ms\n",
+           grid.sizeX(), grid.sizeY(), grid.sizeZ(), s.sweeps, grid.overRelaxation(), s.residual, s.ms);
+}
+
+// Barnes-Hut tree against the direct sum on the final beam
+void printSpaceChargeCheck() {
+    const SpaceChargeCheck c = electrons.checkSpaceCharge(jobs);
+    printf("Space charge, %zu electrons: tree %.2f ms (%zu nodes, %.0f interactions each), direct %.2f ms, "
+           "error rms %.2e max %.2e\n", c.electrons, c.treeMs, c.nodes, c.interactions, c.directMs,
+           c.rmsError, c.maxError);
+}
+
+// Run headlessFrames frames at a fixed 1/HEADLESS_FPS step without GLUT,
+// optionally dumping them, and print per-frame timing statistics. The
+// simulation runs on this thread, one snapshot per frame. Frame writes are
+// not included in the timings. A replay renders the recorded ticks from
+// --replay-from on, up to N of them.
+int runHeadless() {
+    if(!openRecording()) return 1;
+    initSimulation();
+    if(physicsMode) setPhysicsMode(true);
+    showIntro = false;
+    paused = false;
+    const bool replaying = !replayPath.empty();
+    if(replaying) headlessFrames = (int)std::min((size_t)headlessFrames, replay.ticks() - replayTick);
+    const size_t firstTick = replayTick;
+
+    SoftCanvas canvas(headlessW, headlessH);
+    FrameDumper dumper;
+    if(!dumpPath.empty() && !dumper.open(dumpPath, headlessW, headlessH, HEADLESS_FPS)) {
+        fprintf(stderr, "CRT_3D: cannot open %s\n", dumpPath.c_str());
+        return 1;
+    }
+
+    FrameTimings simTimes, renderTimes, frameTimes;
+    for(int f=0; f<headlessFrames; f++) {
+        FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+        if(replaying) replayFrame();
+        else simulateFrame(simClock.advanceBy(1.0 / HEADLESS_FPS));
+        if(replayDamaged) return 1;
+        double simMs = FrameTimings::msSince(t0);
+
+        FrameTimings::Clock::time_point t1 = FrameTimings::Clock::now();
+        renderSoft(canvas, snapshots.acquire());
+        double renderMs = FrameTimings::msSince(t1);
+
+        simTimes.add(simMs);
+        renderTimes.add(renderMs);
+        frameTimes.add(simMs + renderMs);
+
+        if(!dumpPath.empty() && !dumper.write(canvas, f)) {
+            fprintf(stderr, "CRT_3D: write to %s failed at frame %d\n", dumpPath.c_str(), f);
+            return 1;
+        }
+    }
+    if(!dumper.close()) {
+        fprintf(stderr, "CRT_3D: write to %s failed\n", dumpPath.c_str());
+        return 1;
+    }
+
+    if(replaying) {
+        printf("CRT_3D headless: %d frames, %dx%d, replay of %s from tick %zu\n", headlessFrames,
+               headlessW, headlessH, replayPath.c_str(), firstTick);
+    } else {
+        printf("CRT_3D headless: %d frames, %dx%d, %d fps fixed step, %s, seed %llu, threads %u\n", headlessFrames,
+               headlessW, headlessH, HEADLESS_FPS,
+               physicsMode ? (spaceChargeOn ? "physics with space charge" : "physics") : "scripted",
+               (unsigned long long)randomSeed, jobs.threadCount());
+    }
+    if(recorder.isOpen()) {
+        const unsigned long long ticks = recorder.ticks();
+        if(!recorder.close()) {
+            fprintf(stderr, "CRT_3D: write to %s failed\n", recordPath.c_str());
+            return 1;
+        }
+        printf("Recorded %llu ticks to %s\n", ticks, recordPath.c_str());
+    }
+    if(sampleExport.isOpen()) {
+        if(!sampleExport.close()) {
+            fprintf(stderr, "CRT_3D: write to %s failed\n", exportPath.c_str());
+            return 1;
+        }
+        printf("Exported %llu beam samples to %s (%llu dropped)\n", (unsigned long long)sampleExport.samplesWritten(),
+               exportPath.c_str(), (unsigned long long)sampleExport.samplesDropped());
+    }
+    simTimes.print(replaying ? "decode" : "simulate");
+    renderTimes.print("render");
+    frameTimes.print("frame");
+    if(solvedField && physicsMode && !replaying) printFieldSolve();
+    if(spaceChargeCheck && physicsMode && !replaying) printSpaceChargeCheck();
+
+    if(!heatmapPath.empty() && !replaying) {   // a replay has no hits to count
+        if(!heatmap.write(heatmapPath.c_str())) {
+            fprintf(stderr, "CRT_3D: cannot write %s\n", heatmapPath.c_str());
+            return 1;
+        }
+        printf("impact heatmap: %llu hits written to %s\n", (unsigned long long)heatmap.total(), heatmapPath.c_str());
+    }
+    return 0;
+}
+
+// --------------------------- Particle Benchmark -------------------------------
+
+void benchLevel(size_t count) {
+    bench.count = count;
+    bench.frame = 0;
+    bench.sim = FrameTimings();
+    bench.render = FrameTimings();
+    bench.drawn = 0;
+    numParticles = (int)count;
+    initParticles();
+}
+
+// Scripted beam, running, on the screen stage, so particles are live up to
+// the tip
+void benchStart(bool window) {
+    initSimulation();
+    lodEnabled = false;   // every particle is drawn, however far the camera
+    physicsMode = false;
+    showIntro = false;
+    paused = false;
+    simCurr.stage = STAGE_SCREEN;
+    simCurr.progress = 0.0f;
+    simPrev = simCurr;
+    printf("CRT_3D particle benchmark, %s, threads %u, budget %.2f ms per frame%s\n",
+           window ? "window" : "CPU rasterizer", jobs.threadCount(), BENCH_BUDGET_MS,
+           window ? " (simulate and render overlap)" : "");
+    printf("%10s %10s %12s %12s %12s\n", "particles", "drawn", "simulate ms", "render ms", "frame ms");
+    benchLevel(BENCH_MIN);
+}
+
+// One benchmark frame; render() draws the newest snapshot and returns its
+// time in ms. In the window the simulation normally runs on its own thread,
+// so a frame costs the slower of the two; headless runs them back to back.
+// Returns false once the benchmark is over.
+template <typename F>
+bool benchStep(bool window, int framesPerCount, F render) {
+    FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+    simulateFrame(simClock.advanceBy(1.0 / HEADLESS_FPS));
+    double simMs = FrameTimings::msSince(t0);
+    double renderMs = render();
+    if(bench.frame++ < BENCH_WARMUP) return true;
+
+    bench.sim.add(simMs);
+    bench.render.add(renderMs);
+    bench.drawn += snapshots.front().points.size() / 3;
+    if(bench.frame < BENCH_WARMUP + framesPerCount) return true;
+
+    double sim = bench.sim.average(), ren = bench.render.average();
+    double frame = window ? std::max(sim, ren) : sim + ren;
+    printf("%10zu %10zu %12.3f %12.3f %12.3f\n", bench.count, bench.drawn / bench.sim.count(), sim, ren, frame);
+    bool fits = frame <= BENCH_BUDGET_MS;
+    if(fits) bench.reached = bench.count;
+    if(fits && bench.count * 2 <= BENCH_MAX) {
+        benchLevel(bench.count * 2);
+        return true;
+    }
+    if(bench.reached) printf("%zu particles reachable at 60 FPS%s\n", bench.reached, fits ? " (benchmark limit)" : "");
+    else printf("fewer than %zu particles reachable at 60 FPS\n", BENCH_MIN);
+    return false;
+}
+
+int runHeadlessBench() {
+    benchStart(false);
+    SoftCanvas canvas(headlessW, headlessH);
+    while(benchStep(false, headlessFrames, [&]() {
+        FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+        renderSoft(canvas, snapshots.acquire());
+        return FrameTimings::msSince(t0);
+    })) {}
+    return 0;
+}
+
+// GLUT idle callback while benchmarking: frames are timed up to glFinish()
+void benchIdle() {
+    bool more = benchStep(true, BENCH_FRAMES, []() {
+        FrameTimings::Clock::time_point t0 = FrameTimings::Clock::now();
+        display();
+        glFinish();
+        return FrameTimings::msSince(t0);
+    });
+    if(!more) exit(0);
+}
+
+// Options are parsed before glutInit() so --headless never needs a display;
+// GLUT's own options are skipped here
+void parseArgs(int argc, char** argv) {
+    for(int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if(arg == "--trace-depth" && i+1 < argc) {
+            traceDepth = (size_t)std::max(2L, std::atol(argv[++i]));
+        }
+        else if(arg == "--particles" && i+1 < argc) {
+            numParticles = std::max(0, atoi(argv[++i]));
+        }
+        else if(arg == "--heatmap" && i+1 < argc) {
+            heatmapPath = argv[++i];
+        }
+        else if(arg == "--no-lod") {
+            lodEnabled = false;
+        }
+        else if(arg == "--bench-particles") {
+            benchParticles = true;
+        }
+        else if((arg == "--signal-x" || arg == "--signal-y") && i+1 < argc) {
+            SignalChannel &channel = arg == "--signal-x" ? signals.x : signals.y;
+            if(!channel.parse(argv[++i])) fprintf(stderr, "CRT_3D: ignoring bad signal '%s'\n", argv[i]);
+        }
+        else if(arg == "--raster" && i+1 < argc) {
+            rasterLines = std::max(0, atoi(argv[++i]));
+        }
+        else if(arg == "--raster-input" && i+1 < argc) {
+            rasterInput = argv[++i];
+            if(rasterLines == 0) rasterLines = 480;
+        }
+        else if(arg == "--sample-rate" && i+1 < argc) {
+            beamSampler.setRate(atof(argv[++i]));
+        }
+        else if(arg == "--persistence" && i+1 < argc) {
+            persistence = (float)atof(argv[++i]);
+        }
+        else if(arg == "--threads" && i+1 < argc) {
+            threadCount = (unsigned)std::max(0, atoi(argv[++i]));
+        }
+        else if(arg == "--seed" && i+1 < argc) {
+            randomSeed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if(arg == "--physics" && i+1 < argc) {
+            electronCount = (size_t)std::max(1L, std::atol(argv[++i]));
+            physicsMode = true;
+        }
+        else if(arg == "--space-charge" && i+1 < argc) {
+            spaceCharge = std::max(0.0f, (float)atof(argv[++i]));
+            spaceChargeOn = spaceCharge > 0.0f;
+        }
+        else if(arg == "--space-charge-check") {
+            spaceChargeCheck = true;
+        }
+        else if(arg == "--solved-field") {
+            solvedField = true;
+        }
+        else if(arg == "--sim-hz" && i+1 < argc) {
+            simClock.setRate(std::atof(argv[++i]));
+        }
+        else if(arg == "--time-scale" && i+1 < argc) {
+            simClock.setTimeScale(std::atof(argv[++i]));
+        }
+        else if(arg == "--headless" && i+1 < argc) {
+            headlessFrames = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg == "--size" && i+1 < argc) {
+            int w = 0, h = 0;
+            if(sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+                headlessW = w;
+                headlessH = h;
+            }
+        }
+        else if(arg == "--dump" && i+1 < argc) {
+            dumpPath = argv[++i];
+        }
+        else if(arg == "--record" && i+1 < argc) {
+            recordPath = argv[++i];
+        }
+        else if(arg == "--replay" && i+1 < argc) {
+            replayPath = argv[++i];
+        }
+        else if(arg == "--export" && i+1 < argc) {
+            exportPath = argv[++i];
+        }
+        else if(arg == "--spectrum") {
+            showSpectrum = true;
+        }
+        else if(arg == "--spectrum-size" && i+1 < argc) {
+            spectrumSize = (size_t)std::max(16L, std::atol(argv[++i]));
+        }
+        else if(arg == "--spectrum-rate" && i+1 < argc) {
+            spectrumRate = std::max(1.0, atof(argv[++i]));
+        }
+        else if(arg == "--replay-from" && i+1 < argc) {
+            replayTick = (size_t)std::max(0LL, std::atoll(argv[++i]));
+        }
+    }
+}
+
 int main(int argc, char** argv) {
+    parseArgs(argc, argv);
+    jobs.start(threadCount);
+    if(headlessFrames > 0) return benchParticles ? runHeadlessBench() : runHeadless();
+    if(!benchParticles && !openRecording()) return 1;
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
     glutInitWindowSize(WIN_W, WIN_H);
     glutCreateWindow("CRT Simulation 3D");
     init();
+    buildStaticLists();
+    if(benchParticles) {
+        benchStart(true);
+    } else if(!replayPath.empty()) {
+        initSimulation();
+        replayFrame();
+        simThread.start(TIMER_MS, replayFrame);
+    } else {
+        initSimulation();
+        if(physicsMode) setPhysicsMode(true);
+        simulateFrame(0);
+        simThread.start(TIMER_MS, []() { simulateFrame(simClock.advance()); });
+    }
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutMouseFunc(mouse);
     glutMotionFunc(motion);
-    glutTimerFunc(16, timer, 0);
+    if(benchParticles) glutIdleFunc(benchIdle);
+    else glutTimerFunc(TIMER_MS, timer, 0);
     glutMainLoop();
     return 0;
 }
\ No newline at end of file
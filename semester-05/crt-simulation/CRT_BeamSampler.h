@@ -0,0 +1,67 @@
+// CRT_BeamSampler.h
+// Sub-frame beam sampling shared by CRT_2D and CRT_3D (--sample-rate HZ).
+//
+// The scripted beam is a closed-form function of the deflection signals
+// (CRT_Signal.h) and the flight progress, so it can be evaluated at any time
+// inside a frame rather than once per redraw. BeamSampler keeps the signal
+// time of the next sample, so the samples of consecutive frames join up
+// exactly however the frame's time is interpolated, and decides how many
+// each frame owes; the callers evaluate the signal generator for the
+// whole batch, map it to screen positions in one array loop the compiler can
+// vectorize, and push the results into the trace history and the phosphor.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+class BeamSampler {
+public:
+    static const size_t MAX_PER_FRAME = 1 << 22;   // cap for long frames
+
+    // 0 turns sub-frame sampling off (one sample per frame)
+    void setRate(double hz) { sampleHz = hz > 0.0 ? hz : 0.0; }
+    double rate() const { return sampleHz; }
+    bool enabled() const { return sampleHz > 0.0; }
+
+    // Samples owed for a frame of frameDt seconds ending at signal time
+    // `now`: the first at t0, the rest 1 / rate() apart, none after now. A
+    // jump back in time (the sweep restarted) or a gap of more than two
+    // frames (the sampler sat some out) starts over with one frame's worth.
+    size_t window(double now, float frameDt, double& t0) {
+        if (frameDt <= 0.0f) return 0;
+        const double h = 1.0 / sampleHz;
+        if (!started || nextT > now + h || now - nextT > 2.0 * frameDt + h) {
+            nextT = now - frameDt + h;
+            started = true;
+        }
+        if (now < nextT) return 0;
+        size_t n = (size_t)((now - nextT) * sampleHz) + 1;
+        if (n > MAX_PER_FRAME) {   // keep the newest
+            nextT += (n - MAX_PER_FRAME) * h;
+            n = MAX_PER_FRAME;
+        }
+        t0 = nextT;
+        nextT += n * h;
+        return n;
+    }
+
+    // Start over at the next window()
+    void restart() { started = false; }
+
+    // The signal up to `t` went out as one sample for the whole frame; the
+    // next window starts right after it
+    void coveredTo(double t) {
+        if (!enabled()) return;
+        nextT = t + 1.0 / sampleHz;
+        started = true;
+    }
+
+    std::vector<float> x, y, z;   // caller's sample positions and intensities
+
+private:
+    double sampleHz = 0.0;
+    double nextT = 0.0;     // signal time of the next sample
+    bool started = false;
+};
@@ -0,0 +1,382 @@
+// CRT_Electrons.h
+// Physical electron beam: particles leave the cathode, are accelerated by the
+// anode potential, focused by the anode lens and deflected by the plate
+// fields, integrated with a Boris pusher.
+//
+// Coordinates are tube units, the same as the CRT_3D world: z runs along the
+// tube axis from the cathode (z = 0) to the screen (z = 12.5). The charge to
+// mass ratio is normalised to 1, so voltages are in matching units.
+//
+// Electrons are stored as structure-of-arrays. The inner loop is branch-free
+// so the compiler can vectorize it, and each block of electrons is carried
+// through all substeps of a frame while it is hot in cache. Large beams are
+// shared out over the job system (CRT_Jobs.h) a chunk of blocks at a time;
+// every block draws its emission noise from its own random stream
+// (CRT_Random.h), so a seed gives the same beam on any number of threads.
+//
+// Space charge (setSpaceCharge) adds the electrons' mutual repulsion
+// (CRT_SpaceCharge.h). It is computed once per advance() call, before the
+// blocks are pushed, and held over that frame's substeps.
+//
+// setSolvedField swaps the piecewise uniform gun and plate fields for the
+// gradients of the electrode potentials solved on a grid (CRT_FieldSolver.h).
+// Each electron's samples of them are refreshed every FIELD_HOLD substeps (a
+// small fraction of a grid cell of travel) and weighted by the voltages of
+// every substep, so the plates still follow the signals at the full rate.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "CRT_FieldSolver.h"
+#include "CRT_Jobs.h"
+#include "CRT_Random.h"
+#include "CRT_SpaceCharge.h"
+
+namespace tube {
+
+// Geometry (matches drawCRT in CRT_3D.cpp)
+const float ANODE_Z0 = 2.5f;      // gun accelerates from the cathode up to here
+const float ANODE_Z1 = 4.5f;      // end of the anode cylinder (focusing lens)
+const float ANODE_RADIUS = 0.5f;
+const float YPLATE_Z = 5.5f;      // centre of the Y-deflection plates
+const float XPLATE_Z = 7.5f;      // centre of the X-deflection plates
+const float PLATE_LEN = 1.5f;
+const float PLATE_GAP = 1.2f;
+const float PLATE_WIDTH = 1.0f;
+const float SCREEN_Z = 12.5f;
+
+// Default anode potential: gives a cathode-to-screen flight time of ~1.5 s
+const float ANODE_VOLTAGE = 50.0f;
+
+const float CATHODE_RADIUS = 0.05f;  // emission spot radius
+const float THERMAL_SPEED = 0.05f;   // spread of the emission velocity
+
+// Grid for the solved field: the neck from the cathode to past the X plates;
+// beyond it the beam drifts at the anode potential
+const float FIELD_HALF_WIDTH = 0.8f;
+const float FIELD_LENGTH = 9.0f;
+const float FIELD_SPACING = 0.1f;
+const float FIELD_TOLERANCE = 1e-5f;   // per volt
+
+// Plate voltage that lands the beam at `deflection` on the screen:
+//   d = V * L * D / (2 * gap * Va)
+inline float plateVoltageFor(float deflection, float plateZ, float anodeVoltage = ANODE_VOLTAGE) {
+    float D = SCREEN_Z - plateZ;
+    return deflection * 2.0f * PLATE_GAP * anodeVoltage / (PLATE_LEN * D);
+}
+
+} // namespace tube
+
+// Electrode settings for one integration substep
+struct TubeDrive {
+    float anode = tube::ANODE_VOLTAGE;
+    float plateX = 0.0f;   // voltage across the X plates (+ pulls the beam to +x)
+    float plateY = 0.0f;   // voltage across the Y plates (+ pulls the beam to +y)
+    float axialB = 0.0f;   // optional uniform focus-coil field along z
+};
+
+struct ScreenHit {
+    float x, y;
+    float t;               // seconds since the start of the advance() call
+};
+
+class ElectronBeam {
+public:
+    // Electrons per cache block, and blocks per job
+    static const size_t BLOCK = 256;
+    static const size_t CHUNK_BLOCKS = 16;
+    // Substeps a solved field sample is held for
+    static const int FIELD_HOLD = 4;
+
+    std::vector<float> x, y, z, vx, vy, vz;
+    std::vector<float> age;        // seconds since emission, < 0 = not yet emitted
+
+    size_t size() const { return x.size(); }
+
+    // Total charge of the beam for the electron-electron repulsion, in the
+    // same normalised units as the voltages; 0 turns it off
+    void setSpaceCharge(float totalCharge) { charge = std::max(0.0f, totalCharge); }
+    float spaceCharge() const { return charge; }
+
+    // Gun and plate fields from the solved electrode potentials instead of
+    // the piecewise uniform model; the first call to turn it on solves them
+    void setSolvedField(bool on, JobSystem& jobs) {
+        if (on && !field.solved()) solveField(jobs);
+        solvedField = on;
+    }
+    bool solvedFieldOn() const { return solvedField; }
+    const FieldSolver& fieldGrid() const { return field; }
+    const FieldSolveStats& fieldSolveStats() const { return fieldStats; }
+
+    // The tree against the direct sum for the electrons as they are now (the
+    // errors are relative, so this works with space charge off too)
+    SpaceChargeCheck checkSpaceCharge(JobSystem& jobs) {
+        return repulsion.check(x.data(), y.data(), z.data(), age.data(), size(), 1.0f, jobs);
+    }
+
+    // Emission of `count` electrons spread evenly over one flight time, so the
+    // tube fills with a steady beam rather than a single bunch.
+    void reset(size_t count, uint64_t seed) {
+        x.assign(count, 0.0f); y.assign(count, 0.0f); z.assign(count, 0.0f);
+        vx.assign(count, 0.0f); vy.assign(count, 0.0f); vz.assign(count, 0.0f);
+        age.assign(count, 0.0f);
+        qax.clear(); qay.clear(); qaz.clear();
+        rngSeed = seed;
+        frame = 0;
+        float flight = flightTime(tube::ANODE_VOLTAGE);
+        for (size_t b = 0; b < count; b += BLOCK) {
+            Random rng = blockRandom(b);
+            size_t e = std::min(count, b + BLOCK);
+            for (size_t i = b; i < e; ++i) {
+                emit(i, rng);
+                age[i] = -flight * rng.uniform();
+            }
+        }
+    }
+
+    // Advance every electron by `steps` substeps of `dt`; drive[s] holds the
+    // electrode settings for substep s. Electrons reaching the screen are
+    // reported in `hits`, in block order, and re-emitted from the cathode.
+    void advance(const TubeDrive* drive, int steps, float dt, std::vector<ScreenHit>& hits, JobSystem& jobs) {
+        hits.clear();
+        if (steps <= 0 || x.empty()) return;
+        ++frame;
+
+        const size_t n = size();
+        if (solvedField)
+            for (std::vector<float>& g : fieldGrad) g.resize(n);
+        if (charge > 0.0f) {
+            qax.resize(n); qay.resize(n); qaz.resize(n);
+            repulsion.compute(x.data(), y.data(), z.data(), age.data(), n, chargePerElectron(),
+                              qax.data(), qay.data(), qaz.data(), jobs);
+        }
+        const size_t grain = CHUNK_BLOCKS * BLOCK;
+        chunkHits.resize(JobSystem::chunkCount(n, grain));
+        jobs.parallelFor(n, grain, [&](size_t i0, size_t i1) {
+            std::vector<ScreenHit>& h = chunkHits[i0 / grain];
+            h.clear();
+            advanceRange(i0, i1, drive, steps, dt, h);
+        });
+        for (const std::vector<ScreenHit>& h : chunkHits) hits.insert(hits.end(), h.begin(), h.end());
+    }
+
+    static float flightTime(float anodeVoltage) {
+        float v = std::sqrt(2.0f * anodeVoltage);
+        return 2.0f * tube::ANODE_Z0 / v + (tube::SCREEN_Z - tube::ANODE_Z0) / v;
+    }
+
+private:
+    uint64_t rngSeed = 1;
+    uint32_t frame = 0;
+    std::vector<std::vector<ScreenHit>> chunkHits;   // kept between frames
+    float charge = 0.0f;
+    SpaceCharge repulsion;
+    std::vector<float> qax, qay, qaz;   // space-charge acceleration for this frame
+    bool solvedField = false;
+    FieldSolver field;                  // potentials: anode, X plates, Y plates
+    FieldSolveStats fieldStats;
+    std::vector<float> fieldGrad[3 * FieldSolver::POTENTIALS];   // each electron's samples, per potential and axis
+
+    float chargePerElectron() const { return x.empty() ? 0.0f : charge / (float)x.size(); }
+
+    // Stream for the block starting at electron i during the current frame
+    // (frame 0 is the initial emission)
+    Random blockRandom(size_t i) const {
+        return Random(rngSeed, ((uint64_t)frame << 32) | (uint64_t)(i / BLOCK));
+    }
+
+    void emit(size_t i, Random& rng) {
+        float r = tube::CATHODE_RADIUS * std::sqrt(rng.uniform());
+        float a = 6.2831853f * rng.uniform();
+        x[i] = r * std::cos(a);
+        y[i] = r * std::sin(a);
+        z[i] = 0.0f;
+        vx[i] = tube::THERMAL_SPEED * (rng.uniform() - 0.5f);
+        vy[i] = tube::THERMAL_SPEED * (rng.uniform() - 0.5f);
+        vz[i] = tube::THERMAL_SPEED * rng.uniform();
+        age[i] = 0.0f;
+        // the field computed at the screen does not follow it back
+        if (!qax.empty()) { qax[i] = 0.0f; qay[i] = 0.0f; qaz[i] = 0.0f; }
+        if (solvedField && fieldGrad[0].size() == x.size()) sampleField(i);
+    }
+
+    // Potentials for a unit voltage on the anode (the cathode at 0 and
+    // graded rings along the gun up to the anode), across the X plates and
+    // across the Y plates. The edge of the grid past the gun stands for the
+    // tube's conductive coating at the anode potential.
+    void solveField(JobSystem& jobs) {
+        const float h = tube::FIELD_SPACING;
+        const int across = (int)std::lround(2.0f * tube::FIELD_HALF_WIDTH / h) + 1;
+        const int along = (int)std::lround(tube::FIELD_LENGTH / h) + 1;
+        const float skin = 0.5f * h;
+        field.setGrid(-tube::FIELD_HALF_WIDTH, -tube::FIELD_HALF_WIDTH, 0.0f, h, across, across, along,
+                      [skin](float px, float py, float pz, float* v) {
+            v[0] = std::min(pz / tube::ANODE_Z0, 1.0f);
+            v[1] = 0.0f;
+            v[2] = 0.0f;
+            if (pz < skin) return true;   // cathode
+            const float r = std::sqrt(px * px + py * py);
+            if (std::fabs(r - tube::ANODE_RADIUS) < skin && pz > tube::ANODE_Z0 - skin && pz < tube::ANODE_Z1 + skin)
+                return true;
+            const float halfLen = 0.5f * tube::PLATE_LEN + skin;
+            const float halfWidth = 0.5f * tube::PLATE_WIDTH + skin;
+            const float gap = 0.5f * tube::PLATE_GAP;
+            if (std::fabs(std::fabs(px) - gap) < 0.5f * skin && std::fabs(py) < halfWidth &&
+                std::fabs(pz - tube::XPLATE_Z) < halfLen) {
+                v[1] = px > 0.0f ? 0.5f : -0.5f;
+                return true;
+            }
+            if (std::fabs(std::fabs(py) - gap) < 0.5f * skin && std::fabs(px) < halfWidth &&
+                std::fabs(pz - tube::YPLATE_Z) < halfLen) {
+                v[2] = py > 0.0f ? 0.5f : -0.5f;
+                return true;
+            }
+            return false;
+        });
+        fieldStats = field.solve(tube::FIELD_TOLERANCE, jobs);
+    }
+
+    void advanceRange(size_t i0, size_t i1, const TubeDrive* drive, int steps, float dt,
+                      std::vector<ScreenHit>& hits) {
+        float solved[3][BLOCK];
+        for (size_t b = i0; b < i1; b += BLOCK) {
+            size_t e = std::min(i1, b + BLOCK);
+            Random rng = blockRandom(b);
+            for (int s = 0; s < steps; ++s) {
+                if (solvedField) {
+                    if (s % FIELD_HOLD == 0)
+                        for (size_t i = b; i < e; ++i) sampleField(i);
+                    combineField(b, e, drive[s], solved);
+                    pushBlock(b, e, drive[s], dt, solved);
+                } else {
+                    pushBlock(b, e, drive[s], dt, nullptr);
+                }
+                collectHits(b, e, (s + 1) * dt, hits, rng);
+            }
+        }
+    }
+
+    // Gradients of the solved potentials at electron i
+    void sampleField(size_t i) {
+        for (int p = 0; p < FieldSolver::POTENTIALS; ++p) {
+            float g[3] = { 0.0f, 0.0f, 0.0f };
+            if (field.reaches(p, z[i])) field.sample(p, x[i], y[i], z[i], g);
+            fieldGrad[3 * p + 0][i] = g[0];
+            fieldGrad[3 * p + 1][i] = g[1];
+            fieldGrad[3 * p + 2][i] = g[2];
+        }
+    }
+
+    // Solved gun and plate acceleration of electrons [i0, i1) under the
+    // voltages of d, plus their space charge
+    void combineField(size_t i0, size_t i1, const TubeDrive& d, float (*out)[BLOCK]) const {
+        const int n = (int)(i1 - i0);
+        for (int axis = 0; axis < 3; ++axis) {
+            const float* __restrict ga = &fieldGrad[axis][i0];
+            const float* __restrict gx = &fieldGrad[3 + axis][i0];
+            const float* __restrict gy = &fieldGrad[6 + axis][i0];
+            float* __restrict a = out[axis];
+            for (int k = 0; k < n; ++k) a[k] = d.anode * ga[k] + d.plateX * gx[k] + d.plateY * gy[k];
+            if (charge > 0.0f && !qax.empty()) {
+                const float* __restrict q = axis == 0 ? &qax[i0] : axis == 1 ? &qay[i0] : &qaz[i0];
+                for (int k = 0; k < n; ++k) a[k] += q[k];
+            }
+        }
+    }
+
+    // One Boris step for electrons [i0, i1); `solved` holds their sampled
+    // field (combineField) or is null
+    void pushBlock(size_t i0, size_t i1, const TubeDrive& d, float dt, float (*solved)[BLOCK]) {
+        const int n = (int)(i1 - i0);
+        if (solved)
+            borisKernel<true>(&x[i0], &y[i0], &z[i0], &vx[i0], &vy[i0], &vz[i0], &age[i0], solved[0], solved[1],
+                              solved[2], n, d, dt, false);
+        else if (qax.empty() || charge <= 0.0f)
+            borisKernel<false>(&x[i0], &y[i0], &z[i0], &vx[i0], &vy[i0], &vz[i0], &age[i0], nullptr, nullptr, nullptr,
+                               n, d, dt, true);
+        else
+            borisKernel<true>(&x[i0], &y[i0], &z[i0], &vx[i0], &vy[i0], &vz[i0], &age[i0], &qax[i0], &qay[i0], &qaz[i0],
+                              n, d, dt, true);
+    }
+
+    // Fields are piecewise uniform: accelerating gap, linear focusing lens
+    // inside the anode, and the two plate pairs. The regions are applied as
+    // 0/1 masks and the arrays are restrict-qualified so the loop vectorizes
+    // (needs -fno-trapping-math, set in CMakeLists.txt). EXTRA adds a
+    // per-electron acceleration from fa* (space charge, solved field); with
+    // `uniform` false the gun and plate terms are left to it. Without EXTRA
+    // the loop is unchanged.
+    template <bool EXTRA>
+    static void borisKernel(float* __restrict px, float* __restrict py, float* __restrict pz,
+                            float* __restrict pvx, float* __restrict pvy, float* __restrict pvz,
+                            float* __restrict page, const float* __restrict fax, const float* __restrict fay,
+                            const float* __restrict faz, int n, const TubeDrive& d, float dt, bool uniform) {
+        const float gunAccel = uniform ? d.anode / tube::ANODE_Z0 : 0.0f;
+        // thin-lens focus onto the screen: k = v^2 / (2 f)
+        const float focusK = d.anode / (tube::SCREEN_Z - 0.5f * (tube::ANODE_Z0 + tube::ANODE_Z1));
+        const float ax = uniform ? d.plateX / tube::PLATE_GAP : 0.0f;
+        const float ay = uniform ? d.plateY / tube::PLATE_GAP : 0.0f;
+        const float halfLen = 0.5f * tube::PLATE_LEN;
+        const float h = 0.5f * dt;
+
+        // Boris rotation for an axial field, electron charge -1
+        const float tz = -d.axialB * h;
+        const float sz = 2.0f * tz / (1.0f + tz * tz);
+
+        for (int i = 0; i < n; ++i) {
+            float on = page[i] >= 0.0f ? 1.0f : 0.0f;
+            float zi = pz[i];
+
+            float inGun = zi < tube::ANODE_Z0 ? 1.0f : 0.0f;
+            float inLens = (zi >= tube::ANODE_Z0 ? 1.0f : 0.0f) * (zi < tube::ANODE_Z1 ? 1.0f : 0.0f);
+            float inY = std::fabs(zi - tube::YPLATE_Z) < halfLen ? 1.0f : 0.0f;
+            float inX = std::fabs(zi - tube::XPLATE_Z) < halfLen ? 1.0f : 0.0f;
+
+            float eax, eay, eaz;
+            if constexpr (EXTRA) {
+                eax = (inX * ax - inLens * focusK * px[i] + fax[i]) * on;
+                eay = (inY * ay - inLens * focusK * py[i] + fay[i]) * on;
+                eaz = (inGun * gunAccel + faz[i]) * on;
+            } else {
+                eax = (inX * ax - inLens * focusK * px[i]) * on;
+                eay = (inY * ay - inLens * focusK * py[i]) * on;
+                eaz = inGun * gunAccel * on;
+            }
+
+            // half electric kick
+            float ux = pvx[i] + eax * h;
+            float uy = pvy[i] + eay * h;
+            float uz = pvz[i] + eaz * h;
+            // magnetic rotation about z
+            float rx = ux + uy * tz;
+            float ry = uy - ux * tz;
+            ux += ry * sz;
+            uy -= rx * sz;
+            // second half kick
+            ux += eax * h;
+            uy += eay * h;
+            uz += eaz * h;
+
+            pvx[i] = ux;
+            pvy[i] = uy;
+            pvz[i] = uz;
+            px[i] += ux * dt * on;
+            py[i] += uy * dt * on;
+            pz[i] += uz * dt * on;
+            page[i] += dt;
+        }
+    }
+
+    void collectHits(size_t i0, size_t i1, float t, std::vector<ScreenHit>& hits, Random& rng) {
+        for (size_t i = i0; i < i1; ++i) {
+            if (z[i] >= tube::SCREEN_Z) {
+                hits.push_back({ x[i], y[i], t });
+                emit(i, rng);
+            }
+        }
+    }
+};
@@ -0,0 +1,228 @@
+// CRT_FieldSolver.h
+// Electrostatic potentials of the tube electrodes, solved by finite
+// differences on a regular grid.
+//
+// Between the electrodes the potential obeys Laplace's equation. Nodes inside
+// an electrode, and every node on the edge of the grid, are held at a fixed
+// potential; the others relax towards the average of their six neighbours by
+// red-black successive over-relaxation. All neighbours of a node have the
+// other colour, so the nodes of one half sweep are independent: it reads the
+// grid and writes every inner node into a second copy, which is swapped in
+// afterwards. Each row is then a plain loop over contiguous floats that
+// vectorizes. The z-planes are shared out over the job system; no job reads
+// what another writes, so the result is the same on any number of threads.
+//
+// The equation is linear, so the solver keeps one potential per electrode
+// group, each for a unit voltage on that group and 0 on the others. Any set
+// of voltages is a weighted sum of them, so a voltage change needs no new
+// solve and the voltages may change every integration substep. After the
+// solve the gradient of each potential is stored per node and sample()
+// interpolates it trilinearly. Each potential also records the z-span where
+// its gradient is above GRADIENT_FLOOR of its peak; reaches() lets a caller
+// skip the others, since most of the tube only feels one electrode group.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "CRT_Jobs.h"
+
+struct FieldSolveStats {
+    int sweeps = 0;            // most sweeps any potential needed
+    float residual = 0.0f;     // largest change in its last sweep
+    double ms = 0.0;
+};
+
+class FieldSolver {
+public:
+    static const int POTENTIALS = 3;             // electrode groups
+    static const int MAX_SWEEPS = 2000;
+    static constexpr float GRADIENT_FLOOR = 1e-4f;
+    static const size_t PLANE_GRAIN = 4;         // z-planes per job
+
+    // Grid of nx * ny * nz nodes `spacing` apart, node (0, 0, 0) at
+    // (x0, y0, z0). electrode(x, y, z, v) is called for every node: it fills
+    // v[0 .. POTENTIALS) and returns true if the node is held there, or false
+    // if it is free, v being the starting guess. Nodes on the edge of the
+    // grid are held either way.
+    template <typename F>
+    void setGrid(float x0, float y0, float z0, float spacing, int nx, int ny, int nz, F electrode) {
+        ox = x0; oy = y0; oz = z0;
+        h = spacing;
+        invH = 1.0f / spacing;
+        this->nx = std::max(nx, 3); this->ny = std::max(ny, 3); this->nz = std::max(nz, 3);
+        const size_t n = nodeCount();
+        for (std::vector<float>& p : phi) p.assign(n, 0.0f);
+        for (std::vector<float>& w : relax) w.assign(n, 0.0f);
+        for (std::vector<float>& g : grad) g.clear();
+
+        // over-relaxation factor that is optimal for the empty box
+        const float pi = 3.14159265f;
+        const float rho = (std::cos(pi / (this->nx - 1)) + std::cos(pi / (this->ny - 1)) +
+                           std::cos(pi / (this->nz - 1))) / 3.0f;
+        omega = 2.0f / (1.0f + std::sqrt(1.0f - rho * rho));
+
+        float v[POTENTIALS];
+        for (int k = 0; k < this->nz; ++k)
+            for (int j = 0; j < this->ny; ++j)
+                for (int i = 0; i < this->nx; ++i) {
+                    const size_t at = index(i, j, k);
+                    const bool edge = i == 0 || j == 0 || k == 0 ||
+                                      i == this->nx - 1 || j == this->ny - 1 || k == this->nz - 1;
+                    const bool held = electrode(ox + i * h, oy + j * h, oz + k * h, v) || edge;
+                    for (int p = 0; p < POTENTIALS; ++p) phi[p][at] = v[p];
+                    if (!held) relax[(i + j + k) & 1][at] = omega;
+                }
+    }
+
+    // Relax every potential until no node moves by more than `tolerance`
+    // in a sweep, then store the gradients for sample()
+    FieldSolveStats solve(float tolerance, JobSystem& jobs) {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::time_point t0 = Clock::now();
+        FieldSolveStats stats;
+        planeChange.resize(JobSystem::chunkCount(nz - 2, PLANE_GRAIN));
+        for (int p = 0; p < POTENTIALS; ++p) {
+            int sweeps = 0;
+            float change = 0.0f;
+            next = phi[p];   // the sweeps leave the held edge of the grid alone
+            do {
+                change = halfSweep(phi[p], 0, jobs);
+                change = std::max(change, halfSweep(phi[p], 1, jobs));
+                ++sweeps;
+            } while (change > tolerance && sweeps < MAX_SWEEPS);
+            if (sweeps >= stats.sweeps) {
+                stats.sweeps = sweeps;
+                stats.residual = change;
+            }
+        }
+        storeGradients(jobs);
+        stats.ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        return stats;
+    }
+
+    bool solved() const { return !grad[0].empty(); }
+    int sizeX() const { return nx; }
+    int sizeY() const { return ny; }
+    int sizeZ() const { return nz; }
+    float overRelaxation() const { return omega; }
+
+    // Potential p at a node
+    float potential(int p, int i, int j, int k) const { return phi[p][index(i, j, k)]; }
+
+    // Whether potential p has any gradient at height z
+    bool reaches(int p, float z) const { return z >= activeZ[p][0] && z <= activeZ[p][1]; }
+
+    // Gradient of potential p at (x, y, z), trilinearly interpolated; zero
+    // outside the grid
+    void sample(int p, float x, float y, float z, float* g) const {
+        float fx = (x - ox) * invH, fy = (y - oy) * invH, fz = (z - oz) * invH;
+        if (!(fx >= 0.0f && fy >= 0.0f && fz >= 0.0f && fx <= nx - 1 && fy <= ny - 1 && fz <= nz - 1)) {
+            g[0] = 0.0f; g[1] = 0.0f; g[2] = 0.0f;
+            return;
+        }
+        const int i = std::min((int)fx, nx - 2), j = std::min((int)fy, ny - 2), k = std::min((int)fz, nz - 2);
+        fx -= i; fy -= j; fz -= k;
+        const size_t dx = 3, dy = (size_t)3 * nx, dz = (size_t)3 * nx * ny;
+        const float* c = &grad[p][3 * index(i, j, k)];
+        const float w00 = (1.0f - fy) * (1.0f - fz), w10 = fy * (1.0f - fz);
+        const float w01 = (1.0f - fy) * fz, w11 = fy * fz;
+        for (int s = 0; s < 3; ++s) {
+            const float c00 = c[s] + fx * (c[dx + s] - c[s]);
+            const float c10 = c[dy + s] + fx * (c[dy + dx + s] - c[dy + s]);
+            const float c01 = c[dz + s] + fx * (c[dz + dx + s] - c[dz + s]);
+            const float c11 = c[dz + dy + s] + fx * (c[dz + dy + dx + s] - c[dz + dy + s]);
+            g[s] = w00 * c00 + w10 * c10 + w01 * c01 + w11 * c11;
+        }
+    }
+
+private:
+    float ox = 0.0f, oy = 0.0f, oz = 0.0f;
+    float h = 1.0f, invH = 1.0f;
+    int nx = 0, ny = 0, nz = 0;
+    float omega = 1.0f;
+    std::vector<float> phi[POTENTIALS];
+    std::vector<float> relax[2];             // omega at the free nodes of each colour, else 0
+    std::vector<float> grad[POTENTIALS];     // 3 floats per node
+    float activeZ[POTENTIALS][2] = {};       // z-span of each gradient
+    std::vector<float> next;                 // half sweep output, swapped with phi
+    std::vector<float> planeChange;
+
+    size_t nodeCount() const { return (size_t)nx * ny * nz; }
+    size_t index(int i, int j, int k) const { return ((size_t)k * ny + j) * nx + i; }
+
+    // Over-relax the nodes of one colour of `phi`; the largest change
+    float halfSweep(std::vector<float>& phi, int colour, JobSystem& jobs) {
+        const ptrdiff_t sy = nx, sz = (ptrdiff_t)nx * ny;
+        const float* p = phi.data();
+        const float* w = relax[colour].data();
+        float* out = next.data();
+        jobs.parallelFor((size_t)nz - 2, PLANE_GRAIN, [&](size_t k0, size_t k1) {
+            float change = 0.0f;
+            for (size_t k = k0 + 1; k <= k1; ++k) {
+                for (int j = 1; j < ny - 1; ++j) {
+                    const size_t at = index(0, j, (int)k);
+                    relaxRow(p + at, w + at, out + at, nx, sy, sz);
+                    for (int i = 1; i < nx - 1; ++i) change = std::max(change, std::fabs(out[at + i] - p[at + i]));
+                }
+            }
+            planeChange[k0 / PLANE_GRAIN] = change;
+        });
+        phi.swap(next);
+        float change = 0.0f;
+        for (float c : planeChange) change = std::max(change, c);
+        return change;
+    }
+
+    // New values for the inner nodes of one row; w is 0 at the nodes that
+    // are held or of the other colour, so those are copied unchanged
+    static void relaxRow(const float* __restrict p, const float* __restrict w, float* __restrict out, int n,
+                         ptrdiff_t sy, ptrdiff_t sz) {
+        for (int i = 1; i < n - 1; ++i) {
+            const float avg = (p[i - 1] + p[i + 1] + p[i - sy] + p[i + sy] + p[i - sz] + p[i + sz]) * (1.0f / 6.0f);
+            out[i] = p[i] + w[i] * (avg - p[i]);
+        }
+    }
+
+    // Central differences, one-sided on the edge of the grid, and the
+    // z-span of each gradient
+    void storeGradients(JobSystem& jobs) {
+        std::vector<float> planePeak((size_t)POTENTIALS * nz);
+        for (std::vector<float>& g : grad) g.resize(3 * nodeCount());
+        jobs.parallelFor((size_t)nz, PLANE_GRAIN, [&](size_t k0, size_t k1) {
+            for (int k = (int)k0; k < (int)k1; ++k) {
+                const int l0 = std::max(k - 1, 0), l1 = std::min(k + 1, nz - 1);
+                for (int p = 0; p < POTENTIALS; ++p) {
+                    const std::vector<float>& f = phi[p];
+                    float peak = 0.0f;
+                    for (int j = 0; j < ny; ++j) {
+                        const int j0 = std::max(j - 1, 0), j1 = std::min(j + 1, ny - 1);
+                        for (int i = 0; i < nx; ++i) {
+                            const int i0 = std::max(i - 1, 0), i1 = std::min(i + 1, nx - 1);
+                            float* g = &grad[p][3 * index(i, j, k)];
+                            g[0] = (f[index(i1, j, k)] - f[index(i0, j, k)]) * invH / (i1 - i0);
+                            g[1] = (f[index(i, j1, k)] - f[index(i, j0, k)]) * invH / (j1 - j0);
+                            g[2] = (f[index(i, j, l1)] - f[index(i, j, l0)]) * invH / (l1 - l0);
+                            peak = std::max(peak, std::max(std::fabs(g[0]), std::max(std::fabs(g[1]), std::fabs(g[2]))));
+                        }
+                    }
+                    planePeak[(size_t)p * nz + k] = peak;
+                }
+            }
+        });
+        for (int p = 0; p < POTENTIALS; ++p) {
+            const float* peaks = &planePeak[(size_t)p * nz];
+            const float floor = GRADIENT_FLOOR * *std::max_element(peaks, peaks + nz);
+            int lo = 0, hi = nz - 1;
+            while (lo < nz - 1 && peaks[lo] <= floor) ++lo;
+            while (hi > lo && peaks[hi] <= floor) --hi;
+            // a sample interpolates between planes, so widen by one
+            activeZ[p][0] = oz + std::max(lo - 1, 0) * h;
+            activeZ[p][1] = oz + std::min(hi + 1, nz - 1) * h;
+        }
+    }
+};
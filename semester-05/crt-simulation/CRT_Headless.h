@@ -0,0 +1,370 @@
+// CRT_Headless.h
+// Support for running the simulators without a display (--headless N):
+//
+//   SoftCanvas   - small CPU rasterizer (alpha-blended lines, points and
+//                  convex polygons into an RGB8 framebuffer) plus a 4x4
+//                  projection helper for the 3D view
+//   FrameDumper  - writes frames as a PPM sequence or a single Y4M stream
+//   FrameTimings - per-frame timing samples and a min/avg/p99/max summary
+//
+// No GL context is involved, so headless runs work on build machines with
+// neither a display nor a GPU.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// ------------------------------- Rasterizer -----------------------------------
+
+struct SoftColor {
+    float r, g, b, a;
+};
+
+class SoftCanvas {
+public:
+    SoftCanvas(int w = 0, int h = 0) { resize(w, h); }
+
+    void resize(int w, int h) {
+        width = w; height = h;
+        pixels.assign((size_t)w * h * 3, 0);
+        noClip();
+    }
+
+    void clear(float r, float g, float b) {
+        uint8_t c[3] = { toByte(r), toByte(g), toByte(b) };
+        for (size_t i = 0; i < pixels.size(); i += 3) {
+            pixels[i] = c[0]; pixels[i+1] = c[1]; pixels[i+2] = c[2];
+        }
+    }
+
+    // Pixel coordinates have their origin at the bottom left, like GL windows
+    void blend(int x, int y, const SoftColor& c) {
+        if (x < clipX0 || y < clipY0 || x >= clipX1 || y >= clipY1) return;
+        uint8_t* p = &pixels[((size_t)(height - 1 - y) * width + x) * 3];
+        float a = c.a;
+        p[0] = toByte(c.r * a + p[0] * (1.0f / 255.0f) * (1.0f - a));
+        p[1] = toByte(c.g * a + p[1] * (1.0f / 255.0f) * (1.0f - a));
+        p[2] = toByte(c.b * a + p[2] * (1.0f / 255.0f) * (1.0f - a));
+    }
+
+    void point(float x, float y, float size, const SoftColor& c) {
+        if (!nearCanvas(x, y)) return;
+        int half = std::max(0, (int)(size * 0.5f));
+        int cx = (int)std::floor(x), cy = (int)std::floor(y);
+        for (int dy = -half; dy <= half; ++dy)
+            for (int dx = -half; dx <= half; ++dx) blend(cx + dx, cy + dy, c);
+    }
+
+    // DDA line, `width` pixels thick
+    void line(float x0, float y0, float x1, float y1, const SoftColor& c, float widthPx = 1.0f) {
+        if (!nearCanvas(x0, y0) || !nearCanvas(x1, y1)) return;
+        float dx = x1 - x0, dy = y1 - y0;
+        int steps = (int)std::ceil(std::max(std::fabs(dx), std::fabs(dy)));
+        if (steps > 8 * (width + height)) return; // wildly off-screen
+        if (steps == 0) { point(x0, y0, widthPx, c); return; }
+        float sx = dx / steps, sy = dy / steps;
+        bool thick = widthPx > 1.5f;
+        for (int i = 0; i <= steps; ++i) {
+            float x = x0 + sx * i, y = y0 + sy * i;
+            if (thick) point(x, y, widthPx, c);
+            else blend((int)std::floor(x), (int)std::floor(y), c);
+        }
+    }
+
+    // Filled convex polygon (xy pairs), scanline by scanline
+    void convex(const float* xy, int n, const SoftColor& c) {
+        if (n < 3) return;
+        for (int i = 0; i < n; ++i)
+            if (!nearCanvas(xy[2*i], xy[2*i+1])) return;
+        float ymin = xy[1], ymax = xy[1];
+        for (int i = 1; i < n; ++i) { ymin = std::min(ymin, xy[2*i+1]); ymax = std::max(ymax, xy[2*i+1]); }
+        int y0 = std::max(clipY0, (int)std::ceil(ymin - 0.5f));
+        int y1 = std::min(clipY1 - 1, (int)std::floor(ymax - 0.5f));
+        for (int y = y0; y <= y1; ++y) {
+            float sy = y + 0.5f, xl = 1e30f, xr = -1e30f;
+            for (int i = 0; i < n; ++i) {
+                float ax = xy[2*i], ay = xy[2*i+1];
+                float bx = xy[2*((i+1)%n)], by = xy[2*((i+1)%n)+1];
+                if ((ay <= sy && by > sy) || (by <= sy && ay > sy)) {
+                    float x = ax + (sy - ay) * (bx - ax) / (by - ay);
+                    xl = std::min(xl, x); xr = std::max(xr, x);
+                }
+            }
+            for (int x = (int)std::ceil(xl - 0.5f); x <= (int)std::floor(xr - 0.5f); ++x) blend(x, y, c);
+        }
+    }
+
+    // Restrict drawing to a pixel rectangle (like glScissor); reset with noClip()
+    void clip(int x, int y, int w, int h) {
+        clipX0 = std::max(0, x); clipY0 = std::max(0, y);
+        clipX1 = std::min(width, x + w); clipY1 = std::min(height, y + h);
+    }
+    void noClip() { clipX0 = 0; clipY0 = 0; clipX1 = width; clipY1 = height; }
+
+    int width = 0, height = 0;
+    std::vector<uint8_t> pixels; // RGB8, top row first
+
+private:
+    // Within 8 canvas sizes, so the pixel coordinates fit in an int; false
+    // for NaN (replayed or diverging data)
+    bool nearCanvas(float x, float y) const {
+        const float m = 8.0f * (width + height);
+        return x > -m && x < m && y > -m && y < m;
+    }
+
+    static uint8_t toByte(float v) {
+        v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        return (uint8_t)(v * 255.0f + 0.5f);
+    }
+    int clipX0 = 0, clipY0 = 0, clipX1 = 0, clipY1 = 0;
+};
+
+// Trace drawn with the same banded alpha fade as drawTraceHistory(): vertex
+// i maps to (ox + x * sx, oy + y * sy) in canvas pixels. Works on any trace
+// with points[i] = {x, y} and bandStart[bands + 1] (TraceSnapshot).
+template <typename Trace>
+void softTrace(SoftCanvas& c, const Trace& trace, float ox, float oy, float sx, float sy,
+               SoftColor col, int bands, float widthPx = 1.0f) {
+    const auto& p = trace.points;
+    for (int band = 0; band < bands; ++band) {
+        col.a = (float)(band + 1) / bands;
+        size_t first = trace.bandStart[band], last = trace.bandStart[band + 1];
+        if (first == 0) first = 1;
+        for (size_t i = first; i < last; ++i)
+            c.line(ox + p[i-1].x * sx, oy + p[i-1].y * sy, ox + p[i].x * sx, oy + p[i].y * sy, col, widthPx);
+    }
+}
+
+// Spectrum levels (X columns, then Y, each 0..1) over the canvas rectangle
+// at (x, y), w x h pixels, like drawSpectrum() in CRT_Spectrum.h; gridDb and
+// floorDb place the grid lines
+inline void softSpectrum(SoftCanvas& c, const std::vector<float>& levels, float x, float y, float w, float h,
+                         float gridDb, float floorDb) {
+    const int cols = (int)levels.size() / 2;
+    if (cols < 2) return;
+    for (float db = -gridDb; db > floorDb; db -= gridDb) {
+        const float ly = y + h * (1.0f - db / floorDb);
+        c.line(x, ly, x + w, ly, { 0.5f, 0.5f, 0.5f, 0.5f });
+    }
+    const float dx = w / cols;
+    const SoftColor colors[2] = { { 0.2f, 0.6f, 1.0f, 1.0f }, { 1.0f, 0.35f, 0.3f, 1.0f } };
+    for (int ch = 0; ch < 2; ++ch) {
+        const float* lv = &levels[(size_t)ch * cols];
+        for (int k = 1; k < cols; ++k)
+            c.line(x + (k - 0.5f) * dx, y + h * lv[k - 1], x + (k + 0.5f) * dx, y + h * lv[k], colors[ch], 1.5f);
+    }
+}
+
+// Square alpha image (res x res, bottom row first) stretched over the canvas
+// square at (x, y) with side `side` pixels, tinted with col; nearest sampling
+inline void softAlphaImage(SoftCanvas& c, const uint8_t* alpha, int res, float x, float y, float side, SoftColor col) {
+    if (res <= 0) return;
+    int x0 = (int)std::floor(x), y0 = (int)std::floor(y), n = (int)side;
+    for (int py = 0; py < n; ++py) {
+        const uint8_t* row = alpha + (size_t)(py * res / n) * res;
+        for (int px = 0; px < n; ++px) {
+            uint8_t a = row[px * res / n];
+            if (!a) continue;
+            col.a = a * (1.0f / 255.0f);
+            c.blend(x0 + px, y0 + py, col);
+        }
+    }
+}
+
+// Column-major 4x4 matrix with the gluPerspective / gluLookAt conventions
+struct SoftMat4 {
+    float m[16];
+
+    static SoftMat4 identity() {
+        SoftMat4 r; std::memset(r.m, 0, sizeof(r.m));
+        r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+        return r;
+    }
+
+    static SoftMat4 perspective(float fovyDeg, float aspect, float zNear, float zFar) {
+        SoftMat4 r; std::memset(r.m, 0, sizeof(r.m));
+        float f = 1.0f / std::tan(fovyDeg * 3.14159265f / 360.0f);
+        r.m[0] = f / aspect;
+        r.m[5] = f;
+        r.m[10] = (zFar + zNear) / (zNear - zFar);
+        r.m[11] = -1.0f;
+        r.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+        return r;
+    }
+
+    static SoftMat4 lookAt(float ex, float ey, float ez, float cx, float cy, float cz,
+                           float ux, float uy, float uz) {
+        float fx = cx - ex, fy = cy - ey, fz = cz - ez;
+        float fl = std::sqrt(fx*fx + fy*fy + fz*fz); fx /= fl; fy /= fl; fz /= fl;
+        float sx = fy*uz - fz*uy, sy = fz*ux - fx*uz, sz = fx*uy - fy*ux;
+        float sl = std::sqrt(sx*sx + sy*sy + sz*sz); sx /= sl; sy /= sl; sz /= sl;
+        float vx = sy*fz - sz*fy, vy = sz*fx - sx*fz, vz = sx*fy - sy*fx;
+        SoftMat4 r = identity();
+        r.m[0] = sx; r.m[4] = sy; r.m[8] = sz;
+        r.m[1] = vx; r.m[5] = vy; r.m[9] = vz;
+        r.m[2] = -fx; r.m[6] = -fy; r.m[10] = -fz;
+        r.m[12] = -(sx*ex + sy*ey + sz*ez);
+        r.m[13] = -(vx*ex + vy*ey + vz*ez);
+        r.m[14] = fx*ex + fy*ey + fz*ez;
+        return r;
+    }
+
+    SoftMat4 operator*(const SoftMat4& b) const {
+        SoftMat4 r;
+        for (int c = 0; c < 4; ++c)
+            for (int row = 0; row < 4; ++row) {
+                float s = 0.0f;
+                for (int k = 0; k < 4; ++k) s += m[k*4 + row] * b.m[c*4 + k];
+                r.m[c*4 + row] = s;
+            }
+        return r;
+    }
+
+    // World point -> window pixel; false if behind the eye
+    bool project(float x, float y, float z, int w, int h, float& px, float& py) const {
+        float cx = m[0]*x + m[4]*y + m[8]*z + m[12];
+        float cy = m[1]*x + m[5]*y + m[9]*z + m[13];
+        float cw = m[3]*x + m[7]*y + m[11]*z + m[15];
+        if (cw <= 1e-4f) return false;
+        px = (cx / cw * 0.5f + 0.5f) * w;
+        py = (cy / cw * 0.5f + 0.5f) * h;
+        return true;
+    }
+};
+
+// ------------------------------- Frame Output ---------------------------------
+
+// `path` ending in .y4m -> one YUV4MPEG2 (4:4:4) stream.
+// `path` containing a frame number (frame_%05d.ppm) -> one PPM per frame.
+// Any other path -> a single PPM, overwritten by every frame (last one wins).
+// The number is %d with an optional zero flag and width, at most once; %%
+// is a literal %. open() fails on any other conversion.
+class FrameDumper {
+public:
+    ~FrameDumper() { close(); }
+
+    bool open(const std::string& path, int w, int h, int fps) {
+        width = w; height = h;
+        if (path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0) {
+            y4m = std::fopen(path.c_str(), "wb");
+            if (!y4m) return false;
+            std::fprintf(y4m, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", w, h, fps);
+            return true;
+        }
+        return splitPattern(path);
+    }
+
+    bool write(const SoftCanvas& c, int frame) {
+        if (y4m) return writeY4M(c);
+        std::string name = prefix;
+        if (numbered) {
+            const std::string number = std::to_string(frame);
+            if ((int)number.size() < padWidth) name.append(padWidth - number.size(), zeroPad ? '0' : ' ');
+            name += number + suffix;
+        }
+        FILE* f = std::fopen(name.c_str(), "wb");
+        if (!f) return false;
+        std::fprintf(f, "P6\n%d %d\n255\n", c.width, c.height);
+        bool ok = std::fwrite(c.pixels.data(), 1, c.pixels.size(), f) == c.pixels.size();
+        return std::fclose(f) == 0 && ok;
+    }
+
+    // Flush and close the Y4M stream; false if any of it failed to reach the
+    // file. The per-frame PPMs are closed by write().
+    bool close() {
+        if (!y4m) return true;
+        const bool ok = std::fclose(y4m) == 0;
+        y4m = nullptr;
+        return ok;
+    }
+
+private:
+    // The text before and after the frame number, with %% unescaped
+    bool splitPattern(const std::string& path) {
+        prefix.clear(); suffix.clear();
+        numbered = zeroPad = false;
+        padWidth = 0;
+        std::string* out = &prefix;
+        for (size_t i = 0; i < path.size(); ++i) {
+            if (path[i] != '%') { *out += path[i]; continue; }
+            if (++i < path.size() && path[i] == '%') { *out += '%'; continue; }
+            if (numbered) return false;
+            if (i < path.size() && path[i] == '0') { zeroPad = true; ++i; }
+            for (; i < path.size() && path[i] >= '0' && path[i] <= '9'; ++i) {
+                padWidth = padWidth * 10 + (path[i] - '0');
+                if (padWidth > MAX_PAD) return false;
+            }
+            if (i >= path.size() || path[i] != 'd') return false;
+            numbered = true;
+            out = &suffix;
+        }
+        return true;
+    }
+
+    bool writeY4M(const SoftCanvas& c) {
+        size_t n = (size_t)c.width * c.height;
+        planes.resize(3 * n);
+        uint8_t* Y = planes.data();
+        uint8_t* U = Y + n;
+        uint8_t* V = U + n;
+        const uint8_t* p = c.pixels.data();
+        // BT.601 studio range
+        for (size_t i = 0; i < n; ++i, p += 3) {
+            int r = p[0], g = p[1], b = p[2];
+            Y[i] = (uint8_t)((66*r + 129*g + 25*b + 128) / 256 + 16);
+            U[i] = (uint8_t)((-38*r - 74*g + 112*b + 128) / 256 + 128);
+            V[i] = (uint8_t)((112*r - 94*g - 18*b + 128) / 256 + 128);
+        }
+        if (std::fputs("FRAME\n", y4m) == EOF) return false;
+        return std::fwrite(planes.data(), 1, planes.size(), y4m) == planes.size();
+    }
+
+    static const int MAX_PAD = 32;
+    std::string prefix, suffix;
+    bool numbered = false, zeroPad = false;
+    int padWidth = 0;
+    int width = 0, height = 0;
+    FILE* y4m = nullptr;
+    std::vector<uint8_t> planes;
+};
+
+// ------------------------------- Timing ---------------------------------------
+
+class FrameTimings {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    void add(double ms) { samples.push_back(ms); }
+    size_t count() const { return samples.size(); }
+
+    double average() const {
+        double sum = 0.0;
+        for (double v : samples) sum += v;
+        return samples.empty() ? 0.0 : sum / samples.size();
+    }
+
+    static double msSince(Clock::time_point t0) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    }
+
+    void print(const char* label) const {
+        if (samples.empty()) return;
+        std::vector<double> s = samples;
+        std::sort(s.begin(), s.end());
+        double sum = 0.0;
+        for (double v : s) sum += v;
+        size_t p99 = std::min(s.size() - 1, (size_t)std::ceil(s.size() * 0.99) - 1);
+        std::printf("%-10s frames %6zu  min %8.3f  avg %8.3f  p99 %8.3f  max %8.3f ms\n",
+                    label, s.size(), s.front(), sum / s.size(), s[p99], s.back());
+    }
+
+private:
+    std::vector<double> samples;
+};
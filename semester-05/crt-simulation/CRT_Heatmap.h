@@ -0,0 +1,115 @@
+// CRT_Heatmap.h
+// Impact heatmap for the CRT_3D HUD: a 2D histogram of where the beam lands,
+// accumulated over the whole run.
+//
+// The screen rectangle is cut into a fixed res x res grid of 64-bit counters,
+// so memory stays the same however long the run and however many hits come
+// in. add() is a relaxed atomic increment, which lets the parallel sample
+// and electron loops bin their own hits without locks; counts only ever add
+// up, so the result does not depend on the order the threads got there.
+//
+// colorize() turns the counts into a log-scaled RGB image for display, and
+// write() saves the raw counts:
+//
+//   offset  size              field
+//   0       8                 "CRTHEAT1"
+//   8       4 + 4             uint32 width, height (bins)
+//   16      4 x 4             float x0, y0, x1, y1 (screen rectangle)
+//   32      8                 uint64 total hits
+//   40      8 x width x height  uint64 counts, bottom row first
+//
+// All values are in the byte order of the machine that wrote them
+// (little-endian on x86 and ARM).
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+class ImpactHeatmap {
+public:
+    // Map the rectangle [x0, x1] x [y0, y1] onto res x res empty bins
+    void reset(int res, float x0, float y0, float x1, float y1) {
+        size = res;
+        wx0 = x0; wy0 = y0; wx1 = x1; wy1 = y1;
+        kx = res / (x1 - x0);
+        ky = res / (y1 - y0);
+        bins.reset(new std::atomic<uint64_t>[(size_t)res * res]);
+        clear();
+    }
+
+    void clear() {
+        for (size_t i = 0; i < cells(); ++i) bins[i].store(0, std::memory_order_relaxed);
+    }
+
+    // Count one hit at (x, y); hits outside the rectangle are dropped. Safe
+    // to call from several threads at once.
+    void add(float x, float y) {
+        float gx = (x - wx0) * kx, gy = (y - wy0) * ky;
+        if (!(gx >= 0.0f && gy >= 0.0f && gx < size && gy < size)) return;   // also drops NaN
+        bins[(size_t)gy * size + (size_t)gx].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int resolution() const { return size; }
+    size_t cells() const { return (size_t)size * size; }
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < cells(); ++i) sum += bins[i].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // RGB image of the counts, bottom row first: log(1 + count) scaled by
+    // the busiest bin and run through a dark-to-bright palette
+    void colorize(std::vector<uint8_t>& rgb) const {
+        const size_t n = cells();
+        rgb.resize(3 * n);
+        uint64_t peak = 0;
+        for (size_t i = 0; i < n; ++i) peak = std::max(peak, bins[i].load(std::memory_order_relaxed));
+        const float scale = peak > 0 ? 1.0f / std::log1p((float)peak) : 0.0f;
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t c = bins[i].load(std::memory_order_relaxed);
+            palette(c ? std::log1p((float)c) * scale : 0.0f, &rgb[3 * i]);
+        }
+    }
+
+    bool write(const char* path) const {
+        FILE* f = std::fopen(path, "wb");
+        if (!f) return false;
+        const uint32_t dims[2] = { (uint32_t)size, (uint32_t)size };
+        const float rect[4] = { wx0, wy0, wx1, wy1 };
+        const uint64_t hits = total();
+        bool ok = std::fwrite("CRTHEAT1", 1, 8, f) == 8 &&
+                  std::fwrite(dims, sizeof(dims), 1, f) == 1 &&
+                  std::fwrite(rect, sizeof(rect), 1, f) == 1 &&
+                  std::fwrite(&hits, sizeof(hits), 1, f) == 1;
+        std::vector<uint64_t> row(size);
+        for (int j = 0; ok && j < size; ++j) {
+            for (int i = 0; i < size; ++i) row[i] = bins[(size_t)j * size + i].load(std::memory_order_relaxed);
+            ok = std::fwrite(row.data(), sizeof(uint64_t), size, f) == (size_t)size;
+        }
+        return std::fclose(f) == 0 && ok;
+    }
+
+private:
+    // Black -> purple -> red -> orange -> pale yellow, for v in [0, 1]
+    static void palette(float v, uint8_t* out) {
+        static const float STOPS[5][3] = {
+            { 0, 0, 4 }, { 87, 16, 110 }, { 188, 55, 84 }, { 249, 142, 9 }, { 252, 255, 164 }
+        };
+        float x = std::min(std::max(v, 0.0f), 1.0f) * 4.0f;
+        int k = std::min(3, (int)x);
+        float f = x - k;
+        for (int c = 0; c < 3; ++c)
+            out[c] = (uint8_t)(STOPS[k][c] + (STOPS[k + 1][c] - STOPS[k][c]) * f + 0.5f);
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> bins;
+    int size = 0;
+    float wx0 = 0.0f, wy0 = 0.0f, wx1 = 1.0f, wy1 = 1.0f, kx = 1.0f, ky = 1.0f;
+};
@@ -0,0 +1,177 @@
+// CRT_Jobs.h
+// Work-stealing thread pool shared by CRT_2D, CRT_3D and the electron beam.
+//
+// parallelFor() cuts an index range into fixed-size chunks and deals them
+// out to one queue per thread, in contiguous runs so each thread starts on
+// neighbouring memory. A thread works through its own queue from the front
+// and, when it runs dry, steals from the back of another, so an uneven split
+// still finishes together. The calling thread takes part and returns once
+// every chunk is done.
+//
+// Chunk boundaries depend only on the range and the grain, never on the
+// thread count, so per-chunk results gathered in chunk order are the same on
+// any machine. parallelPack() builds on that for the filter-and-pack loops
+// that fill vertex arrays.
+//
+// Only one thread may submit work at a time, and jobs must not submit jobs.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem {
+public:
+    JobSystem() {}
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem() { stop(); }
+
+    // Start `threads` threads in total, counting the caller; 0 uses every core
+    void start(unsigned threads = 0) {
+        stop();
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        queues.clear();
+        for (unsigned q = 0; q < threads; ++q) queues.emplace_back(new Queue);
+        quit = false;
+        for (unsigned w = 1; w < threads; ++w) workers.emplace_back([this, w]() { workerLoop(w); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers) t.join();
+        workers.clear();
+    }
+
+    unsigned threadCount() const { return (unsigned)workers.size() + 1; }
+
+    static size_t chunkCount(size_t n, size_t grain) {
+        grain = std::max<size_t>(1, grain);
+        return (n + grain - 1) / grain;
+    }
+
+    // fn(begin, end) for consecutive chunks of `grain` indices covering [0, n)
+    template <typename F>
+    void parallelFor(size_t n, size_t grain, F&& fn) {
+        grain = std::max<size_t>(1, grain);
+        const size_t chunks = chunkCount(n, grain);
+        if (chunks == 0) return;
+        if (chunks == 1 || workers.empty()) {
+            for (size_t b = 0; b < n; b += grain) fn(b, std::min(n, b + grain));
+            return;
+        }
+
+        Batch batch;
+        batch.n = n;
+        batch.grain = grain;
+        batch.ctx = &fn;
+        batch.call = [](void* ctx, size_t b, size_t e) { (*static_cast<F*>(ctx))(b, e); };
+        batch.remaining = chunks;
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued += chunks;   // counted first so it never runs below the queues
+        }
+        const size_t Q = queues.size();
+        for (size_t q = 0; q < Q; ++q) {
+            std::lock_guard<std::mutex> lock(queues[q]->m);
+            for (size_t c = chunks * q / Q; c < chunks * (q + 1) / Q; ++c) queues[q]->tasks.push_back({ &batch, c });
+        }
+        wake.notify_all();
+
+        // the caller works as thread 0 until its batch is finished
+        while (batch.remaining.load(std::memory_order_acquire) > 0) {
+            Task t;
+            if (takeTask(0, t)) run(t);
+            else std::this_thread::yield();
+        }
+    }
+
+    // Filter-and-pack in parallel: fn(begin, end, out) writes the floats for
+    // items [begin, end) to out (at most `stride` per item) and returns how
+    // many it wrote. The chunks are then closed up in order, so `out` ends up
+    // exactly as a serial loop would leave it. Returns the number of floats.
+    template <typename F>
+    size_t parallelPack(size_t n, size_t grain, float* out, size_t stride, F&& fn) {
+        grain = std::max<size_t>(1, grain);
+        packCounts.resize(chunkCount(n, grain));
+        parallelFor(n, grain, [&](size_t b, size_t e) { packCounts[b / grain] = fn(b, e, out + b * stride); });
+        size_t k = 0;
+        for (size_t c = 0; c < packCounts.size(); ++c) {
+            const float* from = out + c * grain * stride;
+            if (from != out + k) std::memmove(out + k, from, packCounts[c] * sizeof(float));
+            k += packCounts[c];
+        }
+        return k;
+    }
+
+private:
+    struct Batch {
+        void (*call)(void*, size_t, size_t);
+        void* ctx;
+        size_t n, grain;
+        std::atomic<size_t> remaining;
+    };
+
+    struct Task {
+        Batch* batch;
+        size_t chunk;
+    };
+
+    struct Queue {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    // Own queue from the front, otherwise steal from the back of the others
+    bool takeTask(size_t self, Task& t) {
+        const size_t Q = queues.size();
+        for (size_t i = 0; i < Q; ++i) {
+            Queue& q = *queues[(self + i) % Q];
+            std::lock_guard<std::mutex> lock(q.m);
+            if (q.tasks.empty()) continue;
+            if (i == 0) { t = q.tasks.front(); q.tasks.pop_front(); }
+            else { t = q.tasks.back(); q.tasks.pop_back(); }
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    static void run(const Task& t) {
+        Batch& b = *t.batch;
+        size_t begin = t.chunk * b.grain;
+        b.call(b.ctx, begin, std::min(b.n, begin + b.grain));
+        b.remaining.fetch_sub(1, std::memory_order_release);
+    }
+
+    void workerLoop(size_t self) {
+        while (true) {
+            Task t;
+            if (takeTask(self, t)) { run(t); continue; }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return quit || queued.load(std::memory_order_relaxed) > 0; });
+            if (quit) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued{0};
+    bool quit = false;
+    std::vector<size_t> packCounts;
+};
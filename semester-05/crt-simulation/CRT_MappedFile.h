@@ -0,0 +1,49 @@
+// CRT_MappedFile.h
+// Read-only memory mapping of a whole file, shared by the raster picture
+// reader (CRT_Raster.h) and the replay of recorded runs (CRT_Recorder.h).
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) { ::close(fd); return false; }
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);   // the mapping keeps the file alive
+        if (p == MAP_FAILED) return false;
+        madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+        bytes = (const uint8_t*)p;
+        length = (size_t)st.st_size;
+        return true;
+    }
+
+    void close() {
+        if (bytes) munmap((void*)bytes, length);
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+};
@@ -0,0 +1,176 @@
+// CRT_Phosphor.h
+// Phosphor screen model shared by CRT_2D and CRT_3D.
+//
+// The screen is a square grid of float intensities. The beam deposits energy
+// into it (sweep() for the scripted beam, hit() for single electrons) and
+// every cell decays exponentially with the persistence time constant, so the
+// afterglow no longer depends on how many trace samples are kept or how often
+// the beam is sampled. decay() is one branch-free pass over the grid that
+// also refreshes the 8-bit image. PhosphorTexture shows a copy of that image
+// on the render thread as one textured quad, so the cost of showing the
+// screen depends only on its resolution.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <GL/glut.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+class PhosphorScreen {
+public:
+    // Intensity deposited per second the beam dwells on one cell; the image
+    // saturates at an intensity of 1
+    static constexpr float BEAM_CURRENT = 200.0f;
+
+    // Map the world rectangle [x0, x1] x [y0, y1] onto a res x res grid and
+    // clear it
+    void reset(int res, float x0, float y0, float x1, float y1) {
+        size = res;
+        wx0 = x0; wy0 = y0;
+        kx = res / (x1 - x0);
+        ky = res / (y1 - y0);
+        intensity.assign((size_t)res * res, 0.0f);
+        pixels.assign((size_t)res * res, 0);
+        penDown = false;
+    }
+
+    void clear() {
+        std::fill(intensity.begin(), intensity.end(), 0.0f);
+        std::fill(pixels.begin(), pixels.end(), 0);
+        penDown = false;
+    }
+
+    // Time for the glow to fall to 1/e, in seconds
+    void setPersistence(float seconds) { persistence = std::max(1e-3f, seconds); }
+    float getPersistence() const { return persistence; }
+
+    // The beam moved from its last position to (x, y) over dt seconds. Its
+    // energy is spread evenly along the segment, so a fast sweep leaves a
+    // dimmer line than a slow one whatever the sample rate.
+    void sweep(float x, float y, float dt) {
+        float gx = (x - wx0) * kx, gy = (y - wy0) * ky;
+        if (!penDown) { penX = gx; penY = gy; penDown = true; }
+        float dx = gx - penX, dy = gy - penY;
+        int n = std::max(1, (int)std::ceil(std::max(std::fabs(dx), std::fabs(dy))));
+        if (n > 4 * size) n = 4 * size;   // beam jumped across the screen
+        float e = BEAM_CURRENT * dt / n;
+        for (int i = 1; i <= n; ++i) splat(penX + dx * i / n, penY + dy * i / n, e);
+        penX = gx; penY = gy;
+    }
+
+    // Beam blanked: the next sweep() starts a new line
+    void lift() { penDown = false; }
+
+    // A single electron landing at (x, y)
+    void hit(float x, float y, float energy) {
+        splat((x - wx0) * kx, (y - wy0) * ky, energy);
+    }
+
+    // Fade every cell by exp(-dt / persistence) and refresh the 8-bit image
+    void decay(float dt) {
+        const float k = std::exp(-dt / persistence);
+        const size_t n = intensity.size();
+        float* I = intensity.data();
+        uint8_t* out = pixels.data();
+        for (size_t i = 0; i < n; ++i) {
+            float v = I[i] * k;
+            v = v < 1e-4f ? 0.0f : v;   // keep dark cells out of denormals
+            I[i] = v;
+            out[i] = (uint8_t)(std::min(v, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+
+    // Number of cells covered by a w x h world rectangle
+    float cellsCovered(float w, float h) const { return w * kx * h * ky; }
+
+    int resolution() const { return size; }
+    const uint8_t* image() const { return pixels.data(); }   // bottom row first
+
+private:
+    // Bilinear deposit at grid position (gx, gy); cell centres sit at +0.5
+    void splat(float gx, float gy, float e) {
+        float u = gx - 0.5f, v = gy - 0.5f;
+        int i = (int)std::floor(u), j = (int)std::floor(v);
+        float fu = u - i, fv = v - j;
+        add(i,     j,     e * (1 - fu) * (1 - fv));
+        add(i + 1, j,     e * fu * (1 - fv));
+        add(i,     j + 1, e * (1 - fu) * fv);
+        add(i + 1, j + 1, e * fu * fv);
+    }
+
+    void add(int i, int j, float e) {
+        if (i < 0 || j < 0 || i >= size || j >= size) return;
+        intensity[(size_t)j * size + i] += e;
+    }
+
+    std::vector<float> intensity;
+    std::vector<uint8_t> pixels;
+    int size = 0;
+    float wx0 = 0.0f, wy0 = 0.0f, kx = 1.0f, ky = 1.0f;
+    float persistence = 1.5f;
+    float penX = 0.0f, penY = 0.0f;
+    bool penDown = false;
+};
+
+// A phosphor image (PhosphorScreen::image() or a copy of it) as a GL
+// texture, or with channels = 3 any square RGB image. Needs a current GL
+// context.
+class PhosphorTexture {
+public:
+    explicit PhosphorTexture(int channels = 1) : format(channels == 3 ? GL_RGB : GL_ALPHA) {}
+
+    // Textured quad over [x0, x1] x [y0, y1] in the current matrices, glowing
+    // in (r, g, b); [u0, u1] x [v0, v1] picks part of the image. The image is
+    // uploaded only when `version` differs from the last upload.
+    void draw(const uint8_t* image, int size, uint64_t version,
+              float x0, float y0, float x1, float y1, float r, float g, float b,
+              float u0 = 0.0f, float v0 = 0.0f, float u1 = 1.0f, float v1 = 1.0f) {
+        if (size == 0) return;
+        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT | GL_CURRENT_BIT);
+        if (!texture) {
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (textureSize != size) {
+            glTexImage2D(GL_TEXTURE_2D, 0, format == GL_RGB ? GL_RGB8 : GL_ALPHA8, size, size, 0, format, GL_UNSIGNED_BYTE, nullptr);
+            textureSize = size;
+            uploaded = false;
+        }
+        if (!uploaded || version != uploadedVersion) {
+            glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, format, GL_UNSIGNED_BYTE, image);
+            glPopClientAttrib();
+            uploaded = true;
+            uploadedVersion = version;
+        }
+
+        glEnable(GL_TEXTURE_2D);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glColor3f(r, g, b);
+        glBegin(GL_QUADS);
+            glTexCoord2f(u0, v0); glVertex2f(x0, y0);
+            glTexCoord2f(u1, v0); glVertex2f(x1, y0);
+            glTexCoord2f(u1, v1); glVertex2f(x1, y1);
+            glTexCoord2f(u0, v1); glVertex2f(x0, y1);
+        glEnd();
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPopAttrib();
+    }
+
+private:
+    GLenum format;
+    GLuint texture = 0;
+    int textureSize = 0;
+    bool uploaded = false;
+    uint64_t uploadedVersion = 0;
+};
@@ -0,0 +1,120 @@
+// CRT_PointSprites.h
+// Particle renderer for CRT_3D: x,y,z points streamed into a vertex buffer
+// and drawn as round, size-attenuated point sprites.
+//
+// The caller hands over points that are already packed (only live particles,
+// culled on the CPU), so one glBufferData + glDrawArrays covers the whole
+// set. The buffer is orphaned on every upload so the driver never waits for
+// the previous frame, and nothing is uploaded again while the version stays
+// the same. Sprite size falls off with eye distance the way the rest of the
+// perspective scene does: size = pixels * refDistance / distance.
+//
+// Without vertex buffers (GL < 1.5) the points are drawn from client memory,
+// and without point sprites (GL < 2.0) as plain square points.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <GL/glut.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+
+class PointSprites {
+public:
+    static const int SPRITE_RES = 32;   // sprite texture size
+
+    // Needs a current GL context
+    void initGL() {
+        const char* version = (const char*)glGetString(GL_VERSION);
+        int major = 0, minor = 0;
+        if (version) std::sscanf(version, "%d.%d", &major, &minor);
+        buffers = major > 1 || (major == 1 && minor >= 5);
+        sprites = major >= 2;
+        if (buffers) glGenBuffers(1, &vbo);
+        if (sprites) buildSpriteTexture();
+    }
+
+    // Draw n x,y,z points `pixels` wide at refDistance from the eye, tinted
+    // (r, g, b, a). The points are uploaded only when `version` changes.
+    void draw(const float* xyz, size_t n, uint64_t version, float pixels, float refDistance,
+              float r, float g, float b, float a) {
+        if (n == 0) return;
+        glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT |
+                     GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT);
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+        const float* base = xyz;
+        if (buffers) {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            if (!uploaded || version != uploadedVersion || n != uploadedCount) {
+                const GLsizeiptr bytes = (GLsizeiptr)(n * 3 * sizeof(float));
+                glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);   // orphan
+                glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, xyz);
+                uploaded = true;
+                uploadedVersion = version;
+                uploadedCount = n;
+            }
+            base = nullptr;
+        }
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);   // translucent: test against the tube, don't occlude each other
+        glColor4f(r, g, b, a);
+        if (sprites) {
+            const GLfloat attenuation[3] = { 0.0f, 0.0f, 1.0f };
+            glPointParameterfv(GL_POINT_DISTANCE_ATTENUATION, attenuation);
+            glPointParameterf(GL_POINT_SIZE_MIN, 1.0f);
+            glPointParameterf(GL_POINT_SIZE_MAX, 64.0f);
+            glPointSize(pixels * refDistance);
+            glEnable(GL_POINT_SPRITE);
+            glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE);
+            glEnable(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, spriteTexture);
+            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        } else {
+            glPointSize(pixels);
+        }
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, base);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)n);
+
+        if (buffers) glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (sprites) glBindTexture(GL_TEXTURE_2D, 0);
+        glPopClientAttrib();
+        glPopAttrib();
+    }
+
+private:
+    // Round dot with a soft edge, in the alpha channel
+    void buildSpriteTexture() {
+        unsigned char alpha[SPRITE_RES * SPRITE_RES];
+        for (int j = 0; j < SPRITE_RES; ++j) {
+            for (int i = 0; i < SPRITE_RES; ++i) {
+                float dx = (i + 0.5f) / SPRITE_RES * 2.0f - 1.0f;
+                float dy = (j + 0.5f) / SPRITE_RES * 2.0f - 1.0f;
+                float d = std::sqrt(dx * dx + dy * dy);
+                float v = d < 0.6f ? 1.0f : (d < 1.0f ? (1.0f - d) / 0.4f : 0.0f);
+                alpha[j * SPRITE_RES + i] = (unsigned char)(v * 255.0f + 0.5f);
+            }
+        }
+        glGenTextures(1, &spriteTexture);
+        glBindTexture(GL_TEXTURE_2D, spriteTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA8, SPRITE_RES, SPRITE_RES, 0, GL_ALPHA, GL_UNSIGNED_BYTE, alpha);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    bool buffers = false, sprites = false;
+    GLuint vbo = 0, spriteTexture = 0;
+    bool uploaded = false;
+    uint64_t uploadedVersion = 0;
+    size_t uploadedCount = 0;
+};
@@ -0,0 +1,250 @@
+// CRT_Profiler.h
+// Per-phase frame profiler shared by CRT_2D and CRT_3D.
+//
+// Each display phase is wrapped in a ProfileScope, which records CPU time
+// and, where the driver supports timer queries (GL 3.3 or ARB_timer_query),
+// GPU time. GPU results are read back GL_LAG frames later so the pipeline
+// never stalls. Samples go into per-phase RingBuffers; min/avg/p99 over the
+// rolling window are shown by drawOverlay() and written by writeCsv().
+//
+// GL query entry points need GL_GLEXT_PROTOTYPES defined before the first
+// GL header is included.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <GL/glut.h>
+#include <GL/glext.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CRT_RingBuffer.h"
+
+class FrameProfiler {
+public:
+    static const size_t WINDOW = 240;       // rolling window, in frames
+    static const int GL_LAG = 4;            // frames before a GPU result is read
+    static const int STATS_REFRESH = 30;    // frames between overlay updates
+
+    struct Stats {
+        float min = 0.0f, avg = 0.0f, p99 = 0.0f;
+        bool valid = false;
+    };
+
+    // Register a phase before the first frame; returns its id
+    int addPhase(const char* name) {
+        Phase p;
+        p.name = name;
+        p.cpu.reset(WINDOW);
+        p.gpu.reset(WINDOW);
+        phases.push_back(p);
+        return (int)phases.size() - 1;
+    }
+
+    // Needs a current GL context. Without one (headless runs) only CPU time
+    // is recorded.
+    void initGL() {
+        const char* version = (const char*)glGetString(GL_VERSION);
+        const char* ext = (const char*)glGetString(GL_EXTENSIONS);
+        int major = 0, minor = 0;
+        if (version) std::sscanf(version, "%d.%d", &major, &minor);
+        gpuTimers = major > 3 || (major == 3 && minor >= 3) ||
+                    (ext && (std::strstr(ext, "GL_ARB_timer_query") || std::strstr(ext, "GL_EXT_timer_query")));
+        if (!gpuTimers) return;
+        for (Phase& p : phases) {
+            glGenQueries(GL_LAG, p.queries);
+            std::fill(p.pending, p.pending + GL_LAG, false);
+        }
+    }
+
+    bool hasGpuTimers() const { return gpuTimers; }
+
+    void beginFrame() {
+        frameStart = Clock::now();
+        if (gpuTimers) collectGpu(frame % GL_LAG);
+    }
+
+    void endFrame() {
+        frameCpu.push(msSince(frameStart));
+        ++frame;
+        if (frame % STATS_REFRESH == 0) refreshStats();
+    }
+
+    void begin(int id) {
+        Phase& p = phases[id];
+        p.start = Clock::now();
+        if (gpuTimers) {
+            int slot = frame % GL_LAG;
+            glBeginQuery(GL_TIME_ELAPSED, p.queries[slot]);
+            p.pending[slot] = true;
+        }
+    }
+
+    void end(int id) {
+        Phase& p = phases[id];
+        if (gpuTimers) glEndQuery(GL_TIME_ELAPSED);
+        p.cpu.push(msSince(p.start));
+    }
+
+    // CPU time of a phase measured elsewhere (on another thread), counted
+    // for the current frame
+    void record(int id, float cpuMs) { phases[id].cpu.push(cpuMs); }
+
+    // Rolling-window statistics; cached, refreshed every STATS_REFRESH frames
+    const Stats& cpuStats(int id) const { return phases[id].cpuStats; }
+    const Stats& gpuStats(int id) const { return phases[id].gpuStats; }
+    const Stats& frameStats() const { return frameCpuStats; }
+
+    // One row per phase plus the whole frame, statistics over the current window
+    bool writeCsv(const char* path) {
+        refreshStats();
+        FILE* f = std::fopen(path, "w");
+        if (!f) return false;
+        std::fprintf(f, "phase,samples,cpu_min_ms,cpu_avg_ms,cpu_p99_ms,gpu_min_ms,gpu_avg_ms,gpu_p99_ms\n");
+        for (const Phase& p : phases) {
+            std::fprintf(f, "%s,%zu,%.4f,%.4f,%.4f,", p.name.c_str(), p.cpu.size(),
+                         p.cpuStats.min, p.cpuStats.avg, p.cpuStats.p99);
+            if (p.gpuStats.valid) std::fprintf(f, "%.4f,%.4f,%.4f\n", p.gpuStats.min, p.gpuStats.avg, p.gpuStats.p99);
+            else std::fprintf(f, ",,\n");
+        }
+        std::fprintf(f, "frame,%zu,%.4f,%.4f,%.4f,,,\n", frameCpu.size(),
+                     frameCpuStats.min, frameCpuStats.avg, frameCpuStats.p99);
+        return std::fclose(f) == 0;
+    }
+
+    // Text table in the top left corner of a w x h window; sets up and
+    // restores its own pixel projection
+    void drawOverlay(int w, int h) const {
+        const int lineH = 14;
+        const int rows = (int)phases.size() + 3;
+        const float boxW = 360.0f, boxH = (float)(rows * lineH + 8);
+        const float x0 = 10.0f, y1 = (float)h - 10.0f;
+
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix(); glLoadIdentity();
+        gluOrtho2D(0, w, 0, h);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix(); glLoadIdentity();
+
+        glColor4f(0.0f, 0.0f, 0.0f, 0.65f);
+        glBegin(GL_QUADS);
+            glVertex2f(x0, y1 - boxH); glVertex2f(x0 + boxW, y1 - boxH);
+            glVertex2f(x0 + boxW, y1); glVertex2f(x0, y1);
+        glEnd();
+
+        char line[128];
+        float y = y1 - lineH;
+        glColor3f(1.0f, 1.0f, 0.6f);
+        std::snprintf(line, sizeof(line), "%-10s %20s %20s", "ms", "cpu min/avg/p99",
+                      gpuTimers ? "gpu min/avg/p99" : "gpu n/a");
+        drawText(x0 + 6, y, line);
+        glColor3f(1.0f, 1.0f, 1.0f);
+        for (const Phase& p : phases) {
+            y -= lineH;
+            formatRow(line, sizeof(line), p.name.c_str(), p.cpuStats, p.gpuStats);
+            drawText(x0 + 6, y, line);
+        }
+        y -= lineH;
+        glColor3f(0.6f, 1.0f, 0.6f);
+        formatRow(line, sizeof(line), "frame", frameCpuStats, Stats());
+        drawText(x0 + 6, y, line);
+
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopAttrib();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Phase {
+        std::string name;
+        RingBuffer<float> cpu, gpu;
+        Stats cpuStats, gpuStats;
+        Clock::time_point start;
+        GLuint queries[GL_LAG] = {};
+        bool pending[GL_LAG] = {};
+    };
+
+    static float msSince(Clock::time_point t0) {
+        return std::chrono::duration<float, std::milli>(Clock::now() - t0).count();
+    }
+
+    // Read the queries issued GL_LAG frames ago into the GPU windows. A
+    // result that is still not available is dropped rather than waited for.
+    void collectGpu(int slot) {
+        for (Phase& p : phases) {
+            if (!p.pending[slot]) continue;
+            p.pending[slot] = false;
+            GLint ready = 0;
+            glGetQueryObjectiv(p.queries[slot], GL_QUERY_RESULT_AVAILABLE, &ready);
+            if (!ready) continue;
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(p.queries[slot], GL_QUERY_RESULT, &ns);
+            p.gpu.push((float)(ns * 1e-6));
+        }
+    }
+
+    Stats summarize(const RingBuffer<float>& window) {
+        Stats s;
+        size_t n = window.size();
+        if (n == 0) return s;
+        scratch.resize(n);
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) { scratch[i] = window[i]; sum += scratch[i]; }
+        size_t k = std::min(n - 1, (n * 99 + 99) / 100 - 1);
+        std::nth_element(scratch.begin(), scratch.begin() + k, scratch.end());
+        s.p99 = scratch[k];
+        s.min = *std::min_element(scratch.begin(), scratch.end());
+        s.avg = (float)(sum / n);
+        s.valid = true;
+        return s;
+    }
+
+    void refreshStats() {
+        for (Phase& p : phases) {
+            p.cpuStats = summarize(p.cpu);
+            p.gpuStats = summarize(p.gpu);
+        }
+        frameCpuStats = summarize(frameCpu);
+    }
+
+    static void formatRow(char* out, size_t size, const char* name, const Stats& cpu, const Stats& gpu) {
+        char g[32] = "-";
+        if (gpu.valid) std::snprintf(g, sizeof(g), "%.2f/%.2f/%.2f", gpu.min, gpu.avg, gpu.p99);
+        std::snprintf(out, size, "%-10s %7.2f/%5.2f/%5.2f %20s", name, cpu.min, cpu.avg, cpu.p99, g);
+    }
+
+    static void drawText(float x, float y, const char* s) {
+        glRasterPos2f(x, y);
+        for (; *s; ++s) glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *s);
+    }
+
+    std::vector<Phase> phases;
+    std::vector<float> scratch;
+    RingBuffer<float> frameCpu{WINDOW};
+    Stats frameCpuStats;
+    Clock::time_point frameStart;
+    unsigned frame = 0;
+    bool gpuTimers = false;
+};
+
+// Times the enclosing block as one phase. Phases must not nest: GL allows a
+// single active GL_TIME_ELAPSED query.
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& p, int id) : prof(p), phase(id) { prof.begin(phase); }
+    ~ProfileScope() { prof.end(phase); }
+
+private:
+    FrameProfiler& prof;
+    int phase;
+};
@@ -0,0 +1,60 @@
+// CRT_Random.h
+// Random number generator shared by CRT_2D, CRT_3D and the electron beam.
+//
+// Random is a xoshiro128+ generator: four 32-bit words of state, a handful of
+// shifts and xors per number, and no hidden global state, so every thread or
+// every block of particles can own one. Generators are seeded from a
+// (seed, stream) pair through splitmix64; different streams from the same
+// seed are independent, which lets a parallel update draw one stream per
+// block and give the same result from --seed whatever the thread count.
+// fillUniform() produces a whole array of numbers in one call.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Random {
+public:
+    explicit Random(uint64_t seed = 1, uint64_t stream = 0) { reseed(seed, stream); }
+
+    void reseed(uint64_t seed, uint64_t stream = 0) {
+        uint64_t z = splitmix(seed) ^ splitmix(stream + 0x632BE59BD9B4E019ull);
+        uint64_t a = splitmix(z), b = splitmix(z + 0x9E3779B97F4A7C15ull);
+        s[0] = (uint32_t)a; s[1] = (uint32_t)(a >> 32);
+        s[2] = (uint32_t)b; s[3] = (uint32_t)(b >> 32);
+        if ((s[0] | s[1] | s[2] | s[3]) == 0) s[0] = 1;   // all-zero state is a fixed point
+    }
+
+    uint32_t next() {
+        const uint32_t result = s[0] + s[3];
+        const uint32_t t = s[1] << 9;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 11) | (s[3] >> 21);
+        return result;
+    }
+
+    // Uniform in [0, 1) from the top 24 bits (the low bits of xoshiro+ are weak)
+    float uniform() { return (next() >> 8) * (1.0f / 16777216.0f); }
+    float uniform(float a, float b) { return a + (b - a) * uniform(); }
+
+    // out[k] uniform in [a, b), for k < n
+    void fillUniform(float* out, size_t n, float a = 0.0f, float b = 1.0f) {
+        const float scale = (b - a) * (1.0f / 16777216.0f);
+        for (size_t k = 0; k < n; ++k) out[k] = a + (next() >> 8) * scale;
+    }
+
+private:
+    static uint64_t splitmix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    uint32_t s[4];
+};
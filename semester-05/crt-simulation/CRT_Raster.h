@@ -0,0 +1,220 @@
+// CRT_Raster.h
+// Raster-scan TV mode shared by CRT_2D and CRT_3D (--raster LINES).
+//
+// The beam sweeps a full frame line by line, with horizontal retrace at the
+// end of every line and vertical retrace after the last visible line, and is
+// blanked during both. While it is visible, its intensity follows the
+// luminance of the current picture:
+//
+//   ImageSequence - a PPM image (P5 / P6) or a Y4M stream, mapped into memory
+//                   with mmap and read in place; Y4M frames loop. Without a
+//                   file a built-in test pattern is shown.
+//   RasterScan    - 480-line (525 total, 30 Hz) or 576-line (625 total,
+//                   25 Hz) progressive timing; evaluate() produces deflection
+//                   and intensity for a block of evenly spaced samples.
+//
+// At real line rates this needs around 10 million beam samples per second,
+// which makes it the stress benchmark for the sampler and the phosphor.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "CRT_MappedFile.h"
+
+// Luminance frames read in place from a mapped PPM / Y4M file
+class ImageSequence {
+public:
+    int width = 0, height = 0;
+
+    // PPM (P5 grey or P6 RGB, 8-bit) or Y4M; returns false if the file
+    // cannot be mapped or parsed
+    bool open(const char* path) {
+        frames.clear();
+        if (!file.open(path)) return false;
+        const uint8_t* d = file.data();
+        size_t n = file.size();
+        if (n > 2 && d[0] == 'P' && (d[1] == '5' || d[1] == '6')) return parsePPM(d, n);
+        if (n > 9 && std::memcmp(d, "YUV4MPEG2", 9) == 0) return parseY4M(d, n);
+        std::fprintf(stderr, "%s: not a PPM or Y4M file\n", path);
+        return false;
+    }
+
+    // Built-in picture: grey bars over a gradient with a centred circle
+    void testPattern(int w, int h) {
+        file.close();
+        frames.clear();
+        width = w; height = h; channels = 1;
+        pattern.resize((size_t)w * h);
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                float fx = (x + 0.5f) / w, fy = (y + 0.5f) / h;
+                float v = y < h / 2 ? (float)(7 - (int)(fx * 8)) / 7.0f : fx;
+                float dx = (fx - 0.5f) * w / h, dy = fy - 0.5f;
+                float r = std::sqrt(dx * dx + dy * dy);
+                if (std::fabs(r - 0.35f) < 0.012f) v = 1.0f;
+                if (x % std::max(w / 8, 1) == 0 || y % std::max(h / 6, 1) == 0) v = 0.5f;
+                pattern[(size_t)y * w + x] = (uint8_t)(v * 255.0f);
+            }
+        }
+        frames.push_back(pattern.data());
+    }
+
+    size_t frameCount() const { return frames.size(); }
+
+    // Luminance at (x, y) of frame f, 0..255; rows top to bottom
+    int luma(size_t f, int x, int y) const {
+        const uint8_t* p = frames[f] + ((size_t)y * width + x) * channels;
+        if (channels == 1) return p[0];
+        return (p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8;
+    }
+
+private:
+    static const char* skipSpace(const char* s, const char* end) {
+        while (s < end) {
+            if (*s == '#') { while (s < end && *s != '\n') ++s; }
+            else if (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') ++s;
+            else break;
+        }
+        return s;
+    }
+
+    bool parsePPM(const uint8_t* d, size_t n) {
+        const char* s = (const char*)d + 2;
+        const char* end = (const char*)d + n;
+        int values[3];
+        for (int& v : values) {
+            s = skipSpace(s, end);
+            char* after = nullptr;
+            v = (int)std::strtol(s, &after, 10);
+            if (after == s) return false;
+            s = after;
+        }
+        if (values[2] != 255 || s >= end) return false;
+        ++s;   // single whitespace before the raster
+        width = values[0]; height = values[1];
+        if (width <= 0 || height <= 0) return false;
+        channels = d[1] == '6' ? 3 : 1;
+        if ((size_t)(end - s) < (size_t)width * height * channels) return false;
+        frames.push_back((const uint8_t*)s);
+        return true;
+    }
+
+    // Y plane of every frame; chroma is skipped
+    bool parseY4M(const uint8_t* d, size_t n) {
+        const uint8_t* nl = (const uint8_t*)std::memchr(d, '\n', n);
+        if (!nl) return false;
+        std::string header((const char*)d, nl - d);
+        const char* w = std::strstr(header.c_str(), " W");
+        const char* h = std::strstr(header.c_str(), " H");
+        if (!w || !h) return false;
+        width = std::atoi(w + 2); height = std::atoi(h + 2);
+        if (width <= 0 || height <= 0) return false;
+        channels = 1;
+        size_t luma = (size_t)width * height, chroma = luma / 2;   // 4:2:0 by default
+        const char* c = std::strstr(header.c_str(), " C");
+        if (c && std::strncmp(c + 2, "444", 3) == 0) chroma = 2 * luma;
+        else if (c && std::strncmp(c + 2, "422", 3) == 0) chroma = luma;
+        else if (c && std::strncmp(c + 2, "mono", 4) == 0) chroma = 0;
+
+        size_t pos = nl - d + 1;
+        while (pos + 5 <= n && std::memcmp(d + pos, "FRAME", 5) == 0) {
+            const uint8_t* fnl = (const uint8_t*)std::memchr(d + pos, '\n', n - pos);
+            if (!fnl) break;
+            size_t start = fnl - d + 1;
+            if (start + luma + chroma > n) break;
+            frames.push_back(d + start);
+            pos = start + luma + chroma;
+        }
+        return !frames.empty();
+    }
+
+    MappedFile file;
+    std::vector<const uint8_t*> frames;
+    std::vector<uint8_t> pattern;
+    int channels = 1;
+};
+
+class RasterScan {
+public:
+    static constexpr float H_ACTIVE = 0.83f;   // visible share of each line
+
+    // 576 visible lines selects 625-line / 25 Hz timing, anything else the
+    // 525-line / 30 Hz timing scaled to the requested line count
+    void configure(int lines) {
+        visibleLines = lines > 0 ? lines : 480;
+        if (visibleLines == 576) { totalLines = 625; frameHz = 25.0; }
+        // at least one blanked line, so the vertical flyback has time
+        else { totalLines = std::max(visibleLines * 525 / 480, visibleLines + 1); frameHz = 30.0; }
+        lineTime = 1.0 / (frameHz * totalLines);
+    }
+
+    bool enabled() const { return visibleLines > 0; }
+    int lines() const { return visibleLines; }
+    double frameTime() const { return 1.0 / frameHz; }
+
+    // Share of all samples that land with the beam on
+    float activeFraction() const { return H_ACTIVE * visibleLines / totalLines; }
+
+    // Deflection (+-1, y up) at time t, for the beam tip and the particles
+    void valueAt(double t, float& x, float& y) const {
+        float z;
+        evaluate(t, 0.0, 1, &x, &y, &z);
+    }
+
+    // Deflection and beam intensity (0..1) for n samples from t0, dt apart
+    void evaluate(double t0, double dt, size_t n, float* xs, float* ys, float* zs) const {
+        const double frameT = 1.0 / frameHz;
+        const double activeT = lineTime * H_ACTIVE;
+        const double visibleT = lineTime * visibleLines;
+        const size_t frameCount = image.frameCount();
+        for (size_t k = 0; k < n; ++k) {
+            double t = t0 + k * dt;
+            double frames = std::floor(t / frameT);
+            double ft = t - frames * frameT;
+            int line = (int)(ft / lineTime);
+            double lt = ft - line * lineTime;
+
+            // horizontal: trace left to right, then fly back
+            bool hOn = lt < activeT;
+            float x = hOn ? (float)(-1.0 + 2.0 * lt / activeT)
+                          : (float)(1.0 - 2.0 * (lt - activeT) / (lineTime - activeT));
+            // vertical: top to bottom over the visible lines, then fly back
+            bool vOn = line < visibleLines;
+            float y = vOn ? (float)(1.0 - 2.0 * ft / visibleT)
+                          : (float)(-1.0 + 2.0 * (ft - visibleT) / (frameT - visibleT));
+            xs[k] = x;
+            ys[k] = y;
+
+            float z = 0.0f;
+            if (hOn && vOn && frameCount) {
+                size_t f = (size_t)frames % frameCount;
+                int px = (int)((x + 1.0f) * 0.5f * image.width);
+                int py = line * image.height / visibleLines;
+                if (px >= image.width) px = image.width - 1;
+                z = image.luma(f, px, py) * (1.0f / 255.0f);
+            }
+            zs[k] = z;
+        }
+    }
+
+    // Phosphor energy per sample so that a steady picture settles at its own
+    // luminance: `cells` is the number of phosphor cells the picture covers
+    float hitEnergy(float cells, double sampleHz, float persistence) const {
+        return (float)(cells / (sampleHz * persistence * activeFraction()));
+    }
+
+    ImageSequence image;
+
+private:
+    int visibleLines = 0, totalLines = 0;
+    double frameHz = 30.0;
+    double lineTime = 1.0;
+};
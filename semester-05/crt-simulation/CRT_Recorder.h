@@ -0,0 +1,290 @@
+// CRT_Recorder.h
+// Recording and replay of simulation runs, shared by CRT_2D and CRT_3D
+// (--record FILE, --replay FILE).
+//
+// A run is stored as one record per tick, each a fixed list of byte fields
+// that the caller defines (the snapshot the renderer draws). Every
+// keyInterval-th tick is a key tick with its fields stored whole. The others
+// are deltas: each field is XORed with the same field of the tick before and
+// the result stored as runs of unchanged (zero) bytes and literal bytes, so
+// the slowly fading phosphor and the idle parts of the state cost almost
+// nothing.
+//
+//   header   "CRTREC01", uint32 keyInterval, uint32 fieldCount,
+//            uint32 infoBytes, info (the caller's run description)
+//   tick     uint32 record bytes, then per field: uint8 mode (0 whole,
+//            1 delta), uvarint length, payload
+//   index    uint64 offset of every tick, uint64 tick count,
+//            uint64 index offset, "CRTIDX01"
+//
+// StateReplay maps the file with mmap. Finding a tick is one index lookup,
+// and decoding it takes at most keyInterval records from the key tick before
+// it, so seeking costs the same anywhere in the file. A file whose index is
+// missing (the recorder did not close) is indexed by scanning it once.
+// Numbers are stored in the byte order of the machine that wrote them.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "CRT_MappedFile.h"
+
+namespace recording {
+
+static const char MAGIC[8] = { 'C', 'R', 'T', 'R', 'E', 'C', '0', '1' };
+static const char INDEX_MAGIC[8] = { 'C', 'R', 'T', 'I', 'D', 'X', '0', '1' };
+static const uint8_t MODE_WHOLE = 0, MODE_DELTA = 1;
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+} // namespace recording
+
+class StateRecorder {
+public:
+    StateRecorder() {}
+    StateRecorder(const StateRecorder&) = delete;
+    StateRecorder& operator=(const StateRecorder&) = delete;
+    ~StateRecorder() { close(); }
+
+    // Start a file for ticks of `fields` fields each; `info` is stored in
+    // the header for the replay to read back
+    bool open(const char* path, uint32_t fields, const void* info, uint32_t infoBytes, uint32_t keyInterval = 60) {
+        close();
+        file = std::fopen(path, "wb");
+        if (!file) return false;
+        std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        fieldCount = fields;
+        keyEvery = keyInterval > 0 ? keyInterval : 1;
+        const uint32_t head[3] = { keyEvery, fieldCount, infoBytes };
+        ok = std::fwrite(recording::MAGIC, 8, 1, file) == 1 &&
+             std::fwrite(head, sizeof(head), 1, file) == 1 &&
+             (infoBytes == 0 || std::fwrite(info, infoBytes, 1, file) == 1);
+        written = 8 + sizeof(head) + infoBytes;
+        previous.assign(fieldCount, std::vector<uint8_t>());
+        offsets.clear();
+        return ok;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+    uint64_t ticks() const { return offsets.size(); }
+
+    // One tick: beginTick(), then field() once per field in the same order
+    // every tick, then endTick()
+    void beginTick() {
+        record.clear();
+        current = 0;
+        key = offsets.size() % keyEvery == 0;
+    }
+
+    void field(const void* data, size_t bytes) {
+        if (current >= fieldCount) return;
+        const uint8_t* src = (const uint8_t*)data;
+        std::vector<uint8_t>& prev = previous[current++];
+        if (key || prev.size() != bytes) {
+            record.push_back(recording::MODE_WHOLE);
+            recording::putVarint(record, bytes);
+            record.insert(record.end(), src, src + bytes);
+        } else {
+            record.push_back(recording::MODE_DELTA);
+            recording::putVarint(record, bytes);
+            encodeDelta(src, prev.data(), bytes);
+        }
+        prev.assign(src, src + bytes);
+    }
+
+    bool endTick() {
+        if (!file || !ok) return false;
+        while (current < fieldCount) field(nullptr, 0);
+        const uint32_t bytes = (uint32_t)record.size();
+        offsets.push_back(written);
+        ok = std::fwrite(&bytes, sizeof(bytes), 1, file) == 1 &&
+             std::fwrite(record.data(), 1, record.size(), file) == record.size();
+        written += sizeof(bytes) + record.size();
+        return ok;
+    }
+
+    // Write the index and close; false if anything failed to write
+    bool close() {
+        if (!file) return true;
+        const uint64_t indexAt = written, count = offsets.size();
+        ok = ok && (offsets.empty() || std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size()) &&
+             std::fwrite(&count, sizeof(count), 1, file) == 1 &&
+             std::fwrite(&indexAt, sizeof(indexAt), 1, file) == 1 &&
+             std::fwrite(recording::INDEX_MAGIC, 8, 1, file) == 1;
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    // Runs of (unchanged bytes, changed bytes XOR previous)
+    void encodeDelta(const uint8_t* cur, const uint8_t* prev, size_t n) {
+        size_t i = 0;
+        while (i < n) {
+            size_t same = i;
+            while (same < n && cur[same] == prev[same]) ++same;
+            size_t diff = same;
+            // a literal run ends at the next stretch of 8 unchanged bytes
+            size_t quiet = 0;
+            while (diff < n && quiet < 8) {
+                quiet = cur[diff] == prev[diff] ? quiet + 1 : 0;
+                ++diff;
+            }
+            if (quiet == 8) diff -= 8;
+            recording::putVarint(record, same - i);
+            recording::putVarint(record, diff - same);
+            for (size_t k = same; k < diff; ++k) record.push_back(cur[k] ^ prev[k]);
+            i = diff;
+        }
+    }
+
+    FILE* file = nullptr;
+    bool ok = false;
+    uint32_t fieldCount = 0, keyEvery = 60;
+    uint64_t written = 0;
+    std::vector<uint64_t> offsets;
+    std::vector<std::vector<uint8_t>> previous;
+    std::vector<uint8_t> record;
+    uint32_t current = 0;
+    bool key = true;
+};
+
+class StateReplay {
+public:
+    bool open(const char* path) {
+        ticksIndex.clear();
+        decoded = -1;
+        if (!file.open(path)) return false;
+        const uint8_t* p = file.data();
+        const size_t n = file.size();
+        uint32_t head[3];
+        if (n < 8 + sizeof(head) || std::memcmp(p, recording::MAGIC, 8) != 0) return false;
+        std::memcpy(head, p + 8, sizeof(head));
+        keyEvery = head[0] > 0 ? head[0] : 1;
+        fieldCount = head[1];
+        infoBytes = head[2];
+        infoAt = 8 + sizeof(head);
+        // every field takes at least a byte per tick
+        if (infoAt + infoBytes > n || fieldCount > n) return false;
+        fields.assign(fieldCount, std::vector<uint8_t>());
+        return readIndex() || scanIndex();
+    }
+
+    size_t ticks() const { return ticksIndex.size(); }
+    uint32_t fieldsPerTick() const { return fieldCount; }
+    const uint8_t* info() const { return file.data() + infoAt; }
+    uint32_t infoSize() const { return infoBytes; }
+
+    // Decode tick t into field(); only the records since the nearest key
+    // tick (or since the tick decoded last, if that is closer) are read
+    bool seek(size_t t) {
+        if (t >= ticksIndex.size()) return false;
+        if ((long long)t == decoded) return true;
+        size_t from = t - t % keyEvery;
+        if (decoded >= (long long)from && decoded < (long long)t) from = (size_t)decoded + 1;
+        for (size_t i = from; i <= t; ++i) {
+            if (!decodeTick(i)) { decoded = -1; return false; }
+            decoded = (long long)i;
+        }
+        return true;
+    }
+
+    const std::vector<uint8_t>& field(size_t i) const { return fields[i]; }
+
+private:
+    bool readIndex() {
+        const uint8_t* p = file.data();
+        const size_t n = file.size();
+        uint64_t count, indexAt;
+        if (n < infoAt + infoBytes + 24 || std::memcmp(p + n - 8, recording::INDEX_MAGIC, 8) != 0) return false;
+        std::memcpy(&count, p + n - 24, 8);
+        std::memcpy(&indexAt, p + n - 16, 8);
+        if (indexAt < infoAt + infoBytes || indexAt > n - 24 || count != (n - 24 - indexAt) / 8) return false;
+        ticksIndex.resize((size_t)count);
+        if (count) std::memcpy(ticksIndex.data(), p + indexAt, (size_t)count * 8);
+        dataEnd = (size_t)indexAt;
+        return true;
+    }
+
+    // No index: walk the records, stopping at the first incomplete one
+    bool scanIndex() {
+        ticksIndex.clear();
+        const size_t n = file.size();
+        size_t at = infoAt + infoBytes;
+        while (at + 4 <= n) {
+            uint32_t bytes;
+            std::memcpy(&bytes, file.data() + at, 4);
+            if (at + 4 + bytes > n) break;
+            ticksIndex.push_back(at);
+            at += 4 + bytes;
+        }
+        dataEnd = at;
+        return true;
+    }
+
+    bool decodeTick(size_t t) {
+        // the index may be damaged: compare without forming an offset past
+        // the data
+        const uint64_t at = ticksIndex[t];
+        uint32_t bytes;
+        if (at < infoAt + infoBytes || at > dataEnd || dataEnd - at < 4) return false;
+        std::memcpy(&bytes, file.data() + at, 4);
+        if (bytes > dataEnd - at - 4) return false;
+        const uint8_t* p = file.data() + at + 4;
+        const uint8_t* end = p + bytes;
+
+        for (uint32_t f = 0; f < fieldCount; ++f) {
+            if (p >= end) return false;
+            uint8_t mode = *p++;
+            uint64_t len;
+            if (!recording::getVarint(p, end, len)) return false;
+            std::vector<uint8_t>& out = fields[f];
+            if (mode == recording::MODE_WHOLE) {
+                if (len > (uint64_t)(end - p)) return false;
+                out.assign(p, p + len);
+                p += len;
+            } else if (mode == recording::MODE_DELTA) {
+                if (out.size() != len) return false;
+                size_t i = 0;
+                while (i < len) {
+                    uint64_t same, diff;
+                    if (!recording::getVarint(p, end, same) || !recording::getVarint(p, end, diff)) return false;
+                    if (same > len - i || diff > len - i - same || diff > (uint64_t)(end - p)) return false;
+                    if (same == 0 && diff == 0) return false;
+                    i += same;
+                    for (uint64_t k = 0; k < diff; ++k) out[i++] ^= *p++;
+                }
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    MappedFile file;
+    std::vector<uint64_t> ticksIndex;
+    std::vector<std::vector<uint8_t>> fields;
+    uint32_t keyEvery = 1, fieldCount = 0, infoBytes = 0;
+    size_t infoAt = 0, dataEnd = 0;
+    long long decoded = -1;
+};
@@ -0,0 +1,72 @@
+// CRT_RingBuffer.h
+// Fixed-capacity ring buffer used for the beam trace history.
+//
+// push() is O(1): once the buffer is full the oldest sample is overwritten
+// instead of shifting the whole history. The stored samples (oldest first)
+// are always at most two contiguous runs of memory, so they can be handed to
+// glDrawArrays without copying.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 0) { reset(capacity); }
+
+    // Reallocate for a new capacity and drop all samples
+    void reset(size_t capacity) {
+        buf.assign(capacity, T());
+        head = 0;
+        count = 0;
+    }
+
+    void clear() { head = 0; count = 0; }
+
+    void push(const T& v) {
+        if (buf.empty()) return;
+        buf[head] = v;
+        if (++head == buf.size()) head = 0;
+        if (count < buf.size()) ++count;
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return buf.size(); }
+    bool empty() const { return count == 0; }
+
+    // i-th sample, oldest first
+    const T& operator[](size_t i) const {
+        size_t idx = start() + i;
+        if (idx >= buf.size()) idx -= buf.size();
+        return buf[idx];
+    }
+
+    const T& newest() const { return (*this)[count - 1]; }
+
+    // Calls fn(ptr, n) for the contiguous runs covering samples [first, last),
+    // oldest first. A range that wraps past the end of storage yields two runs.
+    template <typename Fn>
+    void forEachRun(size_t first, size_t last, Fn fn) const {
+        if (last > count) last = count;
+        if (first >= last) return;
+        size_t a = start() + first;
+        if (a >= buf.size()) a -= buf.size();
+        size_t n = last - first;
+        size_t run = buf.size() - a;
+        if (n <= run) {
+            fn(&buf[a], n);
+        } else {
+            fn(&buf[a], run);
+            fn(&buf[0], n - run);
+        }
+    }
+
+private:
+    size_t start() const { return count < buf.size() ? 0 : head; }
+
+    std::vector<T> buf;
+    size_t head = 0;   // next write position
+    size_t count = 0;
+};
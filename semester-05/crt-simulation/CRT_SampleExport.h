@@ -0,0 +1,183 @@
+// CRT_SampleExport.h
+// Streaming export of every beam sample (--export FILE), shared by CRT_2D
+// and CRT_3D, for checking the deflection offline.
+//
+// The simulation thread appends samples to a block and hands full blocks
+// (and the partly filled one at the end of each frame) to a writer thread.
+// While the writer turns one block into file bytes the simulation fills the
+// next, and the lock between them only guards the handoff, never the I/O,
+// so a slow disk cannot stall the simulation. If the writer falls
+// MAX_BLOCKS blocks behind, new samples are dropped and counted instead.
+//
+// A path ending in .csv gets one "t,x,y,z,stage" line per sample. Anything
+// else is raw binary, which is the one that keeps up at MHz sample rates:
+//
+//   offset  size  field
+//   0       8     "CRTSMP01"
+//   8       4     uint32 bytes per sample (24)
+//   12      24n   samples: double t (s), float x, y, z, uint32 stage
+//
+// Numbers are stored in the byte order of the machine that wrote them.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct BeamSample {
+    double t;           // signal time, seconds
+    float x, y, z;      // beam position in the simulator's world units
+    uint32_t stage;     // BeamStage
+};
+
+class SampleExporter {
+public:
+    static const size_t BLOCK = 1 << 16;    // samples per block
+    static const size_t MAX_BLOCKS = 16;    // blocks in flight before dropping
+
+    SampleExporter() {}
+    SampleExporter(const SampleExporter&) = delete;
+    SampleExporter& operator=(const SampleExporter&) = delete;
+    ~SampleExporter() { close(); }
+
+    bool open(const char* path) {
+        close();
+        const size_t len = std::strlen(path);
+        csv = len >= 4 && std::strcmp(path + len - 4, ".csv") == 0;
+        file = std::fopen(path, "wb");
+        if (!file) return false;
+        if (csv) {
+            ok = std::fputs("t,x,y,z,stage\n", file) >= 0;
+        } else {
+            const uint32_t bytes = sizeof(BeamSample);
+            ok = std::fwrite("CRTSMP01", 1, 8, file) == 8 && std::fwrite(&bytes, sizeof(bytes), 1, file) == 1;
+        }
+        stopping = false;
+        written = dropped = 0;
+        writer = std::thread([this]() { writeLoop(); });
+        return ok;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    // Simulation thread only
+    void add(double t, float x, float y, float z, int stage) {
+        if (!fill && !(fill = takeBlock())) { ++dropped; return; }
+        fill->samples[fill->count++] = { t, x, y, z, (uint32_t)stage };
+        if (fill->count == BLOCK) submit();
+    }
+
+    // Hand the partly filled block to the writer; call once per frame so the
+    // file follows the run closely
+    void flush() {
+        if (fill && fill->count) submit();
+    }
+
+    // Write everything still queued and close; false if any write failed
+    bool close() {
+        if (!file) return true;
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        full.clear();
+        spare.clear();
+        blocks.clear();
+        return ok;
+    }
+
+    uint64_t samplesWritten() const { return written; }
+    uint64_t samplesDropped() const { return dropped; }
+
+private:
+    struct Block {
+        BeamSample samples[BLOCK];
+        size_t count = 0;
+    };
+
+    Block* takeBlock() {
+        std::lock_guard<std::mutex> lock(m);
+        if (!spare.empty()) {
+            Block* b = spare.back();
+            spare.pop_back();
+            return b;
+        }
+        if (blocks.size() == MAX_BLOCKS) return nullptr;
+        blocks.emplace_back(new Block());
+        return blocks.back().get();
+    }
+
+    void submit() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            full.push_back(fill);
+        }
+        fill = nullptr;
+        wake.notify_one();
+    }
+
+    void writeLoop() {
+        std::unique_lock<std::mutex> lock(m);
+        for (;;) {
+            wake.wait(lock, [this]() { return !full.empty() || stopping; });
+            if (full.empty()) return;
+            Block* b = full.front();
+            full.pop_front();
+            lock.unlock();
+
+            const bool done = csv ? writeCsv(*b) : std::fwrite(b->samples, sizeof(BeamSample), b->count, file) == b->count;
+            ok = ok && done;
+            written += b->count;
+            b->count = 0;
+
+            lock.lock();
+            spare.push_back(b);
+        }
+    }
+
+    bool writeCsv(const Block& b) {
+        text.resize(b.count * 96);
+        char* p = text.data();
+        char* const end = p + text.size();
+        for (size_t i = 0; i < b.count; ++i) {
+            const BeamSample& s = b.samples[i];
+            p = std::to_chars(p, end, s.t).ptr; *p++ = ',';
+            p = std::to_chars(p, end, s.x).ptr; *p++ = ',';
+            p = std::to_chars(p, end, s.y).ptr; *p++ = ',';
+            p = std::to_chars(p, end, s.z).ptr; *p++ = ',';
+            p = std::to_chars(p, end, s.stage).ptr; *p++ = '\n';
+        }
+        const size_t n = (size_t)(p - text.data());
+        return std::fwrite(text.data(), 1, n, file) == n;
+    }
+
+    FILE* file = nullptr;
+    bool csv = false;
+    std::atomic<bool> ok{false};
+    std::atomic<uint64_t> written{0};
+    uint64_t dropped = 0;
+
+    std::mutex m;
+    std::condition_variable wake;
+    std::deque<Block*> full;             // waiting for the writer
+    std::vector<Block*> spare;           // written, ready to refill
+    std::vector<std::unique_ptr<Block>> blocks;
+    bool stopping = false;
+    Block* fill = nullptr;               // simulation thread's block
+    std::thread writer;
+    std::vector<char> text;              // writer thread's CSV buffer
+};
@@ -0,0 +1,217 @@
+// CRT_Signal.h
+// Deflection signal generator shared by CRT_2D and CRT_3D.
+//
+// Each plate (X and Y) is driven by a SignalChannel: one period of a
+// waveform (sine, square, saw, triangle, a sum of harmonics, or samples read
+// from a file) is precomputed into a wavetable, and the channel plays it back
+// with a 32-bit phase accumulator and linear interpolation. The output is the
+// normalised deflection: +-1 is a full-scale swing on that axis.
+//
+// evaluate() fills a whole block of evenly spaced samples at once; the phase
+// of sample k is computed directly from the block start, so there is no
+// per-sample sin() and no loop-carried dependency.
+//
+// Channels are configured from strings (--signal-x / --signal-y):
+//
+//   WAVE[:FREQ_HZ[:AMPLITUDE[:PHASE_DEG[:OFFSET]]]]
+//
+// where WAVE is sine, square, saw, triangle, harmonics=A1/A2/A3/... (relative
+// amplitude of each harmonic) or file=PATH (one sample per line, taken as one
+// period). Omitted or empty fields (sine::0.5) keep the simulator's default
+// for that plate; anything that is not a finite number is rejected.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class SignalChannel {
+public:
+    static const int TABLE_BITS = 12;
+    static const uint32_t TABLE_SIZE = 1u << TABLE_BITS;
+
+    SignalChannel() { setSine(); }
+
+    static constexpr double TWO_PI = 6.283185307179586;
+
+    float frequency = 1.0f;   // periods per second
+    float amplitude = 1.0f;
+    float phase = 0.0f;       // in periods, 0.25 = 90 degrees
+    float offset = 0.0f;
+
+    void setSine() {
+        fill([](double u) { return std::sin(TWO_PI * u); });
+    }
+    void setSquare() {
+        fill([](double u) { return u < 0.5 ? 1.0 : -1.0; });
+    }
+    void setSaw() {
+        fill([](double u) { return 2.0 * u - 1.0; });
+    }
+    void setTriangle() {
+        fill([](double u) { return u < 0.5 ? 4.0 * u - 1.0 : 3.0 - 4.0 * u; });
+    }
+
+    // Sum of sine harmonics; harmonics[0] is the fundamental. The result is
+    // scaled to a peak of 1.
+    void setHarmonics(const std::vector<float>& harmonics) {
+        fill([&](double u) {
+            double v = 0.0;
+            for (size_t h = 0; h < harmonics.size(); ++h) v += harmonics[h] * std::sin(TWO_PI * (h + 1) * u);
+            return v;
+        });
+        normalize();
+    }
+
+    // One period of arbitrary samples, resampled into the table and scaled to
+    // a peak of 1
+    void setSamples(const std::vector<float>& samples) {
+        if (samples.empty()) { setSine(); return; }
+        const size_t n = samples.size();
+        fill([&](double u) {
+            double x = u * n;
+            size_t i = (size_t)x;
+            double f = x - i;
+            return samples[i % n] * (1.0 - f) + samples[(i + 1) % n] * f;
+        });
+        normalize();
+    }
+
+    // Value at time t (seconds)
+    float valueAt(double t) const {
+        float v;
+        evaluate(t, 0.0, 1, &v);
+        return v;
+    }
+
+    // out[k] = value at t0 + k * dt, for k < n
+    void evaluate(double t0, double dt, size_t n, float* out) const {
+        double u = t0 * frequency + phase;
+        u -= std::floor(u);
+        double du = dt * frequency;
+        du -= std::floor(du);
+        const uint32_t p0 = (uint32_t)(uint64_t)(u * 4294967296.0);
+        const uint32_t dp = (uint32_t)(uint64_t)(du * 4294967296.0);
+        const float* tab = table.data();
+        const float a = amplitude, o = offset;
+        const float fracScale = 1.0f / (float)(1u << (32 - TABLE_BITS));
+        for (size_t k = 0; k < n; ++k) {
+            uint32_t p = p0 + dp * (uint32_t)k;   // wraps once per period
+            uint32_t i = p >> (32 - TABLE_BITS);
+            float f = (float)(p & ((1u << (32 - TABLE_BITS)) - 1)) * fracScale;
+            out[k] = o + a * (tab[i] + (tab[i + 1] - tab[i]) * f);
+        }
+    }
+
+    // Parse a channel description (see the top of this file). Returns false
+    // and leaves the channel unchanged on a malformed string.
+    bool parse(const std::string& spec) {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (true) {
+            size_t colon = spec.find(':', start);
+            fields.push_back(spec.substr(start, colon - start));
+            if (colon == std::string::npos) break;
+            start = colon + 1;
+        }
+        const std::string& wave = fields[0];
+        SignalChannel c = *this;
+        if (wave == "sine") c.setSine();
+        else if (wave == "square") c.setSquare();
+        else if (wave == "saw") c.setSaw();
+        else if (wave == "triangle") c.setTriangle();
+        else if (wave.compare(0, 10, "harmonics=") == 0) {
+            std::vector<float> h;
+            const char* s = wave.c_str() + 10;
+            while (*s) {
+                char* end = nullptr;
+                h.push_back(std::strtof(s, &end));
+                if (end == s || !std::isfinite(h.back())) return false;
+                s = *end == '/' ? end + 1 : end;
+            }
+            if (h.empty()) return false;
+            c.setHarmonics(h);
+        } else if (wave.compare(0, 5, "file=") == 0) {
+            std::vector<float> samples;
+            if (!readSamples(wave.substr(5).c_str(), samples)) return false;
+            c.setSamples(samples);
+        } else {
+            return false;
+        }
+        if (fields.size() > 5 || !readField(fields, 1, c.frequency) || !readField(fields, 2, c.amplitude) ||
+            !readField(fields, 3, c.phase, 1.0f / 360.0f) || !readField(fields, 4, c.offset))
+            return false;
+        *this = c;
+        return true;
+    }
+
+private:
+    // fields[i] times `scale` into value, if it is given; false unless it
+    // is one finite number
+    static bool readField(const std::vector<std::string>& fields, size_t i, float& value, float scale = 1.0f) {
+        if (i >= fields.size() || fields[i].empty()) return true;
+        const char* s = fields[i].c_str();
+        char* end = nullptr;
+        const float v = std::strtof(s, &end);
+        if (end == s || *end != '\0' || !std::isfinite(v)) return false;
+        value = v * scale;
+        return true;
+    }
+
+    // Tabulate one period; the extra last entry repeats the first so the
+    // interpolation never wraps
+    template <typename F>
+    void fill(F wave) {
+        table.resize(TABLE_SIZE + 1);
+        for (uint32_t i = 0; i < TABLE_SIZE; ++i) table[i] = (float)wave((double)i / TABLE_SIZE);
+        table[TABLE_SIZE] = table[0];
+    }
+
+    void normalize() {
+        float peak = 0.0f;
+        for (float v : table) peak = std::max(peak, std::fabs(v));
+        if (peak > 0.0f) for (float& v : table) v /= peak;
+    }
+
+    static bool readSamples(const char* path, std::vector<float>& out) {
+        FILE* f = std::fopen(path, "r");
+        if (!f) return false;
+        float v;
+        bool finite = true;
+        while (std::fscanf(f, "%f", &v) == 1) {
+            finite = finite && std::isfinite(v);
+            out.push_back(v);
+        }
+        std::fclose(f);
+        return finite && !out.empty();
+    }
+
+    std::vector<float> table;
+};
+
+// The X and Y plate channels plus block buffers for evaluate()
+class SignalGenerator {
+public:
+    SignalChannel x, y;
+
+    void valueAt(double t, float& outX, float& outY) const {
+        outX = x.valueAt(t);
+        outY = y.valueAt(t);
+    }
+
+    // Fill xs / ys with n samples starting at t0, dt apart
+    void evaluate(double t0, double dt, size_t n) {
+        xs.resize(n);
+        ys.resize(n);
+        x.evaluate(t0, dt, n, xs.data());
+        y.evaluate(t0, dt, n, ys.data());
+    }
+
+    std::vector<float> xs, ys;
+};
@@ -0,0 +1,64 @@
+// CRT_SimClock.h
+// Fixed-timestep simulation clock.
+//
+// Real time is measured with a monotonic clock and fed into an accumulator;
+// advance() returns how many fixed steps of dt() the simulation owes. The
+// leftover fraction of a step (alpha()) is used to interpolate between the
+// last two simulation states when rendering. A time scale > 1 runs the
+// simulation faster than real time.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <chrono>
+
+class SimClock {
+public:
+    explicit SimClock(double hz = 1000.0) { setRate(hz); reset(); }
+
+    void setRate(double hz) {
+        if (hz < 1.0) hz = 1.0;
+        stepDt = 1.0 / hz;
+    }
+    void setTimeScale(double scale) { timeScale = scale > 0.0 ? scale : 1.0; }
+
+    // Drop any accumulated time and restart measuring from now
+    void reset() {
+        last = Clock::now();
+        accumulator = 0.0;
+    }
+
+    // Measure elapsed time and return the number of steps to run. At most
+    // MAX_CATCHUP seconds are simulated per call, so a long stall (debugger,
+    // window drag) does not trigger a burst of catch-up steps.
+    int advance() {
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - last).count() * timeScale;
+        last = now;
+        if (elapsed > MAX_CATCHUP * timeScale) elapsed = MAX_CATCHUP * timeScale;
+        return advanceBy(elapsed);
+    }
+
+    // Feed a fixed amount of simulated time instead of measuring it, for
+    // runs that must be reproducible (headless mode)
+    int advanceBy(double seconds) {
+        accumulator += seconds;
+        int steps = (int)(accumulator / stepDt);
+        accumulator -= steps * stepDt;
+        simTime += steps * stepDt;
+        return steps;
+    }
+
+    double dt() const { return stepDt; }
+    double time() const { return simTime; }
+    double alpha() const { return accumulator / stepDt; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    static constexpr double MAX_CATCHUP = 0.25;
+
+    Clock::time_point last;
+    double stepDt = 0.001;
+    double timeScale = 1.0;
+    double accumulator = 0.0;
+    double simTime = 0.0;
+};
@@ -0,0 +1,112 @@
+// CRT_SimThread.h
+// Simulation thread and state handoff shared by CRT_2D and CRT_3D.
+//
+// The simulation runs on its own thread (SimThread) and publishes a complete
+// snapshot of what the renderer draws after every update. Snapshots go
+// through a TripleBuffer: the writer always has a slot of its own to fill,
+// the reader always has the newest finished one, and handing a slot over is
+// a single atomic exchange, so neither side ever waits for the other. A slow
+// frame just skips snapshots; the simulation keeps its own pace.
+//
+// Input travels the other way through a CommandQueue, drained by the
+// simulation thread before each update.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Single writer, single reader. The writer fills back() and calls publish();
+// the reader calls acquire() and reads the slot it returns until the next
+// acquire().
+template <typename T>
+class TripleBuffer {
+public:
+    T& back() { return slots[backIndex]; }
+
+    void publish() {
+        uint8_t old = middle.exchange((uint8_t)(backIndex | FRESH), std::memory_order_acq_rel);
+        backIndex = old & INDEX;
+    }
+
+    // Newest published snapshot; the previous one again if nothing new was
+    // published since the last call
+    const T& acquire() {
+        if (middle.load(std::memory_order_relaxed) & FRESH) {
+            uint8_t old = middle.exchange(frontIndex, std::memory_order_acq_rel);
+            frontIndex = old & INDEX;
+        }
+        return slots[frontIndex];
+    }
+
+    const T& front() const { return slots[frontIndex]; }
+
+private:
+    static const uint8_t INDEX = 3, FRESH = 4;
+
+    T slots[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t backIndex = 0;    // writer's slot
+    uint8_t frontIndex = 2;   // reader's slot
+};
+
+// Commands posted from the input callbacks, run on the simulation thread
+template <typename T>
+class CommandQueue {
+public:
+    void push(const T& c) {
+        std::lock_guard<std::mutex> lock(m);
+        pending.push_back(c);
+    }
+
+    template <typename F>
+    void drain(F fn) {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            taken.swap(pending);
+        }
+        for (const T& c : taken) fn(c);
+        taken.clear();
+    }
+
+private:
+    std::mutex m;
+    std::vector<T> pending, taken;
+};
+
+// Calls step() every periodMs on a thread of its own until stop(). A step
+// that overruns its period is followed straight away by the next one.
+class SimThread {
+public:
+    ~SimThread() { stop(); }
+
+    void start(int periodMs, std::function<void()> step) {
+        stop();
+        running = true;
+        thread = std::thread([this, periodMs, step]() {
+            typedef std::chrono::steady_clock Clock;
+            Clock::time_point next = Clock::now();
+            while (running.load(std::memory_order_relaxed)) {
+                step();
+                next += std::chrono::milliseconds(periodMs);
+                Clock::time_point now = Clock::now();
+                if (next < now) next = now;
+                std::this_thread::sleep_until(next);
+            }
+        });
+    }
+
+    void stop() {
+        running = false;
+        if (thread.joinable()) thread.join();
+    }
+
+private:
+    std::thread thread;
+    std::atomic<bool> running{false};
+};
@@ -0,0 +1,377 @@
+// CRT_SpaceCharge.h
+// Electron-electron repulsion (space charge) for the physical beam in
+// CRT_Electrons.h, computed with a Barnes-Hut octree.
+//
+// Every electron carries the same charge, so the acceleration of electron i
+// is
+//   a_i = k * sum_j (r_i - r_j) / (|r_i - r_j|^2 + eps^2)^(3/2)
+// where k is the charge per electron in the beam's normalised units and eps
+// softens close encounters between the macro-particles.
+//
+// Build: the emitted electrons get 30-bit Morton codes over their bounding
+// cube and are radix sorted by them, so every octree cell covers a
+// contiguous run of the sorted arrays. The tree is built over that order in
+// preorder, and each node records where its subtree ends, so a walk needs no
+// stack. Nodes, codes and sorted copies live in vectors kept between calls,
+// so nothing is allocated once the first frame has warmed them up.
+//
+// Walk: each run of GROUP consecutive electrons in the sorted arrays (close
+// together, because of the Morton order) shares one interaction list. A cell
+// enters the list as its centre of charge when it is small against its
+// distance from the group's bounding box (side < theta * distance); a leaf
+// that is too close enters as its electrons. The group is then summed against the list with the
+// electrons in the inner loop, which has no loop-carried dependency and
+// vectorizes. Groups are independent and are shared out over the job system.
+//
+// computeDirect() is the plain O(N^2) sum with the same kernel, kept as the
+// reference for check().
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CRT_Jobs.h"
+
+// How far the tree result is from the direct sum, and what each cost
+struct SpaceChargeCheck {
+    size_t electrons = 0;
+    size_t nodes = 0;
+    double interactions = 0.0;  // per electron, tree walk
+    double treeMs = 0.0, directMs = 0.0;
+    double rmsError = 0.0;     // |a_tree - a_direct|, relative to the rms |a_direct|
+    double maxError = 0.0;
+};
+
+class SpaceCharge {
+public:
+    static const int LEAF = 16;              // electrons per leaf cell at most
+    static const int GROUP = 32;             // consecutive sorted electrons sharing one interaction list
+    static const int MAX_DEPTH = 10;         // Morton code bits per axis
+    static const size_t GROUP_GRAIN = 8;     // groups per job
+    static const size_t DIRECT_GRAIN = 256;  // electrons per job in computeDirect()
+
+    float theta = 0.7f;        // opening angle
+    float softening = 0.01f;   // eps, tube units
+
+    size_t nodeCount() const { return nodes.size(); }
+    double interactionsPerElectron() const { return active.empty() ? 0.0 : (double)interactions / active.size(); }
+
+    // Acceleration of each of the n electrons into (ax, ay, az) from all
+    // emitted ones (age >= 0); k is the charge per electron. Electrons not
+    // yet emitted get 0.
+    void compute(const float* x, const float* y, const float* z, const float* age, size_t n, float k,
+                 float* ax, float* ay, float* az, JobSystem& jobs) {
+        if (!gather(x, y, z, age, n, ax, ay, az)) return;
+        sortByCell();
+        build();
+
+        const size_t count = (active.size() + GROUP - 1) / GROUP;
+        lists.resize(JobSystem::chunkCount(count, GROUP_GRAIN));
+        listSizes.assign(lists.size(), 0);
+        const float eps2 = softening * softening;
+        jobs.parallelFor(count, GROUP_GRAIN, [&](size_t g0, size_t g1) {
+            const size_t chunk = g0 / GROUP_GRAIN;
+            List& list = lists[chunk];
+            for (size_t g = g0; g < g1; ++g) {
+                const uint32_t t = (uint32_t)(g * GROUP);
+                const uint32_t tn = std::min<uint32_t>(GROUP, (uint32_t)active.size() - t);
+                walk(t, t + tn, list);
+                listSizes[chunk] += list.size() * tn;
+                sum(&sx[t], &sy[t], &sz[t], tn, list.x.data(), list.y.data(), list.z.data(), list.q.data(),
+                    list.size(), eps2, &fx[t], &fy[t], &fz[t]);
+            }
+        });
+        interactions = 0;
+        for (size_t s : listSizes) interactions += s;
+        scatter(k, ax, ay, az);
+    }
+
+    // Same result as compute() by summing over every pair
+    void computeDirect(const float* x, const float* y, const float* z, const float* age, size_t n, float k,
+                       float* ax, float* ay, float* az, JobSystem& jobs) {
+        if (!gather(x, y, z, age, n, ax, ay, az)) return;
+        const size_t m = active.size();
+        order.resize(m);
+        for (size_t i = 0; i < m; ++i) order[i] = (uint32_t)i;
+        sx = px; sy = py; sz = pz;
+        ones.assign(m, 1.0f);
+        const float eps2 = softening * softening;
+        jobs.parallelFor(m, DIRECT_GRAIN, [&](size_t i0, size_t i1) {
+            for (size_t i = i0; i < i1; i += GROUP) {
+                const size_t e = std::min(i1, i + GROUP);
+                sum(&sx[i], &sy[i], &sz[i], e - i, sx.data(), sy.data(), sz.data(), ones.data(), m, eps2,
+                    &fx[i], &fy[i], &fz[i]);
+            }
+        });
+        interactions = m * m;
+        scatter(k, ax, ay, az);
+    }
+
+    // Both methods on the same electrons, timed and compared
+    SpaceChargeCheck check(const float* x, const float* y, const float* z, const float* age, size_t n, float k,
+                           JobSystem& jobs) {
+        std::vector<float> tx(n), ty(n), tz(n), dx(n), dy(n), dz(n);
+        typedef std::chrono::steady_clock Clock;
+        SpaceChargeCheck c;
+        Clock::time_point t0 = Clock::now();
+        compute(x, y, z, age, n, k, tx.data(), ty.data(), tz.data(), jobs);
+        Clock::time_point t1 = Clock::now();
+        c.nodes = nodeCount();
+        c.interactions = interactionsPerElectron();
+        computeDirect(x, y, z, age, n, k, dx.data(), dy.data(), dz.data(), jobs);
+        Clock::time_point t2 = Clock::now();
+        c.electrons = active.size();
+        c.treeMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        c.directMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        double err2 = 0.0, ref2 = 0.0, worst = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            double ex = tx[i] - dx[i], ey = ty[i] - dy[i], ez = tz[i] - dz[i];
+            double e2 = ex * ex + ey * ey + ez * ez;
+            double r2 = (double)dx[i] * dx[i] + (double)dy[i] * dy[i] + (double)dz[i] * dz[i];
+            err2 += e2;
+            ref2 += r2;
+            if (r2 > 0.0) worst = std::max(worst, std::sqrt(e2 / r2));
+        }
+        c.rmsError = ref2 > 0.0 ? std::sqrt(err2 / ref2) : 0.0;
+        c.maxError = worst;
+        return c;
+    }
+
+private:
+    struct Node {
+        float x, y, z, q;        // centre of charge, electrons inside
+        float side;              // cell edge
+        uint32_t begin, end;     // electrons, in sorted order
+        uint32_t next;           // first node after this subtree
+        uint32_t leaf;
+    };
+
+    // Grows to the longest list seen and then stays, so the walk only
+    // writes into it
+    struct List {
+        std::vector<float> x, y, z, q;
+        size_t n = 0;
+        size_t size() const { return n; }
+        void clear() { n = 0; }
+        void reserve(size_t more) {
+            if (n + more <= x.size()) return;
+            const size_t cap = std::max<size_t>(2 * x.size(), n + more);
+            x.resize(cap); y.resize(cap); z.resize(cap); q.resize(cap);
+        }
+        void add(float px, float py, float pz, float pq) {
+            reserve(1);
+            x[n] = px; y[n] = py; z[n] = pz; q[n] = pq;
+            ++n;
+        }
+        void addRun(const float* px, const float* py, const float* pz, size_t count) {
+            reserve(count);
+            std::copy(px, px + count, &x[n]);
+            std::copy(py, py + count, &y[n]);
+            std::copy(pz, pz + count, &z[n]);
+            std::fill(&q[n], &q[n] + count, 1.0f);
+            n += count;
+        }
+    };
+
+    // The emitted electrons into px/py/pz; false (outputs zeroed) if fewer
+    // than two
+    bool gather(const float* x, const float* y, const float* z, const float* age, size_t n,
+                float* ax, float* ay, float* az) {
+        std::fill(ax, ax + n, 0.0f);
+        std::fill(ay, ay + n, 0.0f);
+        std::fill(az, az + n, 0.0f);
+        active.clear();
+        for (size_t i = 0; i < n; ++i)
+            if (age[i] >= 0.0f) active.push_back((uint32_t)i);
+        const size_t m = active.size();
+        interactions = 0;
+        nodes.clear();
+        if (m < 2) return false;
+        px.resize(m); py.resize(m); pz.resize(m);
+        for (size_t i = 0; i < m; ++i) {
+            px[i] = x[active[i]];
+            py[i] = y[active[i]];
+            pz[i] = z[active[i]];
+        }
+        fx.resize(m); fy.resize(m); fz.resize(m);
+        return true;
+    }
+
+    // Spread the low 10 bits of v to every third bit
+    static uint32_t spreadBits(uint32_t v) {
+        v &= 0x3FF;
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    // Morton codes over the bounding cube, then an LSD radix sort of
+    // (code, electron) in three 10-bit passes
+    void sortByCell() {
+        const size_t m = px.size();
+        float lo[3] = { px[0], py[0], pz[0] }, hi[3] = { px[0], py[0], pz[0] };
+        for (size_t i = 1; i < m; ++i) {
+            lo[0] = std::min(lo[0], px[i]); hi[0] = std::max(hi[0], px[i]);
+            lo[1] = std::min(lo[1], py[i]); hi[1] = std::max(hi[1], py[i]);
+            lo[2] = std::min(lo[2], pz[i]); hi[2] = std::max(hi[2], pz[i]);
+        }
+        cubeSide = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), std::max(hi[2] - lo[2], 1e-6f)) * 1.0001f;
+        const float scale = (1 << MAX_DEPTH) / cubeSide;
+
+        codes.resize(m);
+        order.resize(m);
+        for (size_t i = 0; i < m; ++i) {
+            uint32_t cx = std::min((uint32_t)((px[i] - lo[0]) * scale), (1u << MAX_DEPTH) - 1);
+            uint32_t cy = std::min((uint32_t)((py[i] - lo[1]) * scale), (1u << MAX_DEPTH) - 1);
+            uint32_t cz = std::min((uint32_t)((pz[i] - lo[2]) * scale), (1u << MAX_DEPTH) - 1);
+            codes[i] = spreadBits(cx) | (spreadBits(cy) << 1) | (spreadBits(cz) << 2);
+            order[i] = (uint32_t)i;
+        }
+
+        codesTmp.resize(m);
+        orderTmp.resize(m);
+        for (int shift = 0; shift < 3 * MAX_DEPTH; shift += 10) {
+            uint32_t count[1025] = {};
+            for (size_t i = 0; i < m; ++i) ++count[((codes[i] >> shift) & 1023) + 1];
+            for (int b = 0; b < 1024; ++b) count[b + 1] += count[b];
+            for (size_t i = 0; i < m; ++i) {
+                const uint32_t to = count[(codes[i] >> shift) & 1023]++;
+                codesTmp[to] = codes[i];
+                orderTmp[to] = order[i];
+            }
+            codes.swap(codesTmp);
+            order.swap(orderTmp);
+        }
+
+        sx.resize(m); sy.resize(m); sz.resize(m);
+        for (size_t i = 0; i < m; ++i) {
+            sx[i] = px[order[i]];
+            sy[i] = py[order[i]];
+            sz[i] = pz[order[i]];
+        }
+    }
+
+    void build() {
+        nodes.reserve(2 * px.size() / LEAF + 64);
+        buildNode(0, (uint32_t)px.size(), 0, cubeSide);
+    }
+
+    // Node for sorted electrons [begin, end), all in one cell at `level`
+    void buildNode(uint32_t begin, uint32_t end, int level, float side) {
+        const uint32_t self = (uint32_t)nodes.size();
+        nodes.push_back(Node());
+        const bool leaf = end - begin <= (uint32_t)LEAF || level == MAX_DEPTH;
+        float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+        if (leaf) {
+            for (uint32_t i = begin; i < end; ++i) { cx += sx[i]; cy += sy[i]; cz += sz[i]; }
+        } else {
+            // the children's octant is the next 3 code bits; the run is sorted
+            // by them, so each child is a contiguous sub-run
+            const int shift = 3 * (MAX_DEPTH - 1 - level);
+            uint32_t from = begin;
+            while (from < end) {
+                const uint32_t octant = (codes[from] >> shift) & 7;
+                const uint32_t* stop = std::upper_bound(&codes[from], &codes[0] + end, octant,
+                    [shift](uint32_t o, uint32_t code) { return o < ((code >> shift) & 7); });
+                const uint32_t to = (uint32_t)(stop - &codes[0]);
+                buildNode(from, to, level + 1, 0.5f * side);
+                from = to;
+            }
+            for (uint32_t c = self + 1; c < nodes.size(); c = nodes[c].next) {
+                cx += nodes[c].x * nodes[c].q;
+                cy += nodes[c].y * nodes[c].q;
+                cz += nodes[c].z * nodes[c].q;
+            }
+        }
+        Node& n = nodes[self];
+        const float q = (float)(end - begin);
+        n.x = cx / q; n.y = cy / q; n.z = cz / q; n.q = q;
+        n.side = side;
+        n.begin = begin; n.end = end;
+        n.leaf = leaf;
+        n.next = (uint32_t)nodes.size();
+    }
+
+    // Interaction list for the sorted electrons [begin, end)
+    void walk(uint32_t begin, uint32_t end, List& list) const {
+        float lo[3] = { sx[begin], sy[begin], sz[begin] };
+        float hi[3] = { lo[0], lo[1], lo[2] };
+        for (uint32_t i = begin + 1; i < end; ++i) {
+            lo[0] = std::min(lo[0], sx[i]); hi[0] = std::max(hi[0], sx[i]);
+            lo[1] = std::min(lo[1], sy[i]); hi[1] = std::max(hi[1], sy[i]);
+            lo[2] = std::min(lo[2], sz[i]); hi[2] = std::max(hi[2], sz[i]);
+        }
+        const float theta2 = theta * theta;
+        list.clear();
+        const uint32_t count = (uint32_t)nodes.size();
+        uint32_t i = 0;
+        while (i < count) {
+            const Node& n = nodes[i];
+            const float dx = std::max(std::max(lo[0] - n.x, n.x - hi[0]), 0.0f);
+            const float dy = std::max(std::max(lo[1] - n.y, n.y - hi[1]), 0.0f);
+            const float dz = std::max(std::max(lo[2] - n.z, n.z - hi[2]), 0.0f);
+            if (n.side * n.side < theta2 * (dx * dx + dy * dy + dz * dz)) {
+                list.add(n.x, n.y, n.z, n.q);
+                i = n.next;
+            } else if (n.leaf) {
+                list.addRun(&sx[n.begin], &sy[n.begin], &sz[n.begin], n.end - n.begin);
+                i = n.next;
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    // Field at tn targets from ln sources; an electron's own term is zero
+    static void sum(const float* __restrict tx, const float* __restrict ty, const float* __restrict tz, size_t tn,
+                    const float* __restrict lx, const float* __restrict ly, const float* __restrict lz,
+                    const float* __restrict lq, size_t ln, float eps2,
+                    float* __restrict ox, float* __restrict oy, float* __restrict oz) {
+        float ax[GROUP], ay[GROUP], az[GROUP];
+        for (size_t p = 0; p < tn; ++p) { ax[p] = 0.0f; ay[p] = 0.0f; az[p] = 0.0f; }
+        for (size_t s = 0; s < ln; ++s) {
+            const float sx0 = lx[s], sy0 = ly[s], sz0 = lz[s], q = lq[s];
+            for (size_t p = 0; p < tn; ++p) {
+                float dx = tx[p] - sx0, dy = ty[p] - sy0, dz = tz[p] - sz0;
+                float r2 = dx * dx + dy * dy + dz * dz + eps2;
+                float inv = 1.0f / std::sqrt(r2);
+                float w = q * inv * inv * inv;
+                ax[p] += dx * w;
+                ay[p] += dy * w;
+                az[p] += dz * w;
+            }
+        }
+        for (size_t p = 0; p < tn; ++p) { ox[p] = ax[p]; oy[p] = ay[p]; oz[p] = az[p]; }
+    }
+
+    // Sorted results back to electron order, times k
+    void scatter(float k, float* ax, float* ay, float* az) const {
+        const size_t m = active.size();
+        for (size_t i = 0; i < m; ++i) {
+            const uint32_t e = active[order[i]];
+            ax[e] = k * fx[i];
+            ay[e] = k * fy[i];
+            az[e] = k * fz[i];
+        }
+    }
+
+    std::vector<uint32_t> active;              // emitted electrons
+    std::vector<float> px, py, pz;             // their positions
+    std::vector<uint32_t> codes, order, codesTmp, orderTmp;
+    std::vector<float> sx, sy, sz;             // positions in cell order
+    std::vector<float> fx, fy, fz;             // field in cell order, k = 1
+    std::vector<float> ones;
+    std::vector<Node> nodes;
+    std::vector<List> lists;                   // one per job chunk, kept
+    std::vector<size_t> listSizes;
+    size_t interactions = 0;
+    float cubeSide = 1.0f;
+};
@@ -0,0 +1,347 @@
+// CRT_Spectrum.h
+// Spectrum analyser for the X / Y deflection signals, shared by CRT_2D and
+// CRT_3D.
+//
+// The deflection is sampled at a fixed analysis rate into a history of N
+// samples per channel. Every N/4 new samples (75% overlap) the newest N are
+// Hann-windowed and transformed, and their power spectrum is blended into a
+// running average (Welch's method), so the display settles instead of
+// flickering from block to block.
+//
+// The two channels are real, so they share one complex FFT: X goes in the
+// real part, Y in the imaginary part, and the two spectra are separated
+// afterwards from the conjugate symmetry. The FFT is iterative and in place
+// on split real / imaginary arrays. The first two stages are merged into
+// radix-4 butterflies that need no multiplies; after that, pairs of radix-2
+// stages are done as one radix-4 pass that reads its twiddles from
+// contiguous per-stage tables, so the butterfly loop is a plain unit-stride
+// loop the compiler vectorizes. Twiddles and the bit-reversal permutation
+// are computed once in init().
+//
+// A 64k-point transform is a few passes over 512 KiB and costs more than a
+// millisecond, so it is not done in one go: the windowed block is copied
+// out when it is due and the permutation, the passes and the spectrum are
+// run a few steps per push(), paced to end before the next block is due.
+// The display is one hop behind the signal in exchange.
+//
+// drawSpectrum() draws the levels as two line strips, X and Y, one vertex
+// per column.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <GL/glut.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Complex FFT of a power-of-two size, forward (e^-i), unscaled
+class FFT {
+public:
+    void init(size_t size) {
+        n = size;
+        bits = 0;
+        while (((size_t)1 << bits) < n) ++bits;
+        reverse.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            size_t r = 0;
+            for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+            reverse[i] = (uint32_t)r;
+        }
+        // stage with half-size m uses e^(-i pi j / m), j < m, stored at [m, 2m)
+        twRe.assign(n, 0.0f);
+        twIm.assign(n, 0.0f);
+        for (size_t m = 1; m < n; m *= 2) {
+            for (size_t j = 0; j < m; ++j) {
+                double a = -3.14159265358979323846 * j / m;
+                twRe[m + j] = (float)std::cos(a);
+                twIm[m + j] = (float)std::sin(a);
+            }
+        }
+        // first stage size of each pass: 0 for the merged stages 1 and 2,
+        // then radix-4 passes, then a radix-2 pass if the stage count is odd
+        passM.clear();
+        size_t m = 1;
+        if (n >= 4) { passM.push_back(0); m = 4; }
+        for (; 4 * m <= n; m *= 4) passM.push_back((uint32_t)m);
+        for (; m < n; m *= 2) passM.push_back((uint32_t)m);
+    }
+
+    size_t size() const { return n; }
+
+    // The transform is the bit-reversal permutation followed by passes()
+    // butterfly passes. They are exposed one by one so a caller can spread
+    // one transform over several calls.
+    int passes() const { return (int)passM.size(); }
+
+    // Bit-reversal swaps for indices [begin, end)
+    void permute(float* re, float* im, size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; ++i) {
+            size_t r = reverse[i];
+            if (i < r) {
+                std::swap(re[i], re[r]);
+                std::swap(im[i], im[r]);
+            }
+        }
+    }
+
+    void pass(float* re, float* im, int p) const {
+        const size_t m = passM[p];
+        if (m == 0) {
+            // stages m = 1 and 2: twiddles 1 and -i only
+            for (size_t s = 0; s < n; s += 4) {
+                float r0 = re[s] + re[s + 1], i0 = im[s] + im[s + 1];
+                float r1 = re[s] - re[s + 1], i1 = im[s] - im[s + 1];
+                float r2 = re[s + 2] + re[s + 3], i2 = im[s + 2] + im[s + 3];
+                float r3 = re[s + 2] - re[s + 3], i3 = im[s + 2] - im[s + 3];
+                re[s] = r0 + r2;     im[s] = i0 + i2;
+                re[s + 2] = r0 - r2; im[s + 2] = i0 - i2;
+                re[s + 1] = r1 + i3; im[s + 1] = i1 - r3;   // r1 + (-i)(r3 + i i3)
+                re[s + 3] = r1 - i3; im[s + 3] = i1 + r3;
+            }
+        } else if (4 * m <= n) {
+            // two radix-2 stages (m, 2m) in one pass: one trip through
+            // memory and three complex multiplies per four points, not four
+            const float* w1r = &twRe[m];
+            const float* w1i = &twIm[m];
+            const float* w2r = &twRe[2 * m];
+            const float* w2i = &twIm[2 * m];
+            for (size_t s = 0; s < n; s += 4 * m) {
+                float* __restrict ar = re + s;
+                float* __restrict ai = im + s;
+                float* __restrict br = re + s + m;
+                float* __restrict bi = im + s + m;
+                float* __restrict cr = re + s + 2 * m;
+                float* __restrict ci = im + s + 2 * m;
+                float* __restrict dr = re + s + 3 * m;
+                float* __restrict di = im + s + 3 * m;
+                for (size_t j = 0; j < m; ++j) {
+                    // stage m: b and d times W(2m)^j
+                    float tbr = br[j] * w1r[j] - bi[j] * w1i[j], tbi = br[j] * w1i[j] + bi[j] * w1r[j];
+                    float tdr = dr[j] * w1r[j] - di[j] * w1i[j], tdi = dr[j] * w1i[j] + di[j] * w1r[j];
+                    float Ar = ar[j] + tbr, Ai = ai[j] + tbi, Br = ar[j] - tbr, Bi = ai[j] - tbi;
+                    float Cr = cr[j] + tdr, Ci = ci[j] + tdi, Dr = cr[j] - tdr, Di = ci[j] - tdi;
+                    // stage 2m: C times W(4m)^j, D times W(4m)^(j+m) = -i W(4m)^j
+                    float tcr = Cr * w2r[j] - Ci * w2i[j], tci = Cr * w2i[j] + Ci * w2r[j];
+                    float ur = Dr * w2r[j] - Di * w2i[j], ui = Dr * w2i[j] + Di * w2r[j];
+                    float tDr = ui, tDi = -ur;
+                    ar[j] = Ar + tcr; ai[j] = Ai + tci;
+                    cr[j] = Ar - tcr; ci[j] = Ai - tci;
+                    br[j] = Br + tDr; bi[j] = Bi + tDi;
+                    dr[j] = Br - tDr; di[j] = Bi - tDi;
+                }
+            }
+        } else {
+            // an odd stage count leaves one radix-2 stage
+            const float* wr = &twRe[m];
+            const float* wi = &twIm[m];
+            for (size_t s = 0; s < n; s += 2 * m) {
+                float* __restrict ar = re + s;
+                float* __restrict ai = im + s;
+                float* __restrict br = re + s + m;
+                float* __restrict bi = im + s + m;
+                for (size_t j = 0; j < m; ++j) {
+                    float tr = br[j] * wr[j] - bi[j] * wi[j];
+                    float ti = br[j] * wi[j] + bi[j] * wr[j];
+                    br[j] = ar[j] - tr;
+                    bi[j] = ai[j] - ti;
+                    ar[j] += tr;
+                    ai[j] += ti;
+                }
+            }
+        }
+    }
+
+    void forward(float* re, float* im) const {
+        permute(re, im, 0, n);
+        for (int p = 0; p < passes(); ++p) pass(re, im, p);
+    }
+
+private:
+    size_t n = 0;
+    int bits = 0;
+    std::vector<uint32_t> reverse, passM;
+    std::vector<float> twRe, twIm;
+};
+
+class SpectrumAnalyzer {
+public:
+    static constexpr float DB_FLOOR = -90.0f;   // bottom of the display
+
+    // n-point transforms of samples taken `rate` times a second, shown as
+    // `columns` log-spaced frequency columns from rate / n to rate / 2
+    void configure(size_t size, double sampleRate, int columns) {
+        size_t p = 4;
+        while (p < size) p *= 2;
+        n = p;
+        rate = sampleRate;
+        fft.init(n);
+        histX.assign(n, 0.0f);
+        histY.assign(n, 0.0f);
+        re.resize(n);
+        im.resize(n);
+        window.resize(n);
+        for (size_t i = 0; i < n; ++i) window[i] = 0.5f - 0.5f * (float)std::cos(2.0 * 3.14159265358979323846 * i / n);
+        powerX.assign(n / 2 + 1, 0.0f);
+        powerY.assign(n / 2 + 1, 0.0f);
+
+        // columns on a log frequency axis, each at least one bin wide
+        columnBins.resize(columns + 1);
+        const double top = std::log((double)(n / 2));
+        for (int c = 0; c <= columns; ++c) columnBins[c] = (uint32_t)std::floor(std::exp(top * c / columns));
+        for (int c = 1; c <= columns; ++c) columnBins[c] = std::max(columnBins[c], columnBins[c - 1] + 1);
+        for (int c = 0; c <= columns; ++c) columnBins[c] = std::min(columnBins[c], (uint32_t)(n / 2 + 1));
+        levels.assign(2 * (size_t)columns, 0.0f);
+        clear();
+    }
+
+    // Forget the history (the signal time jumped)
+    void clear() {
+        std::fill(histX.begin(), histX.end(), 0.0f);
+        std::fill(histY.begin(), histY.end(), 0.0f);
+        std::fill(powerX.begin(), powerX.end(), 0.0f);
+        std::fill(powerY.begin(), powerY.end(), 0.0f);
+        std::fill(levels.begin(), levels.end(), 0.0f);
+        head = 0;
+        sinceUpdate = 0;
+        blocks = 0;
+        step = IDLE;
+    }
+
+    size_t size() const { return n; }
+    double sampleRate() const { return rate; }
+    int columns() const { return (int)levels.size() / 2; }
+
+    // Append count samples of both channels and do this call's share of the
+    // transform in flight; returns true when one finished (levels() changed)
+    bool push(const float* x, const float* y, size_t count) {
+        for (size_t k = 0; k < count; ++k) {
+            histX[head] = x[k];
+            histY[head] = y[k];
+            if (++head == n) head = 0;
+        }
+        sinceUpdate += count;
+        if (step == IDLE && sinceUpdate >= n / 4) {
+            sinceUpdate = 0;
+            load();
+            step = 0;
+        }
+        if (step == IDLE) return false;
+
+        // Pace the steps so the transform ends by the time the next hop is
+        // due: count / (n / 4) of them, rounded up
+        const size_t hop = n / 4, steps = PERMUTE_STEPS + fft.passes() + 1;
+        size_t budget = (count * steps + hop - 1) / hop;
+        for (budget = std::max<size_t>(budget, 1); budget > 0 && step != IDLE; --budget) advance();
+        return step == IDLE;
+    }
+
+    // Per column, 0..1 over DB_FLOOR..0 dB of full-scale deflection: X
+    // columns first, then Y
+    const std::vector<float>& levelsXY() const { return levels; }
+
+    // Frequency at the left edge of column c
+    double columnFrequency(int c) const { return columnBins[c] * rate / n; }
+
+private:
+    // A transform is PERMUTE_STEPS slices of the bit reversal, the FFT's
+    // passes and the power spectrum, one step per advance()
+    static const int PERMUTE_STEPS = 8;
+    static const int IDLE = -1;
+
+    void advance() {
+        if (step < PERMUTE_STEPS) {
+            fft.permute(re.data(), im.data(), n * step / PERMUTE_STEPS, n * (step + 1) / PERMUTE_STEPS);
+        } else if (step < PERMUTE_STEPS + fft.passes()) {
+            fft.pass(re.data(), im.data(), step - PERMUTE_STEPS);
+        } else {
+            spectrum();
+            step = IDLE;
+            return;
+        }
+        ++step;
+    }
+
+    // The newest n samples, oldest first, windowed; X real, Y imaginary
+    void load() {
+        for (size_t i = 0; i < n; ++i) {
+            size_t h = head + i;
+            if (h >= n) h -= n;
+            re[i] = histX[h] * window[i];
+            im[i] = histY[h] * window[i];
+        }
+    }
+
+    void spectrum() {
+        // X = (Z[k] + conj Z[n-k]) / 2, Y = (Z[k] - conj Z[n-k]) / 2i.
+        // A full-scale sine reads |X| = n / 4 through the Hann window.
+        const float scale = 4.0f / n;
+        const float keep = blocks == 0 ? 0.0f : 0.6f;
+        for (size_t k = 0; k <= n / 2; ++k) {
+            const size_t nk = (n - k) & (n - 1);
+            float xr = 0.5f * (re[k] + re[nk]), xi = 0.5f * (im[k] - im[nk]);
+            float yr = 0.5f * (im[k] + im[nk]), yi = -0.5f * (re[k] - re[nk]);
+            float px = (xr * xr + xi * xi) * scale * scale;
+            float py = (yr * yr + yi * yi) * scale * scale;
+            powerX[k] = keep * powerX[k] + (1.0f - keep) * px;
+            powerY[k] = keep * powerY[k] + (1.0f - keep) * py;
+        }
+        ++blocks;
+
+        const int cols = columns();
+        for (int c = 0; c < cols; ++c) {
+            float mx = 0.0f, my = 0.0f;
+            for (uint32_t k = columnBins[c]; k < columnBins[c + 1]; ++k) {
+                mx = std::max(mx, powerX[k]);
+                my = std::max(my, powerY[k]);
+            }
+            levels[c] = toLevel(mx);
+            levels[cols + c] = toLevel(my);
+        }
+    }
+
+    static float toLevel(float power) {
+        float db = 10.0f * std::log10(power + 1e-20f);
+        return std::min(1.0f, std::max(0.0f, 1.0f - db / DB_FLOOR));
+    }
+
+    FFT fft;
+    size_t n = 0;
+    double rate = 1.0;
+    std::vector<float> histX, histY, re, im, window, powerX, powerY, levels;
+    std::vector<uint32_t> columnBins;
+    size_t head = 0, sinceUpdate = 0;
+    uint64_t blocks = 0;
+    int step = IDLE;                    // next step of the transform in flight
+};
+
+// Spectrum levels (SpectrumAnalyzer::levelsXY()) over [x, x + w] x
+// [y, y + h] in the current matrices: a grid line every SPECTRUM_GRID_DB,
+// X in blue and Y in red
+static const float SPECTRUM_GRID_DB = 30.0f;
+
+static void drawSpectrum(const std::vector<float>& levels, float x, float y, float w, float h) {
+    const int cols = (int)levels.size() / 2;
+    if (cols < 2) return;
+
+    glLineWidth(1.0f);
+    glColor4f(0.5f, 0.5f, 0.5f, 0.5f);
+    glBegin(GL_LINES);
+    for (float db = -SPECTRUM_GRID_DB; db > SpectrumAnalyzer::DB_FLOOR; db -= SPECTRUM_GRID_DB) {
+        const float ly = y + h * (1.0f - db / SpectrumAnalyzer::DB_FLOOR);
+        glVertex2f(x, ly); glVertex2f(x + w, ly);
+    }
+    glEnd();
+
+    glLineWidth(1.5f);
+    const float dx = w / cols;
+    for (int ch = 0; ch < 2; ++ch) {
+        if (ch == 0) glColor3f(0.2f, 0.6f, 1.0f);
+        else glColor3f(1.0f, 0.35f, 0.3f);
+        const float* lv = &levels[(size_t)ch * cols];
+        glBegin(GL_LINE_STRIP);
+        for (int c = 0; c < cols; ++c) glVertex2f(x + (c + 0.5f) * dx, y + h * lv[c]);
+        glEnd();
+    }
+}
@@ -0,0 +1,341 @@
+// CRT_Text.h
+// Batched bitmap text for CRT_2D and CRT_3D.
+//
+// build() draws every printable character of the requested GLUT bitmap fonts
+// once into an offscreen framebuffer, reads the pixels back and packs the
+// glyphs into a single alpha texture. Each string is laid out once and its
+// glyph quads are cached. During a frame, add() projects a string's anchor
+// to window coordinates (like glRasterPos) and queues the quads. flush()
+// then draws all queued text with one glDrawArrays call.
+//
+// If framebuffer objects are not available the queued strings are drawn with
+// glWindowPos + glutBitmapCharacter instead, which looks the same.
+// Needs GL_GLEXT_PROTOTYPES defined before the first GL header is included.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <GL/glut.h>
+#include <GL/glext.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class TextRenderer {
+public:
+    static const int FIRST_CHAR = 32;
+    static const int CHAR_COUNT = 95;        // printable ASCII
+    static const int ATLAS_W = 512;
+    static const size_t MAX_LAYOUTS = 1024;  // cache is dropped when it grows past this
+
+    // Rasterize the glyphs of `fonts` into the atlas. Needs a current context.
+    // Returns false (and keeps the GLUT fallback) if FBOs are unsupported.
+    bool build(void* const* fonts, int count) {
+        faces.clear();
+        for (int i = 0; i < count; ++i) {
+            Face f;
+            f.font = fonts[i];
+            faces.push_back(f);
+        }
+        if (!framebufferSupported()) return false;
+
+        std::vector<unsigned char> atlas;
+        int atlasH = 0, shelfX = 0, shelfY = 0, shelfH = 0;
+        for (Face& f : faces) {
+            if (!captureFace(f)) return false;
+            for (Glyph& g : f.glyphs) {
+                if (g.w == 0) continue;
+                if (shelfX + g.w + 1 > ATLAS_W) { shelfX = 0; shelfY += shelfH + 1; shelfH = 0; }
+                g.ax = shelfX;
+                g.ay = shelfY;
+                shelfX += g.w + 1;
+                shelfH = std::max(shelfH, (int)g.h);
+                atlasH = std::max(atlasH, shelfY + g.h);
+            }
+        }
+        int texH = 1;
+        while (texH < atlasH) texH <<= 1;
+        atlas.assign((size_t)ATLAS_W * texH, 0);
+        for (Face& f : faces) {
+            for (Glyph& g : f.glyphs) {
+                for (int y = 0; y < g.h; ++y)
+                    std::memcpy(&atlas[(size_t)(g.ay + y) * ATLAS_W + g.ax], &g.pixels[(size_t)y * g.w], g.w);
+                g.pixels.clear();
+                g.pixels.shrink_to_fit();
+                g.u0 = g.ax / (float)ATLAS_W;          g.v0 = g.ay / (float)texH;
+                g.u1 = (g.ax + g.w) / (float)ATLAS_W;  g.v1 = (g.ay + g.h) / (float)texH;
+            }
+        }
+
+        if (!texture) glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA8, ATLAS_W, texH, 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        layouts.clear();
+        ready = true;
+        return true;
+    }
+
+    bool usesAtlas() const { return ready; }
+
+    // Width in pixels, as glutBitmapLength, from the cached layout
+    int width(void* font, const std::string& s) { return (int)layout(font, s).width; }
+
+    // Take the current modelview, projection and viewport for add()
+    void setMatrices() {
+        glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+        glGetDoublev(GL_PROJECTION_MATRIX, projection);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+    }
+
+    // Queue `s` at object-space (x, y, z) under the matrices from
+    // setMatrices(). Like glRasterPos, nothing is drawn if the anchor falls
+    // outside the viewport. dx shifts the text in pixels (for centering).
+    void add(void* font, const std::string& s, float x, float y, float z,
+             float r, float g, float b, float a = 1.0f, float dx = 0.0f) {
+        GLdouble wx, wy, wz;
+        if (!gluProject(x, y, z, modelview, projection, viewport, &wx, &wy, &wz)) return;
+        if (wx < viewport[0] || wy < viewport[1] || wx > viewport[0] + viewport[2] ||
+            wy > viewport[1] + viewport[3] || wz < 0.0 || wz > 1.0) return;
+        addWindow(font, s, (float)wx + dx, (float)wy, r, g, b, a, (float)wz);
+    }
+
+    // Queue `s` with its pen position at window pixel (wx, wy)
+    void addWindow(void* font, const std::string& s, float wx, float wy,
+                   float r, float g, float b, float a = 1.0f, float depth = 0.0f) {
+        if (s.empty()) return;
+        if (!ready) {
+            fallback.push_back({ font, s, wx, wy, depth, { r, g, b, a } });
+            return;
+        }
+        const Layout& l = layout(font, s);
+        // glBitmap snaps the pen to whole pixels
+        float px = std::floor(wx), py = std::floor(wy);
+        float z = 1.0f - 2.0f * depth;    // window depth through the ortho in flush()
+        for (const Quad& q : l.quads) {
+            pushVertex(px + q.x0, py + q.y0, z, q.u0, q.v1, r, g, b, a);
+            pushVertex(px + q.x1, py + q.y0, z, q.u1, q.v1, r, g, b, a);
+            pushVertex(px + q.x1, py + q.y1, z, q.u1, q.v0, r, g, b, a);
+            pushVertex(px + q.x0, py + q.y1, z, q.u0, q.v0, r, g, b, a);
+        }
+    }
+
+    // Draw everything queued since the last flush in a w x h window
+    void flush(int w, int h) {
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT | GL_VIEWPORT_BIT | GL_CURRENT_BIT);
+        glViewport(0, 0, w, h);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // transparent texels must not write depth over neighbouring labels
+        glEnable(GL_ALPHA_TEST);
+        glAlphaFunc(GL_GREATER, 0.0f);
+
+        if (ready && !vertices.empty()) {
+            glMatrixMode(GL_PROJECTION);
+            glPushMatrix(); glLoadIdentity();
+            glOrtho(0, w, 0, h, -1, 1);
+            glMatrixMode(GL_MODELVIEW);
+            glPushMatrix(); glLoadIdentity();
+
+            glEnable(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+            const GLsizei stride = VERTEX_FLOATS * sizeof(float);
+            glVertexPointer(3, GL_FLOAT, stride, &vertices[0]);
+            glTexCoordPointer(2, GL_FLOAT, stride, &vertices[3]);
+            glColorPointer(4, GL_FLOAT, stride, &vertices[5]);
+            glDrawArrays(GL_QUADS, 0, (GLsizei)(vertices.size() / VERTEX_FLOATS));
+            glDisableClientState(GL_COLOR_ARRAY);
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+            glDisableClientState(GL_VERTEX_ARRAY);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            glPopMatrix();
+            glMatrixMode(GL_PROJECTION);
+            glPopMatrix();
+            glMatrixMode(GL_MODELVIEW);
+        }
+        for (const Pending& p : fallback) {
+            glColor4fv(p.color);
+            glWindowPos3f(p.wx, p.wy, p.depth);
+            for (char c : p.text) glutBitmapCharacter(p.font, c);
+        }
+        glPopAttrib();
+
+        vertices.clear();
+        fallback.clear();
+    }
+
+private:
+    static const int VERTEX_FLOATS = 9;   // x y z  u v  r g b a
+
+    struct Glyph {
+        short w = 0, h = 0;          // tight bounding box
+        short xoff = 0, yoff = 0;    // box corner relative to the pen
+        short ax = 0, ay = 0;        // position in the atlas
+        float u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+        std::vector<unsigned char> pixels;   // only until packed
+    };
+
+    struct Face {
+        void* font = nullptr;
+        Glyph glyphs[CHAR_COUNT];
+    };
+
+    struct Quad {
+        float x0, y0, x1, y1;
+        float u0, v0, u1, v1;
+    };
+
+    struct Layout {
+        std::vector<Quad> quads;
+        float width = 0.0f;
+    };
+
+    struct Pending {
+        void* font;
+        std::string text;
+        float wx, wy, depth;
+        float color[4];
+    };
+
+    static bool framebufferSupported() {
+        const char* version = (const char*)glGetString(GL_VERSION);
+        const char* ext = (const char*)glGetString(GL_EXTENSIONS);
+        int major = 0;
+        if (version) std::sscanf(version, "%d", &major);
+        return major >= 3 || (ext && std::strstr(ext, "GL_ARB_framebuffer_object"));
+    }
+
+    // Draw the face's glyphs on a grid in an FBO and cut out each glyph's
+    // tight bounding box from the read-back pixels
+    bool captureFace(Face& f) {
+        int maxW = 0;
+        for (int c = 0; c < CHAR_COUNT; ++c) maxW = std::max(maxW, glutBitmapWidth(f.font, FIRST_CHAR + c));
+        // Plain GLUT has no font height query; the cell is tall enough for
+        // the largest GLUT font (Times Roman 24) including descenders
+        const int pad = 4;
+        const int cellW = maxW + 2 * pad, cellH = 48;
+        const int below = 16;
+        const int cols = 16, rows = (CHAR_COUNT + cols - 1) / cols;
+        const int W = cols * cellW, H = rows * cellH;
+
+        GLuint fbo = 0, rbo = 0;
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(1, &rbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, W, H);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo);
+        bool ok = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+        std::vector<unsigned char> img;
+        if (ok) {
+            glPushAttrib(GL_ALL_ATTRIB_BITS);
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_BLEND);
+            glViewport(0, 0, W, H);
+            glMatrixMode(GL_PROJECTION);
+            glPushMatrix(); glLoadIdentity();
+            gluOrtho2D(0, W, 0, H);
+            glMatrixMode(GL_MODELVIEW);
+            glPushMatrix(); glLoadIdentity();
+            glClearColor(0, 0, 0, 0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glColor4f(1, 1, 1, 1);
+            for (int c = 0; c < CHAR_COUNT; ++c) {
+                glRasterPos2i((c % cols) * cellW + pad, (c / cols) * cellH + below);
+                glutBitmapCharacter(f.font, FIRST_CHAR + c);
+            }
+            img.resize((size_t)W * H);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, W, H, GL_RED, GL_UNSIGNED_BYTE, img.data());
+            glPopMatrix();
+            glMatrixMode(GL_PROJECTION);
+            glPopMatrix();
+            glMatrixMode(GL_MODELVIEW);
+            glPopAttrib();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(1, &rbo);
+        glDeleteFramebuffers(1, &fbo);
+        if (!ok) return false;
+
+        for (int c = 0; c < CHAR_COUNT; ++c) {
+            int cx = (c % cols) * cellW, cy = (c / cols) * cellH;
+            int x0 = cellW, y0 = cellH, x1 = -1, y1 = -1;
+            for (int y = 0; y < cellH; ++y)
+                for (int x = 0; x < cellW; ++x)
+                    if (img[(size_t)(cy + y) * W + cx + x]) {
+                        x0 = std::min(x0, x); x1 = std::max(x1, x);
+                        y0 = std::min(y0, y); y1 = std::max(y1, y);
+                    }
+            Glyph& g = f.glyphs[c];
+            if (x1 < 0) continue;                   // blank (space)
+            g.w = (short)(x1 - x0 + 1);
+            g.h = (short)(y1 - y0 + 1);
+            g.xoff = (short)(x0 - pad);
+            g.yoff = (short)(y0 - below);
+            g.pixels.resize((size_t)g.w * g.h);
+            // atlas rows run top to bottom, so flip while copying
+            for (int y = 0; y < g.h; ++y)
+                std::memcpy(&g.pixels[(size_t)y * g.w], &img[(size_t)(cy + y1 - y) * W + cx + x0], g.w);
+        }
+        return true;
+    }
+
+    const Face* findFace(void* font) const {
+        for (const Face& f : faces)
+            if (f.font == font) return &f;
+        return nullptr;
+    }
+
+    const Layout& layout(void* font, const std::string& s) {
+        std::string key;
+        key.reserve(s.size() + sizeof(void*));
+        key.append((const char*)&font, sizeof(void*));
+        key.append(s);
+        auto it = layouts.find(key);
+        if (it != layouts.end()) return it->second;
+
+        if (layouts.size() >= MAX_LAYOUTS) layouts.clear();
+        Layout& l = layouts[key];
+        const Face* f = findFace(font);
+        float pen = 0.0f;
+        for (unsigned char c : s) {
+            if (f && c >= FIRST_CHAR && c < FIRST_CHAR + CHAR_COUNT) {
+                const Glyph& g = f->glyphs[c - FIRST_CHAR];
+                if (g.w > 0) {
+                    float x0 = pen + g.xoff, y0 = (float)g.yoff;
+                    l.quads.push_back({ x0, y0, x0 + g.w, y0 + g.h, g.u0, g.v0, g.u1, g.v1 });
+                }
+            }
+            pen += glutBitmapWidth(font, c);
+        }
+        l.width = pen;
+        return l;
+    }
+
+    void pushVertex(float x, float y, float z, float u, float v, float r, float g, float b, float a) {
+        float vtx[VERTEX_FLOATS] = { x, y, z, u, v, r, g, b, a };
+        vertices.insert(vertices.end(), vtx, vtx + VERTEX_FLOATS);
+    }
+
+    std::vector<Face> faces;
+    std::unordered_map<std::string, Layout> layouts;
+    std::vector<float> vertices;
+    std::vector<Pending> fallback;
+    GLuint texture = 0;
+    bool ready = false;
+    GLdouble modelview[16] = {}, projection[16] = {};
+    GLint viewport[4] = {};
+};
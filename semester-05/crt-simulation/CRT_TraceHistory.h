@@ -0,0 +1,139 @@
+// CRT_TraceHistory.h
+// Beam trace history shared by CRT_2D and CRT_3D.
+//
+// The history spans the last `depth` samples but only keeps what the inset
+// can show: samples are snapped to the inset's pixel grid and a new vertex is
+// started only when the beam moves to another pixel. A sample in the same
+// pixel moves the newest vertex instead, and a step in the same direction as
+// the last one stretches it, so straight runs (raster lines) stay two
+// vertices. The vertices are kept up to date as samples are pushed and
+// dropped from the front as their samples age out, so the drawing cost
+// depends on the length of the path in pixels, not on the number of samples.
+//
+// The old per-vertex alpha ramp is approximated by splitting the sample
+// window into TRACE_FADE_BANDS equal bands by age, each drawn with one
+// glDrawArrays call. Callers set up the modelview matrix to map trace
+// coordinates into the inset.
+// ------------------------------------------------------------------------------
+#pragma once
+
+#include <GL/glut.h>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct TracePoint {
+    float x, y;
+};
+
+static const int TRACE_FADE_BANDS = 32;
+
+// What the renderer draws: the kept vertices, oldest first. Band b is drawn
+// up to vertex bandStart[b + 1] - 1, joined to the band before it.
+struct TraceSnapshot {
+    std::vector<TracePoint> points;
+    uint32_t bandStart[TRACE_FADE_BANDS + 1] = {};
+
+    void clear() {
+        points.clear();
+        for (uint32_t& s : bandStart) s = 0;
+    }
+};
+
+class TraceHistory {
+public:
+    // Span the last `depth` samples, snapped to a res x res grid over the
+    // world rectangle [x0, x1] x [y0, y1]
+    void reset(size_t depth, int res, float x0, float y0, float x1, float y1) {
+        window = depth > 0 ? depth : 1;
+        wx0 = x0; wy0 = y0;
+        kx = res / (x1 - x0);
+        ky = res / (y1 - y0);
+        clear();
+    }
+
+    void clear() {
+        verts.clear();
+        pushed = 0;
+    }
+
+    void push(const TracePoint& p) {
+        const float gx = (p.x - wx0) * kx, gy = (p.y - wy0) * ky;
+        const int32_t cx = (int32_t)std::floor(gx), cy = (int32_t)std::floor(gy);
+        const uint64_t seq = pushed++;
+        if (!verts.empty()) {
+            Vertex& last = verts.back();
+            const int32_t dx = cx - last.cx, dy = cy - last.cy;
+            if ((dx == 0 && dy == 0) || (verts.size() > 1 && dx == last.dx && dy == last.dy)) {
+                // same pixel, or one more step the same way: move the end
+                last.p = p;
+                last.cx = cx; last.cy = cy;
+                last.seq = seq;
+                dropExpired();
+                return;
+            }
+            verts.push_back({ p, cx, cy, dx, dy, seq });
+        } else {
+            verts.push_back({ p, cx, cy, 0, 0, seq });
+        }
+        dropExpired();
+    }
+
+    size_t size() const { return verts.size(); }                  // kept vertices
+    size_t samples() const { return pushed < window ? (size_t)pushed : window; }
+
+    // Copy the vertices and their fade bands for the renderer
+    void copyTo(TraceSnapshot& out) const {
+        out.points.resize(verts.size());
+        const uint64_t first = pushed - samples();
+        const uint64_t span = samples();
+        int band = 0;
+        out.bandStart[0] = 0;
+        for (size_t i = 0; i < verts.size(); ++i) {
+            out.points[i] = verts[i].p;
+            const uint64_t age = verts[i].seq > first ? verts[i].seq - first : 0;
+            const int b = (int)(age * TRACE_FADE_BANDS / span);
+            while (band < b) out.bandStart[++band] = (uint32_t)i;
+        }
+        while (band < TRACE_FADE_BANDS) out.bandStart[++band] = (uint32_t)verts.size();
+    }
+
+private:
+    struct Vertex {
+        TracePoint p;
+        int32_t cx, cy;   // pixel
+        int32_t dx, dy;   // step from the vertex before
+        uint64_t seq;     // newest sample it stands for
+    };
+
+    // Keep one vertex older than the window so the oldest segment still
+    // reaches the window's first sample
+    void dropExpired() {
+        const uint64_t first = pushed - samples();
+        while (verts.size() > 1 && verts[1].seq < first) verts.pop_front();
+    }
+
+    std::deque<Vertex> verts;
+    uint64_t pushed = 0;
+    size_t window = 1;
+    float wx0 = 0.0f, wy0 = 0.0f, kx = 1.0f, ky = 1.0f;
+};
+
+static void drawTraceHistory(const TraceSnapshot& trace, float r, float g, float b) {
+    if (trace.points.size() < 2) return;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(TracePoint), trace.points.data());
+    for (int band = 0; band < TRACE_FADE_BANDS; ++band) {
+        size_t first = trace.bandStart[band];
+        size_t last = trace.bandStart[band + 1];
+        if (first > 0) --first;   // join to the band before
+        if (last <= first + 1) continue;
+
+        glColor4f(r, g, b, (band + 1) / (float)TRACE_FADE_BANDS);
+        glDrawArrays(GL_LINE_STRIP, (GLint)first, (GLsizei)(last - first));
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+}